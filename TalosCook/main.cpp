@@ -0,0 +1,58 @@
+#include "talos/cook/Cooker.h"
+
+int main(int argc, char** argv) {
+	// asset paths in scenes and descriptors are relative to the engine's folder, run from there
+	vkCook::CookerInput cookerInput;
+	std::vector<std::string> positional;
+	for (int i = 1; i < argc; i++) {
+		std::string argument = argv[i];
+		if (argument == "--pack" && i + 1 < argc) {
+			cookerInput.archivePath = argv[++i];
+			// shaders are the only other thing the engine reads off the disk
+			cookerInput.packDirectories = { "Shaders/" };
+		}
+		else if (argument == "--uncompressed") {
+			cookerInput.compress = false;
+		}
+		else if (argument == "--textures" && i + 1 < argc) {
+			std::string encoding = argv[++i];
+			if (encoding == "rgba8") {
+				cookerInput.textureEncoding = vkImage::TextureEncoding::RGBA8;
+			}
+			else if (encoding == "bc1") {
+				cookerInput.textureEncoding = vkImage::TextureEncoding::BC1;
+			}
+			else if (encoding == "bc7") {
+				cookerInput.textureEncoding = vkImage::TextureEncoding::BC7;
+			}
+			else {
+				std::cout << "unknown texture encoding \"" << encoding << "\", expected rgba8, bc1 or bc7" << std::endl;
+				return 1;
+			}
+		}
+		else {
+			positional.push_back(argument);
+		}
+	}
+
+	if (positional.empty() || positional.size() > 2) {
+		std::cout << "usage: talos-cook <scene> [output directory] [--pack <archive>] [--uncompressed] [--textures rgba8|bc1|bc7]" << std::endl;
+		return 1;
+	}
+
+	cookerInput.scenePath = positional[0];
+	if (positional.size() == 2) {
+		cookerInput.outputDirectory = positional[1];
+		if (cookerInput.outputDirectory.back() != '/' && cookerInput.outputDirectory.back() != '\\') {
+			cookerInput.outputDirectory += "/";
+		}
+	}
+
+	int failures = vkCook::cookScene(cookerInput);
+	if (failures > 0) {
+		std::cout << failures << " assets failed to cook" << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -57,6 +57,11 @@ void App::run() {
 App::App(int width, int height, bool debugMode) {
 	buildGlfwWindow(width, height, debugMode);
 
+	// packed builds read everything out of one archive, development builds use loose files
+	if (vkUtilities::mountAssetArchive() && debugMode) {
+		std::cout << "Mounted \"" << vkUtilities::ASSET_ARCHIVE_PATH << "\" with " << vkUtilities::getMountedArchive()->getEntryCount() << " assets" << std::endl;
+	}
+
 	graphicsEngine = new Engine(width, height, window, debugMode);
 	scene = new Scene("scenes/sample.txt");
 }
@@ -64,6 +69,7 @@ App::App(int width, int height, bool debugMode) {
 App::~App() {
 	delete graphicsEngine;
 	delete scene;
+	vkUtilities::unmountAssetArchive();
 	// delete window;
 }
 
@@ -2,6 +2,7 @@
 #include "talos/config.h"
 #include "talos/Engine.h"
 #include "talos/gameobjects/Scene.h"
+#include "talos/utilities/AssetArchive.h"
 
 class App {
 	private:
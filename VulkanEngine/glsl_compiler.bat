@@ -1,9 +1,12 @@
 C:\VulkanSDK\1.3.268.0\Bin\glslc.exe shader.vert -o vert.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe -DCOMPACT_VERTICES shader.vert -o vert_compact.spv
 C:\VulkanSDK\1.3.268.0\Bin\glslc.exe shader.frag -o frag.spv
 C:\VulkanSDK\1.3.268.0\Bin\glslc.exe sky_shader.vert -o sky_vert.spv
 C:\VulkanSDK\1.3.268.0\Bin\glslc.exe sky_shader.frag -o sky_frag.spv
 C:\VulkanSDK\1.3.268.0\Bin\glslc.exe prepass.vert -o prepass_vert.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe -DCOMPACT_VERTICES prepass.vert -o prepass_vert_compact.spv
 C:\VulkanSDK\1.3.268.0\Bin\glslc.exe prepass.frag -o prepass_frag.spv
 C:\VulkanSDK\1.3.268.0\Bin\glslc.exe deferred.vert -o deferred_vert.spv
 C:\VulkanSDK\1.3.268.0\Bin\glslc.exe deferred.frag -o deferred_frag.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe cluster_cull.comp -o cluster_cull_comp.spv
 pause
\ No newline at end of file
@@ -1,6 +1,14 @@
 #include "App.h"
+#include "talos/mesh/ObjBenchmark.h"
+
+int main(int argc, char** argv) {
+	// --bench-obj <obj> <mtl> [runs] times the obj parsers instead of starting the engine
+	if (argc >= 4 && std::string(argv[1]) == "--bench-obj") {
+		int iterations = argc >= 5 ? std::atoi(argv[4]) : 10;
+		vkMesh::benchmarkObjParsers(argv[2], argv[3], iterations);
+		return 0;
+	}
 
-int main() {
 	std::cout << "Hello Vulkan!" << std::endl;
 
 	App* application = new App(1280, 960, true);
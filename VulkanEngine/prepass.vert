@@ -10,13 +10,41 @@ layout(std140, set = 0, binding = 1) readonly buffer storageBuffer {
 	mat4 model[];
 } ObjectData;
 
+struct Material {
+	vec4 ka;
+	vec4 kd;
+	vec4 ks; // w is the specular exponent
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer materialBuffer {
+	Material materials[];
+} MaterialData;
+
+#ifdef COMPACT_VERTICES
+// built a second time with -DCOMPACT_VERTICES for meshes stored as vkMesh::CompactVertex
+layout(push_constant) uniform MeshBounds {
+	vec4 minimum;
+	vec4 extent;
+} bounds;
+
+layout(location = 0) in vec4 quantizedPosition;
+layout(location = 1) in vec2 octahedralNormal;
+layout(location = 2) in vec2 vertexTexCoord;
+layout(location = 3) in uint materialIndex;
+
+vec3 decodeOctahedral(vec2 encoded) {
+	vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	float fold = max(-normal.z, 0.0);
+	normal.x += normal.x >= 0.0 ? -fold : fold;
+	normal.y += normal.y >= 0.0 ? -fold : fold;
+	return normalize(normal);
+}
+#else
 layout(location = 0) in vec3 vertexPosition;
-layout(location = 1) in vec3 vertexKa;
-layout(location = 2) in vec3 vertexKd;
-layout(location = 3) in vec3 vertexKs;
-layout(location = 4) in float e;
-layout(location = 5) in vec2 vertexTexCoord;
-layout(location = 6) in vec3 vertexNormal;
+layout(location = 1) in vec3 vertexNormal;
+layout(location = 2) in vec2 vertexTexCoord;
+layout(location = 3) in uint materialIndex;
+#endif
 
 layout(location = 0) out vec3 fragKa;
 layout(location = 1) out vec3 fragKd;
@@ -28,12 +56,17 @@ layout(location = 6) out vec3 fragNormalWorldSpace;
 
 void main()
 {
+#ifdef COMPACT_VERTICES
+	vec3 vertexPosition = bounds.minimum.xyz + quantizedPosition.xyz * bounds.extent.xyz;
+	vec3 vertexNormal = decodeOctahedral(octahedralNormal);
+#endif
 	gl_Position = cameraData.viewProjection * ObjectData.model[gl_InstanceIndex] * vec4(vertexPosition, 1.0);
 	fragPosWorldSpace = vec3(ObjectData.model[gl_InstanceIndex] * vec4(vertexPosition, 1.0));
 	fragNormalWorldSpace = normalize(vec3(transpose(inverse(ObjectData.model[gl_InstanceIndex])) * vec4(vertexNormal, 0.0)));
-	fragKa = vertexKa;
-	fragKd = vertexKd;
-	fragKs = vertexKs;
-	fragE = e;
+	Material material = MaterialData.materials[materialIndex];
+	fragKa = material.ka.xyz;
+	fragKd = material.kd.xyz;
+	fragKs = material.ks.xyz;
+	fragE = material.ks.w;
 	fragTexCoord = vertexTexCoord;
 }
\ No newline at end of file
@@ -12,6 +12,7 @@
 #include "pipeline/Descriptors.h"
 #include "mesh/ObjMesh.h"
 #include "utilities/ModelLoader.h"
+#include "utilities/SingleTimeCommands.h"
 
 Engine::Engine(int width, int height, GLFWwindow* window, bool debugMode) {
 	if (debugMode) {
@@ -102,10 +103,25 @@ std::vector<const char*> Engine::getRequestedExtensions() {
 void Engine::setupDevice() {
 	physicalDevice = vkInit::selectPhysicalDevice(instance, requestedExtensions, debugMode);
 	device = vkInit::createLogicalDevice(physicalDevice, surface, debugMode);
+	multiDrawIndirect = physicalDevice.getFeatures().multiDrawIndirect;
+
+	vkUtilities::DeviceAllocatorInput allocatorInput;
+	allocatorInput.device = device;
+	allocatorInput.physicalDevice = physicalDevice;
+	allocatorInput.memoryBudget = vkInit::supportsMemoryBudget(physicalDevice);
+	allocatorInput.debug = debugMode;
+	allocator.create(allocatorInput);
 
 	std::vector<vk::Queue> queues = vkInit::getQueues(physicalDevice, device, surface, debugMode);
 	graphicsQueue = queues[0];
 	presentQueue = queues[1];
+	transferQueue = queues[2];
+
+	vkUtilities::QueueFamilyIndices indices = vkUtilities::findQueueFamilies(physicalDevice, surface);
+	uploadQueues.graphicsQueue = graphicsQueue;
+	uploadQueues.graphicsFamily = indices.graphicsFamily.value();
+	uploadQueues.transferQueue = transferQueue;
+	uploadQueues.transferFamily = indices.transferFamily.value_or(uploadQueues.graphicsFamily);
 
 	// get swap chain support
 	// vkInit::querySwapChainSupport(physicalDevice, surface, true);
@@ -125,6 +141,7 @@ void Engine::createSwapchain() {
 	for (vkUtilities::SwapChainFrame& frame : swapChainFrames) {
 		frame.device = device;
 		frame.physicalDevice = physicalDevice;
+		frame.allocator = &allocator;
 		frame.width = swapChainExtent.width;
 		frame.height = swapChainExtent.height;
 
@@ -191,6 +208,13 @@ void Engine::createDescriptorSetLayouts()  {
 	bindings.types.push_back(vk::DescriptorType::eStorageBuffer);
 	bindings.counts.push_back(1);
 	bindings.shaderStages.push_back(vk::ShaderStageFlagBits::eVertex);
+
+	// material table the vertices index into
+	bindings.count = 3;
+	bindings.indices.push_back(2);
+	bindings.types.push_back(vk::DescriptorType::eStorageBuffer);
+	bindings.counts.push_back(1);
+	bindings.shaderStages.push_back(vk::ShaderStageFlagBits::eVertex);
 	vertexDescLayout[RenderPassType::FORWARD] = vkInit::makeDescriptorSetLayout(device, bindings);
 	vertexDescLayout[RenderPassType::PREPASS] = vkInit::makeDescriptorSetLayout(device, bindings);
 
@@ -266,11 +290,18 @@ void Engine::setupPipeline() {
 	pipelineInput.depthFormat = swapChainFrames[0].depthBufferFormat;
 	pipelineInput.formats = { swapChainFormat };
 	// TODO: These lines have to change for use with the deferred pass
-	pipelineInput.vertexAttributeDescription = vkMesh::getPosColorAttributeDescriptions();
-	pipelineInput.vertexBindingDescription = vkMesh::getPosColorBindingDescription();
+	pipelineInput.vertexAttributeDescription = vkMesh::getAttributeDescriptions<vkMesh::Vertex>();
+	pipelineInput.vertexBindingDescription = vkMesh::getBindingDescription<vkMesh::Vertex>();
 	pipelineInput.imageInitialLayout = vk::ImageLayout::ePresentSrcKHR;
 	pipelineInput.imageFinalLayout = vk::ImageLayout::ePresentSrcKHR;
 
+	// both vertex formats share one push range so their layouts stay compatible and descriptor sets survive a pipeline switch
+	vk::PushConstantRange meshBoundsRange;
+	meshBoundsRange.stageFlags = vk::ShaderStageFlagBits::eVertex;
+	meshBoundsRange.offset = 0;
+	meshBoundsRange.size = sizeof(vkMesh::MeshBounds);
+	pipelineInput.pushConstantRanges = { meshBoundsRange };
+
 	addPipeline(pipelineBuilder, pipelineInput);
 
 	// Prepass
@@ -278,8 +309,8 @@ void Engine::setupPipeline() {
 	pipelineInput.vertexShaderLocation = "Shaders/prepass_vert.spv";
 	pipelineInput.fragmentShaderLocation = "Shaders/prepass_frag.spv";
 	pipelineInput.formats = { vk::Format::eR8G8B8A8Unorm,  vk::Format::eR16G16B16A16Sfloat};
-	pipelineInput.vertexAttributeDescription = vkMesh::getPosColorAttributeDescriptions();
-	pipelineInput.vertexBindingDescription = vkMesh::getPosColorBindingDescription();
+	pipelineInput.vertexAttributeDescription = vkMesh::getAttributeDescriptions<vkMesh::Vertex>();
+	pipelineInput.vertexBindingDescription = vkMesh::getBindingDescription<vkMesh::Vertex>();
 	pipelineInput.imageInitialLayout = vk::ImageLayout::eUndefined;
 	pipelineInput.imageFinalLayout = vk::ImageLayout::eColorAttachmentOptimal;
 
@@ -297,6 +328,48 @@ void Engine::setupPipeline() {
 	pipelineInput.imageInitialLayout = vk::ImageLayout::eUndefined;
 	pipelineInput.imageFinalLayout = vk::ImageLayout::ePresentSrcKHR;
 	pipelineInput.vertexAttributeDescription = {};
+	pipelineInput.pushConstantRanges = {};
+
+	addPipeline(pipelineBuilder, pipelineInput);
+}
+
+void Engine::setupCompactPipelines() {
+	vkInit::PipelineBuilder pipelineBuilder(device);
+
+	vkInit::PipelineInput pipelineInput;
+
+	// has to match the float pipelines' push range so their layouts stay compatible
+	vk::PushConstantRange meshBoundsRange;
+	meshBoundsRange.stageFlags = vk::ShaderStageFlagBits::eVertex;
+	meshBoundsRange.offset = 0;
+	meshBoundsRange.size = sizeof(vkMesh::MeshBounds);
+
+	// Forward
+	pipelineInput.pipelineType = RenderPassType::FORWARD;
+	pipelineInput.vertexFormat = vkMesh::VertexFormat::COMPACT;
+	pipelineInput.depthTest = true;
+	pipelineInput.shouldOverWriteColor = false;
+	pipelineInput.vertexShaderLocation = "Shaders/vert_compact.spv";
+	pipelineInput.fragmentShaderLocation = "Shaders/frag.spv";
+	pipelineInput.shouldClearDepthAttachment = false;
+	pipelineInput.size = swapChainExtent;
+	pipelineInput.depthFormat = swapChainFrames[0].depthBufferFormat;
+	pipelineInput.formats = { swapChainFormat };
+	pipelineInput.vertexAttributeDescription = vkMesh::getAttributeDescriptions<vkMesh::CompactVertex>();
+	pipelineInput.vertexBindingDescription = vkMesh::getBindingDescription<vkMesh::CompactVertex>();
+	pipelineInput.pushConstantRanges = { meshBoundsRange };
+	pipelineInput.imageInitialLayout = vk::ImageLayout::ePresentSrcKHR;
+	pipelineInput.imageFinalLayout = vk::ImageLayout::ePresentSrcKHR;
+
+	addPipeline(pipelineBuilder, pipelineInput);
+
+	// Prepass
+	pipelineInput.pipelineType = RenderPassType::PREPASS;
+	pipelineInput.vertexShaderLocation = "Shaders/prepass_vert_compact.spv";
+	pipelineInput.fragmentShaderLocation = "Shaders/prepass_frag.spv";
+	pipelineInput.formats = { vk::Format::eR8G8B8A8Unorm,  vk::Format::eR16G16B16A16Sfloat };
+	pipelineInput.imageInitialLayout = vk::ImageLayout::eUndefined;
+	pipelineInput.imageFinalLayout = vk::ImageLayout::eColorAttachmentOptimal;
 
 	addPipeline(pipelineBuilder, pipelineInput);
 }
@@ -325,6 +398,10 @@ void Engine::addPipeline(vkInit::PipelineBuilder pipelineBuilder, vkInit::Pipeli
 		pipelineBuilder.addDescriptorSetLayout(meshDescLayout[pipelineInput.pipelineType]);
 	}
 
+	for (const vk::PushConstantRange& range : pipelineInput.pushConstantRanges) {
+		pipelineBuilder.addPushConstantRange(range);
+	}
+
 	for (int i = 0; i < pipelineInput.formats.size(); i++) {
 		pipelineBuilder.addColorAttachment(pipelineInput.formats[i], i, pipelineInput.imageInitialLayout, pipelineInput.imageFinalLayout);
 	}
@@ -336,6 +413,14 @@ void Engine::addPipeline(vkInit::PipelineBuilder pipelineBuilder, vkInit::Pipeli
 
 	vkInit::GraphicsPipelineOutBundle output = pipelineBuilder.build();
 
+	if (pipelineInput.vertexFormat == vkMesh::VertexFormat::COMPACT) {
+		// a pipeline doesn't hold on to its render pass, and the float variant's is compatible
+		device.destroyRenderPass(output.renderPass);
+		compactPipelineLayouts[pipelineInput.pipelineType] = output.layout;
+		compactPipelines[pipelineInput.pipelineType] = output.pipeline;
+		return;
+	}
+
 	pipelineLayouts[pipelineInput.pipelineType] = output.layout;
 	renderPasses[pipelineInput.pipelineType] = output.renderPass;
 	pipelines[pipelineInput.pipelineType] = output.pipeline;
@@ -353,9 +438,10 @@ void Engine::createFrameResources() {
 
 	// TODO: lol rename these to be more about the descriptors they contain lmao
 	vkInit::DescriptorSetLayoutData vertexBindingsForward;
-	vertexBindingsForward.count = 2;
+	vertexBindingsForward.count = 3;
 	vertexBindingsForward.types.push_back(vk::DescriptorType::eUniformBuffer);
 	vertexBindingsForward.types.push_back(vk::DescriptorType::eStorageBuffer);
+	vertexBindingsForward.types.push_back(vk::DescriptorType::eStorageBuffer);
 	frameVertexDescPool = vkInit::createDescriptorPool(device, static_cast<uint32_t>(swapChainFrames.size() * 3), vertexBindingsForward);
 
 	// TODO: Unused for now, delete later
@@ -411,21 +497,85 @@ void Engine::finalizeSetup() {
 	createFrameResources();
 }
 
-void Engine::renderObjects(vk::CommandBuffer commandBuffer, std::string objectType, uint32_t& startInstance, uint32_t instanceCount) {
+// switches pipeline and vertex buffer only when the next mesh is stored differently from the last
+void Engine::useVertexFormat(vk::CommandBuffer commandBuffer, RenderPassType passType, vkMesh::VertexFormat format, vkMesh::VertexFormat& boundFormat) {
+	if (format == boundFormat) {
+		return;
+	}
+
+	vk::DeviceSize offsets[] = { 0 };
+	if (format == vkMesh::VertexFormat::COMPACT) {
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, compactPipelines[passType]);
+		vk::Buffer vertexBuffers[] = { meshes->compactVertexBuffer.buffer };
+		commandBuffer.bindVertexBuffers(0, 1, vertexBuffers, offsets);
+	}
+	else {
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelines[passType]);
+		vk::Buffer vertexBuffers[] = { meshes->vertexBuffer.buffer };
+		commandBuffer.bindVertexBuffers(0, 1, vertexBuffers, offsets);
+	}
+
+	boundFormat = format;
+}
+
+// cluster culled meshes draw from the culler's output, everything else from the index buffer matching its type
+void Engine::useIndexBuffer(vk::CommandBuffer commandBuffer, std::string objectType, vk::Buffer& boundIndexBuffer) {
+	vk::Buffer indexBuffer;
+	vk::IndexType indexType = vk::IndexType::eUint32;
+	if (clusterDrawStarts.count(objectType)) {
+		indexBuffer = clusterCuller->getIndexBuffer();
+	}
+	else {
+		indexType = meshes->indexTypes.at(objectType);
+		indexBuffer = indexType == vk::IndexType::eUint16 ? meshes->shortIndexBuffer.buffer : meshes->indexBuffer.buffer;
+	}
+
+	if (indexBuffer == boundIndexBuffer) {
+		return;
+	}
+
+	commandBuffer.bindIndexBuffer(indexBuffer, 0, indexType);
+	boundIndexBuffer = indexBuffer;
+}
+
+// the culler wrote one command per instance, each already pointing at its model transform
+void Engine::drawClusters(vk::CommandBuffer commandBuffer, std::string objectType, uint32_t instanceCount) {
+	vk::Buffer indirectBuffer = clusterCuller->getIndirectBuffer();
+	vk::DeviceSize stride = sizeof(vk::DrawIndexedIndirectCommand);
+	vk::DeviceSize offset = clusterDrawStarts.at(objectType) * stride;
+	if (multiDrawIndirect) {
+		commandBuffer.drawIndexedIndirect(indirectBuffer, offset, instanceCount, static_cast<uint32_t>(stride));
+		return;
+	}
 
-	int indexCount = meshes->indexCounts.find(objectType)->second;
-	int firstIndex = meshes->firstIndices.find(objectType)->second;
-	textures[objectType]->use(commandBuffer, pipelineLayouts[RenderPassType::FORWARD], 2);
-	commandBuffer.drawIndexed(indexCount, instanceCount, firstIndex, 0, startInstance);
-	startInstance += instanceCount;
+	for (uint32_t i = 0; i < instanceCount; i++) {
+		commandBuffer.drawIndexedIndirect(indirectBuffer, offset + i * stride, 1, static_cast<uint32_t>(stride));
+	}
 }
 
-void Engine::renderObjectsPrepass(vk::CommandBuffer commandBuffer, std::string objectType, uint32_t& startInstance, uint32_t instanceCount) {
-	int indexCount = meshes->indexCounts.find(objectType)->second;
-	int firstIndex = meshes->firstIndices.find(objectType)->second;
-	textures[objectType]->use(commandBuffer, pipelineLayouts[RenderPassType::PREPASS], 1);
-	commandBuffer.drawIndexed(indexCount, instanceCount, firstIndex, 0, startInstance);
-	startInstance += instanceCount;
+// every mesh pass draws the same way, only the layout and the set its textures go in differ
+void Engine::drawMesh(vk::CommandBuffer commandBuffer, RenderPassType passType, uint32_t textureSet, std::string objectType, uint32_t& startInstance, uint32_t instanceCount) {
+	textures[objectType]->use(commandBuffer, pipelineLayouts[passType], textureSet);
+	if (meshes->vertexFormats.at(objectType) == vkMesh::VertexFormat::COMPACT) {
+		commandBuffer.pushConstants(compactPipelineLayouts[passType], vk::ShaderStageFlagBits::eVertex, 0, sizeof(vkMesh::MeshBounds), &meshes->meshBounds.at(objectType));
+	}
+	if (clusterDrawStarts.count(objectType)) {
+		drawClusters(commandBuffer, objectType, instanceCount);
+		startInstance += instanceCount;
+		return;
+	}
+	// one instanced draw per level, prepareFrame wrote the transforms in the same order
+	int baseVertex = meshes->baseVertices.find(objectType)->second;
+	const std::vector<vkMesh::MeshLod>& lods = meshes->meshLods.at(objectType);
+	const std::vector<uint32_t>& lodCounts = lodInstanceCounts.at(objectType);
+	for (size_t lod = 0; lod < lods.size(); lod++) {
+		if (lodCounts[lod] == 0) {
+			continue;
+		}
+
+		commandBuffer.drawIndexed(lods[lod].indexCount, lodCounts[lod], lods[lod].firstIndex, baseVertex, startInstance);
+		startInstance += lodCounts[lod];
+	}
 }
 
 void Engine::drawPrepass(vk::CommandBuffer commandBuffer, uint32_t imageIndex, Scene* scene) {
@@ -453,10 +603,14 @@ void Engine::drawPrepass(vk::CommandBuffer commandBuffer, uint32_t imageIndex, S
 
 	// pass in data
 	uint32_t startInstance = 0;
+	vkMesh::VertexFormat boundFormat = vkMesh::VertexFormat::FLOAT;
+	vk::Buffer boundIndexBuffer = meshes->indexBuffer.buffer;
 	for (std::pair<std::string, std::vector<talos::MeshActor>> pair : scene->gameObjects) {
 		talos::MeshActor meshActor = pair.second[0];
 		if (meshActor.getStaticMesh()->renderPass == "PREPASS") {
-			renderObjectsPrepass(commandBuffer, pair.first, startInstance, pair.second.size());
+			useVertexFormat(commandBuffer, RenderPassType::PREPASS, meshes->vertexFormats.at(pair.first), boundFormat);
+			useIndexBuffer(commandBuffer, pair.first, boundIndexBuffer);
+			drawMesh(commandBuffer, RenderPassType::PREPASS, 1, pair.first, startInstance, pair.second.size());
 		}
 	}
 
@@ -489,10 +643,14 @@ void Engine::drawStandard(vk::CommandBuffer commandBuffer, uint32_t imageIndex,
 
 	// pass in data
 	uint32_t startInstance = 0;
+	vkMesh::VertexFormat boundFormat = vkMesh::VertexFormat::FLOAT;
+	vk::Buffer boundIndexBuffer = meshes->indexBuffer.buffer;
 	for (std::pair<std::string, std::vector<talos::MeshActor>> pair : scene->gameObjects) {
 		talos::MeshActor meshActor = pair.second[0];
 		if (meshActor.getStaticMesh()->renderPass == "FORWARD") {
-			renderObjectsPrepass(commandBuffer, pair.first, startInstance, pair.second.size());
+			useVertexFormat(commandBuffer, RenderPassType::FORWARD, meshes->vertexFormats.at(pair.first), boundFormat);
+			useIndexBuffer(commandBuffer, pair.first, boundIndexBuffer);
+			drawMesh(commandBuffer, RenderPassType::FORWARD, 2, pair.first, startInstance, pair.second.size());
 		}
 	}
 
@@ -562,6 +720,19 @@ void Engine::render(Scene* scene) {
 		scene->assetsLoaded = true;
 	}
 
+	// before this frame's fence, a texture changing images waits for every frame anyway
+	textureStreamer.update();
+
+	// the culler's descriptor sets have to follow meshlets that switched to their copies
+	if (defragmenter.update() && clusterCuller) {
+		clusterCuller->setMeshletBuffers(meshes->meshletBuffer, meshes->meshletVertexBuffer, meshes->meshletTriangleBuffer);
+	}
+
+	if (debugMode && glfwGetTime() - lastMemoryReport >= MEMORY_REPORT_INTERVAL) {
+		allocator.report();
+		lastMemoryReport = glfwGetTime();
+	}
+
 	device.waitForFences(1, &swapChainFrames[frameNumber].inFlightFence, VK_TRUE, UINT64_MAX);
 	device.resetFences(1, &swapChainFrames[frameNumber].inFlightFence);
 	uint32_t imageIndex;
@@ -594,6 +765,11 @@ void Engine::render(Scene* scene) {
 		return;
 	}
 
+	// culled index streams have to be written before either mesh pass reads them
+	if (clusterCuller) {
+		clusterCuller->record(commandBuffer);
+	}
+
 	if (scene->isPassRequired(RenderPassType::SKY)) {
 		drawSky(commandBuffer, imageIndex, scene);
 	}
@@ -634,22 +810,23 @@ void Engine::render(Scene* scene) {
 	/*
 		Setup textures from prepass
 	*/
+	// recorded ahead of the passes that sample them, so they ride along with the frame's own submission
 	vkImage::ImageLayoutTransitionInput layoutTransition;
 	layoutTransition.image = swapChainFrames[imageIndex].albedoBuffer;
 	layoutTransition.arrayCount = 1;
-	layoutTransition.commandBuffer = mainCommandBuffer;
+	layoutTransition.commandBuffer = commandBuffer;
 	layoutTransition.oldLayout = vk::ImageLayout::eColorAttachmentOptimal;
 	layoutTransition.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
 	layoutTransition.queue = graphicsQueue;
-	vkImage::transitionImageLayout(layoutTransition);
+	vkImage::recordLayoutTransition(layoutTransition);
 
 	layoutTransition.image = swapChainFrames[imageIndex].normalBuffer;
-	vkImage::transitionImageLayout(layoutTransition);
+	vkImage::recordLayoutTransition(layoutTransition);
 
 	layoutTransition.image = swapChainFrames[imageIndex].prepassDepthBuffer;
 	layoutTransition.oldLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
 	layoutTransition.aspect = vk::ImageAspectFlagBits::eDepth;
-	vkImage::transitionImageLayout(layoutTransition);
+	vkImage::recordLayoutTransition(layoutTransition);
 
 	if (scene->isPassRequired(RenderPassType::FORWARD)) {
 		drawStandard(commandBuffer, imageIndex, scene);
@@ -708,6 +885,14 @@ void Engine::render(Scene* scene) {
 	frameNumber = (frameNumber + 1) % maxFramesInFlight;
 }
 
+vkUtilities::MemoryStatistics Engine::getMemoryStatistics() {
+	return allocator.getStatistics();
+}
+
+const vkUtilities::DefragmentationStatistics& Engine::getDefragmentationStatistics() const {
+	return defragmenter.getStatistics();
+}
+
 void Engine::makeWorkerThreads() {
 	size_t threadCount = std::thread::hardware_concurrency() - 1;
 
@@ -733,8 +918,15 @@ void Engine::endWorkerThreads() {
 void Engine::makeAssets(Scene* scene) {
 	meshes = new VertexCollection();
 
+	if (cookedAssets.load() && debugMode) {
+		std::cout << "Found " << cookedAssets.size() << " cooked assets" << std::endl;
+	}
+
 	std::unordered_map<std::string, std::vector<std::string>> modelPaths;
 	std::unordered_map<std::string, std::vector<std::string>> texturePaths;
+	std::unordered_map<std::string, vkMesh::VertexFormat> vertexFormats;
+	std::unordered_map<std::string, bool> overdrawOptimized;
+	std::unordered_map<std::string, bool> clusterCulled;
 
 	// Load all game objects needed for the scene
 	for (std::string gameObjectPath : scene->gameObjectAssetPaths) {
@@ -745,13 +937,33 @@ void Engine::makeAssets(Scene* scene) {
 
 		modelPaths.insert({ gameObjectPath, combinedModelMaterialPaths });
 		texturePaths.insert({ gameObjectPath, assetPaths.at("texture") });
+
+		// optional "vertexformat compact" line, anything else keeps full float vertices
+		vkMesh::VertexFormat vertexFormat = vkMesh::VertexFormat::FLOAT;
+		if (assetPaths.count("vertexformat") && assetPaths.at("vertexformat")[0] == "compact") {
+			vertexFormat = vkMesh::VertexFormat::COMPACT;
+		}
+		vertexFormats.insert({ gameObjectPath, vertexFormat });
+		// only scenes that use compact meshes pay for their pipelines
+		if (vertexFormat == vkMesh::VertexFormat::COMPACT && compactPipelines.empty()) {
+			setupCompactPipelines();
+		}
+
+		// optional "optimize overdraw" line, vertex cache and fetch ordering always happen
+		bool optimizeOverdraw = assetPaths.count("optimize") && assetPaths.at("optimize")[0] == "overdraw";
+		overdrawOptimized.insert({ gameObjectPath, optimizeOverdraw });
+
+		// optional "cull clusters" line splits the mesh into meshlets the gpu culls every frame
+		bool cullClusters = assetPaths.count("cull") && assetPaths.at("cull")[0] == "clusters";
+		clusterCulled.insert({ gameObjectPath, cullClusters });
 	}
 
 	// Make descriptor pool
 	vkInit::DescriptorSetLayoutData texLayoutData;
 	texLayoutData.count = 1;
 	texLayoutData.types.push_back(vk::DescriptorType::eCombinedImageSampler);
-	meshDescPool = vkInit::createDescriptorPool(device, static_cast<uint32_t>(texturePaths.size() + 1 + 3 * swapChainFrames.size()), texLayoutData);
+	// textures and the skybox get a second set each to switch to when the defragmenter moves them
+	meshDescPool = vkInit::createDescriptorPool(device, static_cast<uint32_t>(2 * (texturePaths.size() + 1) + 3 * swapChainFrames.size()), texLayoutData);
 
 	// Allocate descriptors for the buffers
 	for (int i = 0; i < maxFramesInFlight; i++) {
@@ -760,14 +972,30 @@ void Engine::makeAssets(Scene* scene) {
 
 	std::unordered_map<std::string, vkMesh::ObjMesh> loadedMeshes;
 	for (std::pair<std::string, std::vector<std::string>> pair : modelPaths) {
-		vkMesh::ObjMesh mesh{}; 
-		loadedMeshes.emplace(pair.first, mesh);
-		// w might need to be zero
-		glm::mat4 preTransform = glm::mat4(1.0f);
-		preTransform[3][3] = 0.0f;
-		workQueue.add(new vkJob::LoadModelJob(loadedMeshes[pair.first], pair.second[0], pair.second[1], preTransform));
+		// meshes own their cache mappings, so build them in place
+		loadedMeshes.try_emplace(pair.first);
+		// big obj files hand their parse chunks back to the same workers
+		loadedMeshes[pair.first].chunkQueue = &workQueue;
+		loadedMeshes[pair.first].optimizeOverdraw = overdrawOptimized.at(pair.first);
+		loadedMeshes[pair.first].debug = debugMode;
+
+		// cooked meshes still go to a worker, their blocks decompress across the others
+		vkJob::LoadModelJob* loadJob = new vkJob::LoadModelJob(loadedMeshes[pair.first], pair.second[0], pair.second[1], vkMesh::makeModelPreTransform());
+		const vkCook::CookedAsset* cooked = cookedAssets.find("mesh", pair.first);
+		if (cooked) {
+			loadJob->cookedPath = cooked->cookedPath;
+			loadJob->cookedHash = cooked->sourceHash;
+		}
+		workQueue.add(loadJob);
 	}
 
+	vkUtilities::StagingRingInput ringInput;
+	ringInput.device = device;
+	ringInput.physicalDevice = physicalDevice;
+	ringInput.size = STAGING_RING_SIZE;
+	ringInput.allocator = &allocator;
+	stagingRing.create(ringInput);
+
 	vkImage::TextureInput texInfo;
 
 	texInfo.device = device;
@@ -776,6 +1004,12 @@ void Engine::makeAssets(Scene* scene) {
 	texInfo.pool = meshDescPool;
 	texInfo.texType = vk::ImageViewType::e2D;
 	texInfo.dstBinding = 0;
+	texInfo.cookedAssets = &cookedAssets;
+	texInfo.jobQueue = &workQueue;
+	texInfo.streamingStartSize = vkImage::TEXTURE_STREAMING_START_SIZE;
+	texInfo.stagingRing = &stagingRing;
+	texInfo.uploadQueues = uploadQueues;
+	texInfo.allocator = &allocator;
 
 	/*for (const auto& [object, filename] : texturePaths) {
 		texInfo.filename = filename;
@@ -790,24 +1024,48 @@ void Engine::makeAssets(Scene* scene) {
 		workQueue.add(new vkJob::LoadTextureJob(textures[object], texInfo));
 	}
 
-	makeWorkerThreads();
-
-	// Prepare skybox
+	// the skybox is just another job, its faces decode alongside the models and textures
 	for (std::string skyboxPath : scene->skyboxes) {
 		std::unordered_map<std::string, std::vector<std::string>> skyboxPaths = talos::util::getAssetDependencies(skyboxPath.c_str(), debugMode);
-		texInfo.commandBuffer = mainCommandBuffer;
-		texInfo.queue = graphicsQueue;
 		texInfo.layout = meshDescLayout[RenderPassType::SKY];
 		texInfo.texType = vk::ImageViewType::eCube;
 		texInfo.filename = skyboxPaths.at("texture");
+		texInfo.streamingStartSize = 0;
 		skybox = new vkImage::Texture{};
-		skybox->load(texInfo);
+		workQueue.add(new vkJob::LoadTextureJob(skybox, texInfo));
 	}
 
+	makeWorkerThreads();
+
+	// rather than sit in join, the main thread works the queue too
+	vkJob::WorkerThread(workQueue, mainCommandBuffer, graphicsQueue)();
+
 	endWorkerThreads();
 
-	for (auto meshPair : loadedMeshes) {
-		meshes->consume(meshPair.first, meshPair.second.vertices, meshPair.second.indices);
+	// the finer levels of big cooked textures come in once something is close enough to need them
+	vkImage::TextureStreamerInput streamerInput;
+	streamerInput.device = device;
+	streamerInput.commandBuffer = mainCommandBuffer;
+	streamerInput.queue = graphicsQueue;
+	streamerInput.budget = TEXTURE_STREAMING_BUDGET;
+	streamerInput.allocator = &allocator;
+	streamerInput.stagingRing = &stagingRing;
+	streamerInput.uploadQueues = uploadQueues;
+	streamerInput.debug = debugMode;
+	textureStreamer.create(streamerInput);
+	for (const auto& [object, texture] : textures) {
+		textureStreamer.add(texture);
+	}
+
+	for (const auto& [object, mesh] : loadedMeshes) {
+		meshes->consume(object, mesh.getVertexData(), mesh.getVertexCount(), mesh.getIndexData(), mesh.getIndexCount(), mesh.getMaterialData(), mesh.getMaterialCount(), vertexFormats.at(object));
+		// culled meshes always draw their full detail meshlets
+		if (clusterCulled.at(object)) {
+			meshes->buildClusters(object, mesh.getVertexData(), mesh.getVertexCount(), mesh.getIndexData(), mesh.getIndexCount());
+		}
+		else {
+			meshes->consumeLods(object, mesh.getLodData(), mesh.getLodCount(), mesh.getLodIndexData());
+		}
 	}
 
 	FinalizationInput input;
@@ -815,7 +1073,86 @@ void Engine::makeAssets(Scene* scene) {
 	input.physicalDevice = physicalDevice;
 	input.queue = graphicsQueue;
 	input.commandBuffer = mainCommandBuffer;
+	input.stagingRing = &stagingRing;
+	input.uploadQueues = uploadQueues;
+	input.allocator = &allocator;
 	meshes->finalize(input);
+
+	makeClusterCuller(scene);
+	makeDefragmenter();
+}
+
+void Engine::makeDefragmenter() {
+	vkUtilities::DefragmenterInput defragmenterInput;
+	defragmenterInput.device = device;
+	defragmenterInput.allocator = &allocator;
+	defragmenterInput.queue = graphicsQueue;
+	defragmenterInput.queueFamily = uploadQueues.graphicsFamily;
+	defragmenterInput.framesInFlight = static_cast<uint32_t>(maxFramesInFlight);
+	defragmenterInput.stagingRing = &stagingRing;
+	defragmenterInput.debug = debugMode;
+	defragmenter.create(defragmenterInput);
+
+	for (const auto& [object, texture] : textures) {
+		defragmenter.add(texture);
+	}
+	if (skybox) {
+		defragmenter.add(skybox);
+	}
+
+	// the defragmenter keeps pointers, so every buffer is wrapped before any is added
+	for (Buffer* buffer : meshes->getBuffers()) {
+		meshBuffers.push_back(vkUtilities::RelocatableBuffer(device, buffer));
+	}
+	for (vkUtilities::RelocatableBuffer& buffer : meshBuffers) {
+		defragmenter.add(&buffer);
+	}
+}
+
+void Engine::makeClusterCuller(const Scene* scene) {
+	if (meshes->meshletCounts.empty()) {
+		return;
+	}
+
+	vkMesh::ClusterCullerInput cullerInput;
+	cullerInput.device = device;
+	cullerInput.physicalDevice = physicalDevice;
+	cullerInput.allocator = &allocator;
+	cullerInput.frameCount = static_cast<uint32_t>(swapChainFrames.size());
+	// matches the model transforms a frame holds
+	cullerInput.maxDraws = 1024;
+	cullerInput.maxOutputIndices = 0;
+	cullerInput.maxMeshletsPerDraw = 0;
+	for (std::pair<std::string, std::vector<talos::MeshActor>> pair : scene->gameObjects) {
+		if (!meshes->meshletCounts.count(pair.first)) {
+			continue;
+		}
+
+		// room for every instance to come through unculled
+		cullerInput.maxOutputIndices += static_cast<vk::DeviceSize>(meshes->indexCounts.at(pair.first)) * pair.second.size();
+		cullerInput.maxMeshletsPerDraw = std::max(cullerInput.maxMeshletsPerDraw, meshes->meshletCounts.at(pair.first));
+	}
+
+	if (cullerInput.maxOutputIndices == 0) {
+		return;
+	}
+
+	cullerInput.meshletBuffer = meshes->meshletBuffer;
+	cullerInput.meshletBufferSize = meshes->meshletBufferSize;
+	cullerInput.meshletVertexBuffer = meshes->meshletVertexBuffer;
+	cullerInput.meshletVertexBufferSize = meshes->meshletVertexBufferSize;
+	cullerInput.meshletTriangleBuffer = meshes->meshletTriangleBuffer;
+	cullerInput.meshletTriangleBufferSize = meshes->meshletTriangleBufferSize;
+	cullerInput.debug = debugMode;
+
+	clusterCuller = new vkMesh::ClusterCuller();
+	if (!clusterCuller->create(cullerInput)) {
+		// without a culler nothing fills clusterDrawStarts, so those meshes draw their full level like any other
+		std::cout << "Cluster culling is unavailable, culled meshes will be drawn whole" << std::endl;
+		clusterCuller->destroy();
+		delete clusterCuller;
+		clusterCuller = nullptr;
+	}
 }
 
 void Engine::prepareFrame(uint32_t imageIndex, const Scene* scene) {
@@ -846,15 +1183,37 @@ void Engine::prepareFrame(uint32_t imageIndex, const Scene* scene) {
 	frame.cameraMatrixData.viewProjection = projection * view;
 	memcpy(frame.cameraMatrixWriteLocation, &(frame.cameraMatrixData), sizeof(vkUtilities::CameraMatrices));
 
+	// how far one model unit at distance one spans on screen, in pixels
+	float pixelsPerUnit = 0.5f * static_cast<float>(swapChainExtent.height) * std::abs(projection[1][1]);
+
+	// instances are grouped by level of detail so each level of each mesh stays one instanced draw
 	size_t i = 0;
+	lodInstanceCounts.clear();
 	for (std::pair<std::string, std::vector<talos::MeshActor>> pair : scene->gameObjects) {
+		std::vector<uint32_t>& lodCounts = lodInstanceCounts[pair.first];
+		lodCounts.assign(meshes->meshLods.at(pair.first).size(), 0);
+
+		std::vector<uint32_t> instanceLods;
+		instanceLods.reserve(pair.second.size());
 		for (talos::MeshActor& meshActor : pair.second) {
-			frame.modelTransforms[i] = glm::translate(glm::mat4(1.0f), meshActor.getTransform()->position);
-			i++;
+			uint32_t lod = selectLod(pair.first, meshActor.getTransform()->position, view, pixelsPerUnit);
+			instanceLods.push_back(lod);
+			lodCounts[lod]++;
+
+			textureStreamer.request(textures[pair.first], selectTextureLevel(pair.first, meshActor.getTransform()->position, view, pixelsPerUnit));
+		}
+
+		for (uint32_t lod = 0; lod < lodCounts.size(); lod++) {
+			for (size_t j = 0; j < pair.second.size(); j++) {
+				if (instanceLods[j] == lod) {
+					frame.modelTransforms[i] = glm::translate(glm::mat4(1.0f), pair.second[j].getTransform()->position);
+					i++;
+				}
+			}
 		}
 	}
 
-	memcpy(frame.modelTransformWriteLocation, frame.modelTransforms.data(), scene->gameObjects.size() * sizeof(glm::mat4));
+	memcpy(frame.modelTransformWriteLocation, frame.modelTransforms.data(), i * sizeof(glm::mat4));
 
 	// Create transformed lights and pass them over
 	std::vector<Light> lightsInCS;
@@ -866,22 +1225,115 @@ void Engine::prepareFrame(uint32_t imageIndex, const Scene* scene) {
 	// TODO: Figure out how to force all data through
 	memcpy(frame.lightWriteLocation, &(frame.lightData), sizeof(glm::vec4) * 2 * 16 + sizeof(glm::vec4));
 
+	frame.materialBufferDescriptor.buffer = meshes->materialBuffer.buffer;
+	frame.materialBufferDescriptor.offset = 0;
+	frame.materialBufferDescriptor.range = meshes->materialBufferSize;
+
 	frame.createDescriptorSets();
 	frame.writeDescriptorSets();
+
+	if (clusterCuller) {
+		// one draw per instance of each culled mesh, each with its own run of the output indices
+		std::vector<vkMesh::ClusterDraw> clusterDraws;
+		std::vector<int32_t> clusterBaseVertices;
+		uint32_t instance = 0;
+		uint32_t firstIndex = 0;
+		clusterDrawStarts.clear();
+		for (std::pair<std::string, std::vector<talos::MeshActor>> pair : scene->gameObjects) {
+			if (!meshes->meshletCounts.count(pair.first)) {
+				instance += static_cast<uint32_t>(pair.second.size());
+				continue;
+			}
+
+			clusterDrawStarts.insert({ pair.first, static_cast<uint32_t>(clusterDraws.size()) });
+			for (size_t j = 0; j < pair.second.size(); j++) {
+				clusterDraws.push_back({ meshes->firstMeshlets.at(pair.first), meshes->meshletCounts.at(pair.first), instance, firstIndex });
+				clusterBaseVertices.push_back(meshes->baseVertices.at(pair.first));
+				firstIndex += static_cast<uint32_t>(meshes->indexCounts.at(pair.first));
+				instance++;
+			}
+		}
+
+		vkMesh::CullingConstants culling{};
+		vkMesh::extractFrustumPlanes(frame.cameraMatrixData.viewProjection, culling.frustumPlanes);
+		culling.cameraPosition = glm::vec4(eye, 1.0f);
+		clusterCuller->prepareFrame(imageIndex, clusterDraws, clusterBaseVertices, culling, frame.modelBufferDescriptor);
+	}
+}
+
+// the coarsest level whose simplification error still projects to under LOD_PIXEL_ERROR pixels
+uint32_t Engine::selectLod(std::string objectType, const glm::vec3& position, const glm::mat4& view, float pixelsPerUnit) {
+	const std::vector<vkMesh::MeshLod>& lods = meshes->meshLods.at(objectType);
+	glm::vec4 sphere = meshes->boundingSpheres.at(objectType);
+
+	// measured to the nearest point of the bounding sphere, so big meshes don't coarsen while the camera is close to one end
+	glm::vec3 center = glm::vec3(view * glm::vec4(position + glm::vec3(sphere), 1.0f));
+	float distance = glm::length(center) - sphere.w;
+	if (distance <= 0.0f) {
+		return 0;
+	}
+
+	uint32_t selected = 0;
+	for (uint32_t lod = 1; lod < lods.size(); lod++) {
+		if (lods[lod].error * pixelsPerUnit / distance > LOD_PIXEL_ERROR) {
+			break;
+		}
+		selected = lod;
+	}
+
+	return selected;
 }
 
-void Engine::prepareScene(vk::CommandBuffer commandBuffer) {
-	vk::Buffer vertexBuffers[] = { meshes->vertexBuffer.buffer };
+// the coarsest mip whose texels are still no bigger than a pixel across the instance's bounding sphere on screen
+uint32_t Engine::selectTextureLevel(std::string objectType, const glm::vec3& position, const glm::mat4& view, float pixelsPerUnit) {
+	const vkImage::Texture* texture = textures.at(objectType);
+	glm::vec4 sphere = meshes->boundingSpheres.at(objectType);
+
+	glm::vec3 center = glm::vec3(view * glm::vec4(position + glm::vec3(sphere), 1.0f));
+	float distance = glm::length(center);
+	if (distance <= sphere.w) {
+		return 0;
+	}
+
+	// assumes the texture is spread once over the mesh, which holds for the atlased models the engine loads
+	float footprint = 2.0f * sphere.w * pixelsPerUnit / distance;
+	float texelsPerPixel = static_cast<float>(texture->getWidth()) / std::max(footprint, 1.0f);
+	if (texelsPerPixel <= 1.0f) {
+		return 0;
+	}
+
+	return std::min(static_cast<uint32_t>(std::floor(std::log2(texelsPerPixel))), texture->getMipLevelCount() - 1);
+}
+
+void Engine::prepareScene(vk::CommandBuffer commandBuffer, vkMesh::VertexStream stream) {
+	// the position stream shares vertex numbering with the full one, so the same index buffers and base vertices work for both
+	vk::Buffer vertexBuffers[] = { stream == vkMesh::VertexStream::POSITION_ONLY ? meshes->positionBuffer.buffer : meshes->vertexBuffer.buffer };
 	vk::DeviceSize offsets[] = { 0 };
-	commandBuffer.bindVertexBuffers(0, 1, vertexBuffers, offsets);
-	commandBuffer.bindIndexBuffer(meshes->indexBuffer.buffer, 0, vk::IndexType::eUint32);
+	// a scene made only of compact meshes has no float vertices to bind
+	if (vertexBuffers[0]) {
+		commandBuffer.bindVertexBuffers(0, 1, vertexBuffers, offsets);
+	}
+	// 16 bit meshes rebind as they're drawn, see useIndexBuffer
+	if (meshes->indexBuffer.buffer) {
+		commandBuffer.bindIndexBuffer(meshes->indexBuffer.buffer, 0, vk::IndexType::eUint32);
+	}
 }
 
 Engine::~Engine() {
 
 	device.waitIdle();
 
+	// originals still held for frames in flight belong to the textures and buffers below
+	defragmenter.destroy();
+
+	if (clusterCuller) {
+		clusterCuller->destroy();
+		delete clusterCuller;
+	}
+
 	delete meshes;
+	textureStreamer.destroy();
+	stagingRing.destroy();
 	for (const auto& [object, texture] : textures) {
 		texture->destroyImage();
 		texture->destroySampler();
@@ -911,6 +1363,10 @@ Engine::~Engine() {
 		device.destroyRenderPass(renderPasses[RenderPassType::PREPASS]);
 		device.destroyPipelineLayout(pipelineLayouts[RenderPassType::PREPASS]);
 		device.destroyPipeline(pipelines[RenderPassType::PREPASS]);
+		device.destroyPipelineLayout(compactPipelineLayouts[RenderPassType::FORWARD]);
+		device.destroyPipeline(compactPipelines[RenderPassType::FORWARD]);
+		device.destroyPipelineLayout(compactPipelineLayouts[RenderPassType::PREPASS]);
+		device.destroyPipeline(compactPipelines[RenderPassType::PREPASS]);
 		device.destroyRenderPass(renderPasses[RenderPassType::DEFERRED]);
 		device.destroyPipelineLayout(pipelineLayouts[RenderPassType::DEFERRED]);
 		device.destroyPipeline(pipelines[RenderPassType::DEFERRED]);
@@ -925,6 +1381,7 @@ Engine::~Engine() {
 		device.destroyDescriptorSetLayout(meshDescLayout[RenderPassType::DEFERRED]);
 		device.destroyDescriptorSetLayout(fragmentDescLayout[RenderPassType::DEFERRED]);
 		device.destroyDescriptorPool(meshDescPool);
+		allocator.destroy();
 		device.destroy();
 	}
 
@@ -7,14 +7,28 @@
 #include "utilities/SwapChainFrame.h"
 #include "gameobjects/Scene.h"
 #include "mesh/VertexCollection.h"
+#include "mesh/ClusterCuller.h"
+#include "cook/CookManifest.h"
 #include "image/Image.h"
 #include "image/Texture.h"
+#include "image/TextureStreamer.h"
+#include "utilities/Defragmenter.h"
 #include "job/Job.h"
 #include "job/WorkerThread.h"
 #include "pipeline/PipelineInput.h"
 #include "pipeline/Pipeline.h"
 #include "gameobjects/MeshActor.h"
 
+// how many pixels a level of detail's simplification error may cover before a finer level is drawn instead
+static const float LOD_PIXEL_ERROR = 1.0f;
+
+// device memory streamed textures may hold between them
+static const vk::DeviceSize TEXTURE_STREAMING_BUDGET = 256 * 1024 * 1024;
+// host visible memory every upload stages through, room for an uncooked 2048 cubemap in one go
+static const vk::DeviceSize STAGING_RING_SIZE = 128 * 1024 * 1024;
+// seconds between device memory reports in debug mode
+static const double MEMORY_REPORT_INTERVAL = 10.0;
+
 class Engine {
 	public:
 		Engine(int width, int height, GLFWwindow* window, bool debugMode);
@@ -27,6 +41,11 @@ class Engine {
 
 		void render(Scene* scene);
 
+		// device memory per heap and category, with the driver's budget when it reports one
+		vkUtilities::MemoryStatistics getMemoryStatistics();
+		// fragmentation before and after the defragmenter's pass in progress, or its last one
+		const vkUtilities::DefragmentationStatistics& getDefragmentationStatistics() const;
+
 	private:
 		bool debugMode = true;
 
@@ -47,10 +66,17 @@ class Engine {
 
 		// logical device
 		vk::Device device{ nullptr };
+		bool multiDrawIndirect = false;
+		// every buffer and image the engine makes is placed in its blocks
+		vkUtilities::DeviceAllocator allocator;
+		double lastMemoryReport = 0.0;
 
 		// create graphics queue
 		vk::Queue graphicsQueue{ nullptr };
 		vk::Queue presentQueue{ nullptr };
+		// the graphics queue again on devices without a dedicated transfer family
+		vk::Queue transferQueue{ nullptr };
+		vkUtilities::UploadQueues uploadQueues;
 
 		// swap chain
 		vk::SwapchainKHR swapChain;
@@ -62,6 +88,9 @@ class Engine {
 		std::unordered_map<RenderPassType, vk::PipelineLayout> pipelineLayouts;
 		std::unordered_map<RenderPassType, vk::RenderPass>renderPasses;
 		std::unordered_map<RenderPassType, vk::Pipeline> pipelines;
+		// variants of the mesh pipelines that read vkMesh::CompactVertex
+		std::unordered_map<RenderPassType, vk::PipelineLayout> compactPipelineLayouts;
+		std::unordered_map<RenderPassType, vk::Pipeline> compactPipelines;
 
 		// Command related
 		vk::CommandPool commandPool;
@@ -83,8 +112,21 @@ class Engine {
 
 		// Available Assets
 		VertexCollection* meshes;
+		// only made when some mesh asked for "cull clusters"
+		vkMesh::ClusterCuller* clusterCuller = nullptr;
+		// where each culled mesh's first instance sits in the frame's indirect commands
+		std::unordered_map<std::string, uint32_t> clusterDrawStarts;
+		// how many of each mesh's instances draw at each level of detail this frame, their transforms are written level by level
+		std::unordered_map<std::string, std::vector<uint32_t>> lodInstanceCounts;
 		std::unordered_map<std::string, vkImage::Texture*> textures;
-		vkImage::Texture* skybox;
+		vkImage::Texture* skybox = nullptr;
+		vkImage::TextureStreamer textureStreamer;
+		// packs textures and mesh lumps back together as content comes and goes
+		vkUtilities::Defragmenter defragmenter;
+		std::vector<vkUtilities::RelocatableBuffer> meshBuffers;
+		vkUtilities::StagingRing stagingRing;
+		// what talos-cook already prepared, read once before any asset loads
+		vkCook::CookManifest cookedAssets;
 		vkJob::JobQueue workQueue;
 		std::vector<std::thread> workers;
 
@@ -101,6 +143,7 @@ class Engine {
 		// pipeline setup
 		void createDescriptorSetLayouts();
 		void setupPipeline();
+		void setupCompactPipelines();
 		void addPipeline(vkInit::PipelineBuilder pipelineBuilder, vkInit::PipelineInput pipelineInput);
 		
 		void finalizeSetup();
@@ -111,10 +154,16 @@ class Engine {
 		void makeWorkerThreads();
 		void makeAssets(Scene* scene);
 		void endWorkerThreads();
-		void prepareScene(vk::CommandBuffer commandBuffer);
+		void prepareScene(vk::CommandBuffer commandBuffer, vkMesh::VertexStream stream = vkMesh::VertexStream::FULL);
 		void prepareFrame(uint32_t imageIndex, const Scene* scene);
-		void renderObjects(vk::CommandBuffer commandBuffer, std::string objectType, uint32_t& startInstance, uint32_t instanceCount);
-		void renderObjectsPrepass(vk::CommandBuffer commandBuffer, std::string objectType, uint32_t& startInstance, uint32_t instanceCount);
+		uint32_t selectLod(std::string objectType, const glm::vec3& position, const glm::mat4& view, float pixelsPerUnit);
+		uint32_t selectTextureLevel(std::string objectType, const glm::vec3& position, const glm::mat4& view, float pixelsPerUnit);
+		void useVertexFormat(vk::CommandBuffer commandBuffer, RenderPassType passType, vkMesh::VertexFormat format, vkMesh::VertexFormat& boundFormat);
+		void useIndexBuffer(vk::CommandBuffer commandBuffer, std::string objectType, vk::Buffer& boundIndexBuffer);
+		void makeClusterCuller(const Scene* scene);
+		void makeDefragmenter();
+		void drawClusters(vk::CommandBuffer commandBuffer, std::string objectType, uint32_t instanceCount);
+		void drawMesh(vk::CommandBuffer commandBuffer, RenderPassType passType, uint32_t textureSet, std::string objectType, uint32_t& startInstance, uint32_t instanceCount);
 		void drawStandard(vk::CommandBuffer commandBuffer, uint32_t imageIndex, Scene* scene);
 		void drawPrepass(vk::CommandBuffer commandBuffer, uint32_t imageIndex, Scene* scene);
 		void drawDeferred(vk::CommandBuffer commandBuffer, uint32_t imageIndex, Scene* scene);
@@ -18,17 +18,57 @@
 #include <glm/common.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+namespace vkUtilities {
+	class DeviceAllocator;
+	struct MemoryBlock;
+
+	// what device memory is spent on, the allocator keeps a tally of each
+	enum class MemoryCategory {
+		MESH,
+		TEXTURE,
+		GBUFFER,
+		// uniform and storage buffers written every frame
+		FRAME,
+		STAGING,
+		OTHER
+	};
+	static const uint32_t MEMORY_CATEGORY_COUNT = 6;
+
+	// a range of device memory, resources are bound at its offset since a block's memory is shared
+	struct Allocation {
+		vk::DeviceMemory memory;
+		vk::DeviceSize offset = 0;
+		vk::DeviceSize size = 0;
+		// host visible memory stays mapped while it's allocated, this is the range's first byte
+		unsigned char* data = nullptr;
+		// null for memory made without an allocator
+		DeviceAllocator* allocator = nullptr;
+		// null for memory allocated on its own rather than in a block
+		MemoryBlock* block = nullptr;
+		uint32_t node = 0;
+		// where the range is counted, so freeing it takes it off the same tally
+		MemoryCategory category = MemoryCategory::OTHER;
+		uint32_t heap = 0;
+	};
+}
+
 struct BufferInput {
 	size_t size;
 	vk::BufferUsageFlags usage;
 	vk::Device device;
 	vk::PhysicalDevice physicalDevice;
 	vk::MemoryPropertyFlags memoryProperties;
+	// when set the buffer is placed in one of its blocks instead of getting memory of its own
+	vkUtilities::DeviceAllocator* allocator = nullptr;
+	vkUtilities::MemoryCategory category = vkUtilities::MemoryCategory::OTHER;
 };
 
 struct Buffer {
 	vk::Buffer buffer;
-	vk::DeviceMemory bufferMemory;
+	vkUtilities::Allocation bufferMemory;
+	// what it was made with, so it can be made again somewhere else
+	vk::DeviceSize size = 0;
+	vk::BufferUsageFlags usage;
 };
 
 enum class RenderPassType {
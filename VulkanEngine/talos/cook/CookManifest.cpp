@@ -0,0 +1,128 @@
+#include "CookManifest.h"
+#include "../utilities/MappedFile.h"
+#include <filesystem>
+#include <sstream>
+
+namespace vkCook {
+	namespace {
+		std::string makeLookup(const std::string& kind, const std::string& key) {
+			return kind + " " + key;
+		}
+	}
+
+	SourceStamp stampSource(const std::string& path) {
+		SourceStamp stamp;
+		stamp.path = path;
+
+		std::error_code error;
+		uint64_t size = std::filesystem::file_size(path, error);
+		if (error) {
+			return stamp;
+		}
+
+		std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(path, error);
+		if (error) {
+			return stamp;
+		}
+
+		stamp.size = size;
+		stamp.writeTime = static_cast<int64_t>(writeTime.time_since_epoch().count());
+		return stamp;
+	}
+
+	std::string makeTextureKey(const std::vector<std::string>& filenames) {
+		std::string key;
+		for (size_t i = 0; i < filenames.size(); i++) {
+			key += (i > 0 ? "," : "") + filenames[i];
+		}
+
+		return key;
+	}
+
+	bool CookManifest::load(const std::string& filepath) {
+		assets.clear();
+
+		// shipped builds keep the manifest in the asset archive
+		vkUtilities::MappedFile mappedFile;
+		if (!mappedFile.open(filepath)) {
+			return false;
+		}
+		std::stringstream file(std::string(mappedFile.getData(), mappedFile.getSize()));
+
+		std::string line;
+		getline(file, line);
+		std::stringstream header(line);
+		std::string tool;
+		uint32_t version = 0;
+		header >> tool >> version;
+		if (tool != "talos-cook" || version != COOK_MANIFEST_VERSION) {
+			std::cout << "Ignoring \"" << filepath << "\", it was written by a different version of talos-cook" << std::endl;
+			return false;
+		}
+
+		while (getline(file, line)) {
+			std::stringstream ss(line);
+			CookedAsset asset;
+			size_t sourceCount = 0;
+			ss >> asset.kind >> asset.key >> asset.cookedPath >> std::hex >> asset.sourceHash >> std::dec >> sourceCount;
+			if (ss.fail()) {
+				continue;
+			}
+
+			for (size_t i = 0; i < sourceCount; i++) {
+				SourceStamp stamp;
+				ss >> stamp.path >> stamp.size >> stamp.writeTime;
+				asset.sources.push_back(stamp);
+			}
+
+			if (!ss.fail()) {
+				add(asset);
+			}
+		}
+
+		return true;
+	}
+
+	bool CookManifest::write(const std::string& filepath) const {
+		std::error_code error;
+		std::filesystem::create_directories(std::filesystem::path(filepath).parent_path(), error);
+
+		std::ofstream file(filepath, std::ios::trunc);
+		if (!file.is_open()) {
+			return false;
+		}
+
+		file << "talos-cook " << COOK_MANIFEST_VERSION << "\n";
+		for (const auto& [lookup, asset] : assets) {
+			file << asset.kind << " " << asset.key << " " << asset.cookedPath << " "
+				<< std::hex << asset.sourceHash << std::dec << " " << asset.sources.size();
+			for (const SourceStamp& stamp : asset.sources) {
+				file << " " << stamp.path << " " << stamp.size << " " << stamp.writeTime;
+			}
+			file << "\n";
+		}
+
+		return !file.fail();
+	}
+
+	void CookManifest::add(const CookedAsset& asset) {
+		assets[makeLookup(asset.kind, asset.key)] = asset;
+	}
+
+	const CookedAsset* CookManifest::find(const std::string& kind, const std::string& key) const {
+		auto entry = assets.find(makeLookup(kind, key));
+		if (entry == assets.end()) {
+			return nullptr;
+		}
+
+		for (const SourceStamp& recorded : entry->second.sources) {
+			SourceStamp current = stampSource(recorded.path);
+			bool missing = current.size == 0 && current.writeTime == 0;
+			if (!missing && (current.size != recorded.size || current.writeTime != recorded.writeTime)) {
+				return nullptr;
+			}
+		}
+
+		return &entry->second;
+	}
+}
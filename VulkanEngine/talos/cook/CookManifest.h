@@ -0,0 +1,54 @@
+#pragma once
+#include "../config.h"
+
+/*
+	Index of everything talos-cook produced. Each line names one cooked
+	asset: its kind, the key the runtime asks for it by, the blob it was
+	cooked into with that blob's source hash, and the size and write time of
+	every file it was made from. The runtime trusts an entry as long as each
+	of those files is either unchanged or gone, so shipping only the cooked
+	folder works and editing a source falls back to loading it directly.
+*/
+namespace vkCook {
+	static const char* COOKED_DIRECTORY = "cooked/";
+	static const char* COOKED_MANIFEST_PATH = "cooked/manifest.txt";
+	static const uint32_t COOK_MANIFEST_VERSION = 1;
+
+	struct SourceStamp {
+		std::string path;
+		uint64_t size = 0;
+		int64_t writeTime = 0;
+	};
+
+	// what a file looks like on disk right now, all zero if it doesn't exist
+	SourceStamp stampSource(const std::string& path);
+
+	struct CookedAsset {
+		// "mesh" or "texture"
+		std::string kind;
+		std::string key;
+		std::string cookedPath;
+		uint64_t sourceHash = 0;
+		std::vector<SourceStamp> sources;
+	};
+
+	// textures are asked for by their list of layer files
+	std::string makeTextureKey(const std::vector<std::string>& filenames);
+
+	class CookManifest {
+	public:
+		// a missing manifest just means nothing was cooked
+		bool load(const std::string& filepath = COOKED_MANIFEST_PATH);
+		bool write(const std::string& filepath = COOKED_MANIFEST_PATH) const;
+
+		void add(const CookedAsset& asset);
+
+		// null if nothing was cooked for the key or a source changed since
+		const CookedAsset* find(const std::string& kind, const std::string& key) const;
+
+		size_t size() const { return assets.size(); }
+
+	private:
+		std::unordered_map<std::string, CookedAsset> assets;
+	};
+}
@@ -0,0 +1,289 @@
+#include "Cooker.h"
+#include "../job/WorkerThread.h"
+#include "../gameobjects/Scene.h"
+#include "../utilities/ModelLoader.h"
+#include "../utilities/CacheFile.h"
+#include "../image/TextureCache.h"
+#include "../utilities/AssetArchive.h"
+#include <filesystem>
+#include <algorithm>
+#include <memory>
+
+namespace vkCook {
+	CookMeshJob::CookMeshJob(std::string objFilepath, std::string mtlFilepath, bool optimizeOverdraw, std::string meshDirectory, bool compress, bool debug) {
+		this->objFilepath = objFilepath;
+		this->mtlFilepath = mtlFilepath;
+		this->optimizeOverdraw = optimizeOverdraw;
+		this->meshDirectory = meshDirectory;
+		this->compress = compress;
+		this->debug = debug;
+	}
+
+	// the same load the engine would do, pointed at the cooked folder instead of the runtime cache
+	void CookMeshJob::execute(vk::CommandBuffer commandBuffer, vk::Queue queue) {
+		vkMesh::ObjMesh mesh;
+		mesh.cacheDirectory = meshDirectory;
+		mesh.optimizeOverdraw = optimizeOverdraw;
+		mesh.compressCache = compress;
+		mesh.debug = debug;
+		mesh.load(objFilepath, mtlFilepath, vkMesh::makeModelPreTransform());
+
+		std::error_code error;
+		succeeded = std::filesystem::exists(mesh.cachePath, error);
+		sourceHash = mesh.sourceHash;
+		cookedPath = mesh.cachePath;
+		status = vkJob::JobStatus::FINISHED;
+	}
+
+	EncodeImageJob::EncodeImageJob(vkImage::TextureEncoding encoding, const unsigned char* pixels, uint32_t width, uint32_t height, unsigned char* output) {
+		this->encoding = encoding;
+		this->pixels = pixels;
+		this->width = width;
+		this->height = height;
+		this->output = output;
+	}
+
+	void EncodeImageJob::execute(vk::CommandBuffer commandBuffer, vk::Queue queue) {
+		vkImage::encodeImage(encoding, pixels, width, height, output);
+		status = vkJob::JobStatus::FINISHED;
+	}
+
+	CookTextureJob::CookTextureJob(std::vector<std::string> filenames, std::string textureDirectory, bool compress, vkImage::TextureEncoding encoding, vkJob::JobQueue* workQueue) {
+		this->filenames = filenames;
+		this->textureDirectory = textureDirectory;
+		this->compress = compress;
+		this->encoding = encoding;
+		this->workQueue = workQueue;
+	}
+
+	void CookTextureJob::execute(vk::CommandBuffer commandBuffer, vk::Queue queue) {
+		// the same sources cooked to another format are a different blob
+		sourceHash = vkImage::hashTextureSources(filenames);
+		sourceHash = vkUtilities::hashBytes(sourceHash, &encoding, sizeof(encoding));
+		cookedPath = vkUtilities::makeCachePath(textureDirectory, sourceHash, ".tex");
+
+		vkImage::TextureCache existing;
+		if (existing.load(cookedPath, sourceHash)) {
+			succeeded = true;
+			status = vkJob::JobStatus::FINISHED;
+			return;
+		}
+
+		// decoded exactly the way Texture::load would, every layer must match the first one's size
+		std::vector<vkJob::DecodedImage> images;
+		vkJob::decodeImages(filenames, images, workQueue);
+
+		int width = images.empty() ? 0 : images[0].width;
+		int height = images.empty() ? 0 : images[0].height;
+		std::vector<stbi_uc*> layers;
+		bool decoded = !filenames.empty();
+		for (size_t i = 0; i < images.size(); i++) {
+			if (images[i].pixels) {
+				layers.push_back(images[i].pixels);
+			}
+
+			if (!decoded) {
+				continue;
+			}
+
+			if (!images[i].pixels) {
+				std::cout << "Failed to load filename: " << filenames[i] << std::endl;
+				decoded = false;
+			}
+			else if (images[i].width != width || images[i].height != height) {
+				std::cout << "\"" << filenames[i] << "\" is a different size from the texture's other layers" << std::endl;
+				decoded = false;
+			}
+		}
+
+		if (decoded) {
+			succeeded = encode(layers, static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+		}
+
+		for (stbi_uc* pixels : layers) {
+			stbi_image_free(pixels);
+		}
+		status = vkJob::JobStatus::FINISHED;
+	}
+
+	bool CookTextureJob::encode(const std::vector<stbi_uc*>& layers, uint32_t width, uint32_t height) {
+		vkImage::TextureEncoding layerEncoding = encoding;
+		for (const stbi_uc* pixels : layers) {
+			if (layerEncoding == vkImage::TextureEncoding::BC1 && vkImage::hasTranslucency(pixels, width, height)) {
+				layerEncoding = vkImage::TextureEncoding::BC7;
+			}
+		}
+		vk::Format format = vkImage::getEncodingFormat(layerEncoding);
+
+		// every level of every layer, each level filtered from the one above it
+		uint32_t levelCount = vkImage::getMipLevelCount(width, height);
+		std::vector<std::vector<std::vector<unsigned char>>> mips(layers.size(), std::vector<std::vector<unsigned char>>(levelCount));
+		for (size_t layer = 0; layer < layers.size(); layer++) {
+			for (uint32_t level = 1; level < levelCount; level++) {
+				const unsigned char* above = level == 1 ? layers[layer] : mips[layer][level - 1].data();
+				vkImage::downsampleImage(above, std::max(1u, width >> (level - 1)), std::max(1u, height >> (level - 1)), mips[layer][level]);
+			}
+		}
+
+		std::vector<std::vector<unsigned char>> levels(levelCount);
+		std::vector<std::unique_ptr<EncodeImageJob>> jobs;
+		std::vector<vkJob::Job*> queued;
+		for (uint32_t level = 0; level < levelCount; level++) {
+			uint32_t levelWidth = std::max(1u, width >> level);
+			uint32_t levelHeight = std::max(1u, height >> level);
+			size_t layerSize = vkImage::getEncodedSize(format, levelWidth, levelHeight);
+			levels[level].resize(layerSize * layers.size());
+
+			for (size_t layer = 0; layer < layers.size(); layer++) {
+				const unsigned char* pixels = level == 0 ? layers[layer] : mips[layer][level].data();
+				jobs.push_back(std::make_unique<EncodeImageJob>(layerEncoding, pixels, levelWidth, levelHeight, levels[level].data() + layer * layerSize));
+				queued.push_back(jobs.back().get());
+			}
+		}
+
+		if (workQueue) {
+			workQueue->runAndWait(queued);
+		}
+		else {
+			for (vkJob::Job* job : queued) {
+				job->execute(nullptr, nullptr);
+			}
+		}
+
+		return vkImage::TextureCache::write(cookedPath, sourceHash, width, height, static_cast<uint32_t>(layers.size()), format, levels, compress);
+	}
+
+	int cookScene(const CookerInput& input) {
+		Scene scene(input.scenePath);
+		std::string manifestPath = input.outputDirectory + "manifest.txt";
+
+		// cooking another scene into the same folder adds to what's there
+		CookManifest manifest;
+		manifest.load(manifestPath);
+
+		// one job per distinct source, however many descriptors name it
+		std::unordered_map<std::string, std::unique_ptr<CookMeshJob>> meshJobs;
+		std::unordered_map<std::string, std::unique_ptr<CookTextureJob>> textureJobs;
+		std::vector<std::pair<std::string, CookMeshJob*>> meshDescriptors;
+		std::vector<std::string> packPaths = { input.scenePath };
+		vkJob::JobQueue workQueue;
+
+		auto queueTexture = [&](const std::vector<std::string>& filenames) {
+			std::string key = makeTextureKey(filenames);
+			if (!textureJobs.count(key)) {
+				textureJobs[key] = std::make_unique<CookTextureJob>(filenames, input.outputDirectory + "textures/", input.compress, input.textureEncoding, &workQueue);
+				workQueue.add(textureJobs[key].get());
+			}
+		};
+
+		for (const std::string& descriptorPath : scene.gameObjectAssetPaths) {
+			std::unordered_map<std::string, std::vector<std::string>> assetPaths = talos::util::getAssetDependencies(descriptorPath.c_str(), input.debug);
+			packPaths.push_back(descriptorPath);
+			if (!assetPaths.count("model") || !assetPaths.count("material")) {
+				std::cout << "\"" << descriptorPath << "\" names no model, skipping it" << std::endl;
+				continue;
+			}
+
+			std::string objFilepath = assetPaths.at("model")[0];
+			std::string mtlFilepath = assetPaths.at("material")[0];
+			bool optimizeOverdraw = assetPaths.count("optimize") && assetPaths.at("optimize")[0] == "overdraw";
+			std::string meshKey = objFilepath + "|" + mtlFilepath + (optimizeOverdraw ? "|overdraw" : "");
+			if (!meshJobs.count(meshKey)) {
+				meshJobs[meshKey] = std::make_unique<CookMeshJob>(objFilepath, mtlFilepath, optimizeOverdraw, input.outputDirectory + "meshes/", input.compress, input.debug);
+				workQueue.add(meshJobs[meshKey].get());
+			}
+			meshDescriptors.push_back({ descriptorPath, meshJobs[meshKey].get() });
+
+			if (assetPaths.count("texture")) {
+				queueTexture(assetPaths.at("texture"));
+			}
+		}
+
+		for (const std::string& skyboxPath : scene.skyboxes) {
+			std::unordered_map<std::string, std::vector<std::string>> skyboxPaths = talos::util::getAssetDependencies(skyboxPath.c_str(), input.debug);
+			packPaths.push_back(skyboxPath);
+			if (skyboxPaths.count("texture")) {
+				queueTexture(skyboxPaths.at("texture"));
+			}
+		}
+
+		size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+		std::vector<std::thread> workers;
+		for (size_t i = 0; i < threadCount; i++) {
+			workers.push_back(std::thread(vkJob::WorkerThread(workQueue, nullptr, nullptr)));
+		}
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+
+		int failures = 0;
+		for (const auto& [descriptorPath, job] : meshDescriptors) {
+			if (!job->succeeded) {
+				std::cout << "Failed to cook \"" << descriptorPath << "\"" << std::endl;
+				packPaths.insert(packPaths.end(), { job->objFilepath, job->mtlFilepath });
+				failures++;
+				continue;
+			}
+
+			// the descriptor is a source too, its options change what gets cooked
+			CookedAsset asset;
+			asset.kind = "mesh";
+			asset.key = descriptorPath;
+			asset.cookedPath = job->cookedPath;
+			asset.sourceHash = job->sourceHash;
+			asset.sources = { stampSource(descriptorPath), stampSource(job->objFilepath), stampSource(job->mtlFilepath) };
+			manifest.add(asset);
+			packPaths.push_back(job->cookedPath);
+		}
+
+		for (const auto& [key, job] : textureJobs) {
+			if (!job->succeeded) {
+				std::cout << "Failed to cook texture \"" << key << "\"" << std::endl;
+				packPaths.insert(packPaths.end(), job->filenames.begin(), job->filenames.end());
+				failures++;
+				continue;
+			}
+
+			CookedAsset asset;
+			asset.kind = "texture";
+			asset.key = key;
+			asset.cookedPath = job->cookedPath;
+			asset.sourceHash = job->sourceHash;
+			for (const std::string& filename : job->filenames) {
+				asset.sources.push_back(stampSource(filename));
+			}
+			manifest.add(asset);
+			packPaths.push_back(job->cookedPath);
+		}
+
+		if (!manifest.write(manifestPath)) {
+			std::cout << "Failed to write \"" << manifestPath << "\"" << std::endl;
+			return failures + 1;
+		}
+
+		// sources that cooked fine stay out, the manifest trusts cooked blobs whose sources are gone
+		if (!input.archivePath.empty()) {
+			packPaths.push_back(manifestPath);
+			for (const std::string& directory : input.packDirectories) {
+				std::error_code error;
+				for (const auto& item : std::filesystem::recursive_directory_iterator(directory, error)) {
+					if (item.is_regular_file()) {
+						packPaths.push_back(item.path().generic_string());
+					}
+				}
+			}
+
+			std::sort(packPaths.begin(), packPaths.end());
+			packPaths.erase(std::unique(packPaths.begin(), packPaths.end()), packPaths.end());
+			if (!vkUtilities::AssetArchive::write(input.archivePath, packPaths)) {
+				std::cout << "Failed to write \"" << input.archivePath << "\"" << std::endl;
+				return failures + 1;
+			}
+			std::cout << "Packed " << packPaths.size() << " files into \"" << input.archivePath << "\"" << std::endl;
+		}
+
+		std::cout << "Cooked " << meshJobs.size() << " meshes and " << textureJobs.size() << " textures from \""
+			<< input.scenePath << "\" into \"" << input.outputDirectory << "\"" << std::endl;
+		return failures;
+	}
+}
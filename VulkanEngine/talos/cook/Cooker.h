@@ -0,0 +1,86 @@
+#pragma once
+#include "../config.h"
+#include "../job/Job.h"
+#include "CookManifest.h"
+#include "../image/TextureCompression.h"
+
+/*
+	Offline half of the asset pipeline, driven by the talos-cook executable.
+	Walks a scene file's asset descriptors, cooks every mesh and texture they
+	name into GPU ready blobs on worker threads and records them in the
+	manifest the engine reads at startup. Blobs are named by content hash,
+	so descriptors sharing a model or texture share one blob and recooking
+	unchanged sources is just a hash.
+*/
+namespace vkCook {
+	struct CookerInput {
+		std::string scenePath;
+		// needs a trailing slash; the engine only looks in COOKED_DIRECTORY
+		std::string outputDirectory = COOKED_DIRECTORY;
+		// when set, everything the scene needs at runtime is also packed into this archive
+		std::string archivePath;
+		// extra folders to pack whole, like compiled shaders
+		std::vector<std::string> packDirectories;
+		// block compress cooked blobs, they decompress on the engine's workers at load
+		bool compress = true;
+		// GPU format cooked textures are stored in, BC1 textures with any translucency get BC7 instead
+		vkImage::TextureEncoding textureEncoding = vkImage::TextureEncoding::BC7;
+		bool debug = true;
+	};
+
+	class CookMeshJob : public vkJob::Job {
+	public:
+		std::string objFilepath;
+		std::string mtlFilepath;
+		bool optimizeOverdraw;
+		std::string meshDirectory;
+		bool compress;
+		bool debug;
+
+		// filled in by execute
+		bool succeeded = false;
+		uint64_t sourceHash = 0;
+		std::string cookedPath;
+
+		CookMeshJob(std::string objFilepath, std::string mtlFilepath, bool optimizeOverdraw, std::string meshDirectory, bool compress, bool debug);
+		virtual void execute(vk::CommandBuffer commandBuffer, vk::Queue queue) final;
+	};
+
+	// encodes one layer of one mip level
+	class EncodeImageJob : public vkJob::Job {
+	public:
+		vkImage::TextureEncoding encoding;
+		const unsigned char* pixels;
+		uint32_t width;
+		uint32_t height;
+		unsigned char* output;
+
+		EncodeImageJob(vkImage::TextureEncoding encoding, const unsigned char* pixels, uint32_t width, uint32_t height, unsigned char* output);
+		virtual void execute(vk::CommandBuffer commandBuffer, vk::Queue queue) final;
+	};
+
+	class CookTextureJob : public vkJob::Job {
+	public:
+		std::vector<std::string> filenames;
+		std::string textureDirectory;
+		bool compress;
+		vkImage::TextureEncoding encoding;
+		// the cook's own queue, a texture's levels and layers are encoded as jobs on it
+		vkJob::JobQueue* workQueue;
+
+		// filled in by execute
+		bool succeeded = false;
+		uint64_t sourceHash = 0;
+		std::string cookedPath;
+
+		CookTextureJob(std::vector<std::string> filenames, std::string textureDirectory, bool compress, vkImage::TextureEncoding encoding, vkJob::JobQueue* workQueue);
+		virtual void execute(vk::CommandBuffer commandBuffer, vk::Queue queue) final;
+
+	private:
+		// builds the mip chain, encodes it and writes the blob
+		bool encode(const std::vector<stbi_uc*>& layers, uint32_t width, uint32_t height);
+	};
+
+	// returns how many assets failed to cook
+	int cookScene(const CookerInput& input);
+}
@@ -1,4 +1,6 @@
 #include "Scene.h"
+#include "../utilities/MappedFile.h"
+#include <sstream>
 
 Scene::Scene() {
 	// Default game object
@@ -40,14 +42,14 @@ Scene::~Scene() {
 }
 
 Scene::Scene(std::string filepath) {
-	std::ifstream file;
-	file.open(filepath);
-	std::unordered_map<std::string, std::vector<std::string>> assetFilepaths;
-
-	if (!file.is_open()) {
+	// scenes may live in the asset archive
+	vkUtilities::MappedFile mappedFile;
+	if (!mappedFile.open(filepath)) {
 		std::cout << "Failed to load \"" << filepath << "\"" << std::endl;
 		return;
 	}
+	std::stringstream file(std::string(mappedFile.getData(), mappedFile.getSize()));
+	std::unordered_map<std::string, std::vector<std::string>> assetFilepaths;
 
 	while (!file.eof()) {
 		std::string line;
@@ -123,5 +125,4 @@ Scene::Scene(std::string filepath) {
 			std::cout << "unrecognized object type!" << std::endl;
 		}
 	}
-	file.close();
 }
\ No newline at end of file
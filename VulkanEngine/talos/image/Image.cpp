@@ -4,14 +4,36 @@
 #include "../utilities/Memory.h"
 #include "../pipeline/Descriptors.h"
 #include "../utilities/SingleTimeCommands.h"
+#include "../utilities/MappedFile.h"
+#include <climits>
+#include <algorithm>
 
 namespace vkImage {
+	stbi_uc* loadImageFile(const std::string& filename, int* width, int* height, int* channels, int desiredChannels) {
+		vkUtilities::MappedFile file;
+		if (!file.open(filename) || file.getSize() > static_cast<size_t>(INT_MAX)) {
+			return nullptr;
+		}
+
+		return stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(file.getData()), static_cast<int>(file.getSize()), width, height, channels, desiredChannels);
+	}
+
+	bool readImageSize(const std::string& filename, int* width, int* height) {
+		vkUtilities::MappedFile file;
+		if (!file.open(filename) || file.getSize() > static_cast<size_t>(INT_MAX)) {
+			return false;
+		}
+
+		int channels;
+		return stbi_info_from_memory(reinterpret_cast<const stbi_uc*>(file.getData()), static_cast<int>(file.getSize()), width, height, &channels) != 0;
+	}
+
 	vk::Image makeImage(ImageInput input, vk::ImageLayout layout) {
 		vk::ImageCreateInfo createInfo;
 		createInfo.flags = vk::ImageCreateFlagBits() | input.createFlags;
 		createInfo.imageType = vk::ImageType::e2D;
 		createInfo.extent = vk::Extent3D(input.width, input.height, 1);
-		createInfo.mipLevels = 1;
+		createInfo.mipLevels = input.mipLevels;
 		createInfo.arrayLayers = input.arrayCount;
 		createInfo.format = input.format;
 		createInfo.tiling = input.tiling;
@@ -29,33 +51,42 @@ namespace vkImage {
 		}
 	}
 
-	vk::DeviceMemory makeImageMemory(ImageInput input, vk::Image image) {
+	vkUtilities::Allocation makeImageMemory(ImageInput input, vk::Image image) {
+		vkUtilities::AllocationInput allocationInput;
+		allocationInput.device = input.device;
+		allocationInput.physicalDevice = input.physicalDevice;
+		allocationInput.allocator = input.allocator;
+		allocationInput.requirements = input.device.getImageMemoryRequirements(image);
+		allocationInput.properties = input.memoryFlags;
+		allocationInput.tiling = input.tiling == vk::ImageTiling::eOptimal ? vkUtilities::ResourceTiling::OPTIMAL : vkUtilities::ResourceTiling::LINEAR;
+		allocationInput.category = input.category;
 
-		vk::MemoryRequirements reqs = input.device.getImageMemoryRequirements(image);
-		vk::MemoryAllocateInfo allocInfo;
-		allocInfo.allocationSize = reqs.size;
-		allocInfo.memoryTypeIndex = vkUtilities::findMemoryTypeIndex(
-			input.physicalDevice, reqs.memoryTypeBits, input.memoryFlags
-		);
+		vkUtilities::Allocation imageMemory = vkUtilities::allocateMemory(allocationInput);
+		if (!imageMemory.memory) {
+			std::cout << "Unable to allocate image memory" << std::endl;
+			return imageMemory;
+		}
 
 		try {
-			vk::DeviceMemory imageMemory = input.device.allocateMemory(allocInfo);
-			input.device.bindImageMemory(image, imageMemory, 0);
-			return imageMemory;
+			input.device.bindImageMemory(image, imageMemory.memory, imageMemory.offset);
 		}
 		catch (vk::SystemError err) {
-			std::cout << "Unable to allocate image memory" << std::endl;
-			return nullptr;
+			std::cout << "Unable to bind image memory" << std::endl;
 		}
+		return imageMemory;
 	}
 
 	void transitionImageLayout(ImageLayoutTransitionInput input) {
 		vkUtilities::startJob(input.commandBuffer);
+		recordLayoutTransition(input);
+		vkUtilities::endJob(input.commandBuffer, input.queue);
+	}
 
+	void recordLayoutTransition(const ImageLayoutTransitionInput& input) {
 		vk::ImageSubresourceRange access;
 		access.aspectMask = input.aspect;
 		access.baseMipLevel = 0;
-		access.levelCount = 1;
+		access.levelCount = input.mipLevels;
 		access.baseArrayLayer = 0;
 		access.layerCount = input.arrayCount;
 
@@ -83,6 +114,21 @@ namespace vkImage {
 			sourceStage = vk::PipelineStageFlagBits::eTopOfPipe;
 			dstStage = vk::PipelineStageFlagBits::eFragmentShader;
 		}
+		// render targets sampled by a later pass in the same command buffer
+		else if (input.oldLayout == vk::ImageLayout::eColorAttachmentOptimal) {
+			barrier.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+			barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+			sourceStage = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+			dstStage = vk::PipelineStageFlagBits::eFragmentShader;
+		}
+		else if (input.oldLayout == vk::ImageLayout::eDepthStencilAttachmentOptimal) {
+			barrier.srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+			barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+			sourceStage = vk::PipelineStageFlagBits::eLateFragmentTests;
+			dstStage = vk::PipelineStageFlagBits::eFragmentShader;
+		}
 		else {
 			barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
 			barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
@@ -91,38 +137,168 @@ namespace vkImage {
 			dstStage = vk::PipelineStageFlagBits::eFragmentShader;
 		}
 		input.commandBuffer.pipelineBarrier(sourceStage, dstStage, vk::DependencyFlags(), nullptr, nullptr, barrier);
+	}
 
+	void copyBufferToImage(BufferCopyInput input) {
+		vkUtilities::startJob(input.commandBuffer);
+		recordBufferToImageCopy(input);
 		vkUtilities::endJob(input.commandBuffer, input.queue);
 	}
 
-	void copyBufferToImage(BufferCopyInput input) {
+	void recordBufferToImageCopy(const BufferCopyInput& input) {
+		// one region per level, each level's layers are packed back to back
+		std::vector<vk::DeviceSize> levelOffsets = input.levelOffsets;
+		if (levelOffsets.empty()) {
+			levelOffsets.push_back(0);
+		}
+
+		std::vector<vk::BufferImageCopy> copies;
+		for (uint32_t level = 0; level < levelOffsets.size(); level++) {
+			vk::BufferImageCopy copy;
+			copy.bufferOffset = levelOffsets[level];
+			copy.bufferRowLength = 0;
+			copy.bufferImageHeight = 0;
+
+			vk::ImageSubresourceLayers access;
+			access.aspectMask = vk::ImageAspectFlagBits::eColor;
+			access.mipLevel = level;
+			access.baseArrayLayer = 0;
+			access.layerCount = input.arrayCount;
+			copy.imageSubresource = access;
+
+			copy.imageOffset = vk::Offset3D(0, 0, 0);
+			copy.imageExtent = vk::Extent3D(
+				std::max(1, input.width >> level),
+				std::max(1, input.height >> level),
+				1
+			);
+			copies.push_back(copy);
+		}
+
+		input.commandBuffer.copyBufferToImage(input.srcBuffer, input.image, vk::ImageLayout::eTransferDstOptimal, copies);
+	}
+
+	void generateMipmaps(MipmapInput input) {
 		vkUtilities::startJob(input.commandBuffer);
+		recordMipmaps(input);
+		vkUtilities::endJob(input.commandBuffer, input.queue);
+	}
 
-		vk::BufferImageCopy copy;
-		copy.bufferOffset = 0;
-		copy.bufferRowLength = 0;
-		copy.bufferImageHeight = 0;
+	void recordMipmaps(const MipmapInput& input) {
+		vk::ImageMemoryBarrier barrier;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = input.image;
+		barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = input.arrayCount;
 
-		vk::ImageSubresourceLayers access;
-		access.aspectMask = vk::ImageAspectFlagBits::eColor;
-		access.mipLevel = 0;
-		access.baseArrayLayer = 0;
-		access.layerCount = input.arrayCount;
-		copy.imageSubresource = access;
+		int levelWidth = input.width;
+		int levelHeight = input.height;
+		for (uint32_t level = 1; level < input.mipLevels; level++) {
+			// the level above is read from now on
+			barrier.subresourceRange.baseMipLevel = level - 1;
+			barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+			barrier.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+			barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+			barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+			input.commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), nullptr, nullptr, barrier);
 
-		copy.imageOffset = vk::Offset3D(0, 0, 0);
-		copy.imageExtent = vk::Extent3D(
-			input.width,
-			input.height,
-			1
-		);
+			int nextWidth = std::max(1, levelWidth / 2);
+			int nextHeight = std::max(1, levelHeight / 2);
 
-		input.commandBuffer.copyBufferToImage(input.srcBuffer, input.image, vk::ImageLayout::eTransferDstOptimal, copy);
+			vk::ImageBlit blit;
+			blit.srcOffsets[0] = vk::Offset3D(0, 0, 0);
+			blit.srcOffsets[1] = vk::Offset3D(levelWidth, levelHeight, 1);
+			blit.srcSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+			blit.srcSubresource.mipLevel = level - 1;
+			blit.srcSubresource.baseArrayLayer = 0;
+			blit.srcSubresource.layerCount = input.arrayCount;
+			blit.dstOffsets[0] = vk::Offset3D(0, 0, 0);
+			blit.dstOffsets[1] = vk::Offset3D(nextWidth, nextHeight, 1);
+			blit.dstSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+			blit.dstSubresource.mipLevel = level;
+			blit.dstSubresource.baseArrayLayer = 0;
+			blit.dstSubresource.layerCount = input.arrayCount;
+			input.commandBuffer.blitImage(input.image, vk::ImageLayout::eTransferSrcOptimal, input.image, vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eLinear);
 
+			// and done with once its level below is written
+			barrier.oldLayout = vk::ImageLayout::eTransferSrcOptimal;
+			barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+			barrier.srcAccessMask = vk::AccessFlagBits::eTransferRead;
+			barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+			input.commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlags(), nullptr, nullptr, barrier);
+
+			levelWidth = nextWidth;
+			levelHeight = nextHeight;
+		}
+
+		// the last level is never read from by a blit
+		barrier.subresourceRange.baseMipLevel = input.mipLevels - 1;
+		barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+		barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+		barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+		input.commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlags(), nullptr, nullptr, barrier);
+	}
+
+	void copyImageLevels(ImageLevelCopyInput input) {
+		vkUtilities::startJob(input.commandBuffer);
+		recordImageLevelCopy(input);
 		vkUtilities::endJob(input.commandBuffer, input.queue);
 	}
 
-	vk::ImageView makeImageView(vk::Device device, vk::Image image, vk::Format format, vk::ImageAspectFlags aspect, vk::ImageViewType viewType, uint32_t arrayCount) {
+	void recordImageLevelCopy(const ImageLevelCopyInput& input) {
+		vk::ImageMemoryBarrier source;
+		source.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		source.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		source.image = input.srcImage;
+		source.subresourceRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, input.srcBaseLevel, input.levelCount, 0, input.arrayCount);
+		source.oldLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+		source.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+		source.srcAccessMask = vk::AccessFlagBits::eShaderRead;
+		source.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+
+		vk::ImageMemoryBarrier destination;
+		destination.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		destination.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		destination.image = input.dstImage;
+		destination.subresourceRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, input.dstMipLevels, 0, input.arrayCount);
+		destination.oldLayout = vk::ImageLayout::eUndefined;
+		destination.newLayout = vk::ImageLayout::eTransferDstOptimal;
+		destination.srcAccessMask = vk::AccessFlagBits::eNoneKHR;
+		destination.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+
+		std::vector<vk::ImageMemoryBarrier> barriers = { source, destination };
+		input.commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), nullptr, nullptr, barriers);
+
+		std::vector<vk::ImageCopy> copies;
+		for (uint32_t level = 0; level < input.levelCount; level++) {
+			vk::ImageCopy copy;
+			copy.srcSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, input.srcBaseLevel + level, 0, input.arrayCount);
+			copy.dstSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, input.dstBaseLevel + level, 0, input.arrayCount);
+			copy.srcOffset = vk::Offset3D(0, 0, 0);
+			copy.dstOffset = vk::Offset3D(0, 0, 0);
+			copy.extent = vk::Extent3D(std::max(1, input.width >> level), std::max(1, input.height >> level), 1);
+			copies.push_back(copy);
+		}
+		input.commandBuffer.copyImage(input.srcImage, vk::ImageLayout::eTransferSrcOptimal, input.dstImage, vk::ImageLayout::eTransferDstOptimal, copies);
+
+		// levels that weren't copied are left undefined for the caller to fill
+		destination.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+		destination.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+		destination.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		destination.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+		input.commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlags(), nullptr, nullptr, destination);
+	}
+
+	bool canGenerateMipmaps(vk::PhysicalDevice physicalDevice, vk::Format format) {
+		vk::FormatProperties properties = physicalDevice.getFormatProperties(format);
+		return static_cast<bool>(properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear);
+	}
+
+	vk::ImageView makeImageView(vk::Device device, vk::Image image, vk::Format format, vk::ImageAspectFlags aspect, vk::ImageViewType viewType, uint32_t arrayCount, uint32_t mipLevels) {
 		vk::ImageViewCreateInfo createInfo = {};
 		createInfo.image = image;
 		createInfo.viewType = viewType;
@@ -134,7 +310,7 @@ namespace vkImage {
 		createInfo.components.a = vk::ComponentSwizzle::eIdentity;
 
 		createInfo.subresourceRange.baseMipLevel = 0;
-		createInfo.subresourceRange.levelCount = 1;
+		createInfo.subresourceRange.levelCount = mipLevels;
 		createInfo.subresourceRange.baseArrayLayer = 0;
 		createInfo.subresourceRange.layerCount = arrayCount;
 		createInfo.subresourceRange.aspectMask = aspect;
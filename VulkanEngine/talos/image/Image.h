@@ -1,6 +1,15 @@
 #pragma once
 #include "../../stb_image.h"
 #include "../config.h"
+#include "../utilities/UploadBatch.h"
+
+namespace vkCook {
+	class CookManifest;
+}
+
+namespace vkJob {
+	class JobQueue;
+}
 
 namespace vkImage {
 
@@ -16,6 +25,18 @@ namespace vkImage {
 		vk::DescriptorSet set = nullptr;
 		uint32_t descriptorCount = 1;
 		uint32_t dstBinding;
+		// when set, textures cooked by talos-cook are mapped instead of decoded
+		const vkCook::CookManifest* cookedAssets = nullptr;
+		// when set, compressed cooked textures decompress on its workers
+		vkJob::JobQueue* jobQueue = nullptr;
+		// when non zero, cooked 2D textures start with only the levels at most this many texels across
+		uint32_t streamingStartSize = 0;
+		// pixels are decoded or copied straight into a region of it, loading and streaming both need one
+		vkUtilities::StagingRing* stagingRing = nullptr;
+		// what isn't blitted is uploaded on the transfer queue and handed over to the graphics family
+		vkUtilities::UploadQueues uploadQueues;
+		// where texture images are placed, memory of their own when null
+		vkUtilities::DeviceAllocator* allocator = nullptr;
 	};
 
 	struct ImageInput {
@@ -28,6 +49,10 @@ namespace vkImage {
 		vk::Format format;
 		uint32_t arrayCount;
 		vk::ImageCreateFlags createFlags;
+		uint32_t mipLevels = 1;
+		// when set the image is placed in one of its blocks instead of getting memory of its own
+		vkUtilities::DeviceAllocator* allocator = nullptr;
+		vkUtilities::MemoryCategory category = vkUtilities::MemoryCategory::OTHER;
 	};
 
 	struct ImageLayoutTransitionInput {
@@ -37,6 +62,7 @@ namespace vkImage {
 		vk::ImageLayout oldLayout, newLayout;
 		uint32_t arrayCount;
 		vk::ImageAspectFlagBits aspect = vk::ImageAspectFlagBits::eColor;
+		uint32_t mipLevels = 1;
 	};
 
 	struct BufferCopyInput {
@@ -46,13 +72,56 @@ namespace vkImage {
 		vk::Image image;
 		int width, height;
 		uint32_t arrayCount;
+		// where each mip level's layers start in srcBuffer, empty copies just level 0 from the start
+		std::vector<vk::DeviceSize> levelOffsets;
+	};
+
+	struct MipmapInput {
+		vk::CommandBuffer commandBuffer;
+		vk::Queue queue;
+		vk::Image image;
+		int width, height;
+		uint32_t arrayCount;
+		uint32_t mipLevels;
 	};
 
+	struct ImageLevelCopyInput {
+		vk::CommandBuffer commandBuffer;
+		vk::Queue queue;
+		vk::Image srcImage;
+		vk::Image dstImage;
+		// size of the first copied level
+		int width, height;
+		uint32_t arrayCount;
+		uint32_t srcBaseLevel;
+		uint32_t dstBaseLevel;
+		uint32_t levelCount;
+		// every level of dstImage, which starts out undefined
+		uint32_t dstMipLevels;
+	};
+
+	// stbi_load that also finds files inside the mounted asset archive, free the result with stbi_image_free
+	stbi_uc* loadImageFile(const std::string& filename, int* width, int* height, int* channels, int desiredChannels);
+
+	// reads just the header, so space for the pixels can be found before decoding them
+	bool readImageSize(const std::string& filename, int* width, int* height);
+
 	vk::Image makeImage(ImageInput input, vk::ImageLayout layout = vk::ImageLayout::eUndefined);
-	vk::DeviceMemory makeImageMemory(ImageInput input, vk::Image image);
+	vkUtilities::Allocation makeImageMemory(ImageInput input, vk::Image image);
 	void transitionImageLayout(ImageLayoutTransitionInput input);
 	void copyBufferToImage(BufferCopyInput input);
-	vk::ImageView makeImageView(vk::Device device, vk::Image image, vk::Format format, vk::ImageAspectFlags aspect, vk::ImageViewType viewType, uint32_t arrayCount);
+	// blits every level from the one above it, level 0 must be filled and every level in eTransferDstOptimal, all end up in eShaderReadOnlyOptimal
+	void generateMipmaps(MipmapInput input);
+	// copies levels between two images of the same format, the source's must be in eShaderReadOnlyOptimal and every level of the destination ends up there
+	void copyImageLevels(ImageLevelCopyInput input);
+	// the record versions only add their commands to input.commandBuffer, so several can share one submission
+	void recordLayoutTransition(const ImageLayoutTransitionInput& input);
+	void recordBufferToImageCopy(const BufferCopyInput& input);
+	void recordMipmaps(const MipmapInput& input);
+	void recordImageLevelCopy(const ImageLevelCopyInput& input);
+	// linear blits are what generateMipmaps filters with, not every format supports them
+	bool canGenerateMipmaps(vk::PhysicalDevice physicalDevice, vk::Format format);
+	vk::ImageView makeImageView(vk::Device device, vk::Image image, vk::Format format, vk::ImageAspectFlags aspect, vk::ImageViewType viewType, uint32_t arrayCount, uint32_t mipLevels = 1);
 	vk::Format findSupportedFormat(
 		vk::PhysicalDevice physicalDevice,
 		const std::vector<vk::Format>& candidates,
@@ -2,6 +2,9 @@
 #include "../../stb_image.h"
 #include "../utilities/Memory.h"
 #include "../pipeline/Descriptors.h"
+#include "../cook/CookManifest.h"
+#include "TextureCompression.h"
+#include "../job/Job.h"
 
 namespace vkImage {
 
@@ -16,35 +19,65 @@ namespace vkImage {
 		descPool = input.pool;
 		descSet = input.set;
 		textureType = input.texType;
+		cookedAssets = input.cookedAssets;
+		jobQueue = input.jobQueue;
+		stagingRing = input.stagingRing;
+		uploadQueues = input.uploadQueues;
+		allocator = input.allocator;
 
-		load();
+		dstBinding = input.dstBinding;
 
+		std::shared_ptr<TextureCache> cache = std::make_shared<TextureCache>();
+		load(*cache);
+
+		// big cooked textures start with their coarse levels and keep the blob mapped to stream in the rest
+		if (loadedFromCache && input.streamingStartSize > 0 && textureType == vk::ImageViewType::e2D) {
+			while (residentLevel + 1 < mipLevels && static_cast<uint32_t>(std::max(width, height) >> residentLevel) > input.streamingStartSize) {
+				residentLevel++;
+			}
+			allocatedLevel = residentLevel;
+			if (residentLevel > 0) {
+				streamSource = cache;
+			}
+		}
+
+		makeResidentImage();
+		populate(*cache);
+
+		if (loadedFromCache && !streamSource) {
+			cache->close();
+		}
+
+		makeView();
+		makeSampler();
+		makeDescriptorSet(dstBinding);
+	}
+
+	ImageInput Texture::getResidentImageInput() const {
 		ImageInput imageInput;
 		imageInput.device = device;
 		imageInput.physicalDevice = physicalDevice;
 		imageInput.arrayCount = filenames.size();
-		imageInput.height = height;
-		imageInput.width = width;
+		imageInput.height = std::max(1, height >> allocatedLevel);
+		imageInput.width = std::max(1, width >> allocatedLevel);
 		imageInput.tiling = vk::ImageTiling::eOptimal;
-		imageInput.usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
+		// blits read the level above, streamed images copy their levels into the next one, and any image can be moved
+		imageInput.usage = vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
 		imageInput.memoryFlags = vk::MemoryPropertyFlagBits::eDeviceLocal;
-		imageInput.format = vk::Format::eR8G8B8A8Unorm;
+		imageInput.format = format;
+		imageInput.mipLevels = mipLevels - allocatedLevel;
+		imageInput.allocator = allocator;
+		imageInput.category = vkUtilities::MemoryCategory::TEXTURE;
 		if (textureType == vk::ImageViewType::eCube) {
 			imageInput.createFlags = vk::ImageCreateFlagBits::eCubeCompatible;
 		}
+		return imageInput;
+	}
 
+	void Texture::makeResidentImage() {
+		ImageInput imageInput = getResidentImageInput();
 		image = makeImage(imageInput);
 		imageMemory = makeImageMemory(imageInput, image);
-
-		populate();
-
-		for (int i = 0; i < filenames.size(); i++) {
-			free(pixels[i]);
-		}
-
-		makeView();
-		makeSampler();
-		makeDescriptorSet(input.dstBinding);
 	}
 
 	void Texture::load(TextureInput input, vk::ImageView imageView) {
@@ -67,7 +100,199 @@ namespace vkImage {
 	void Texture::destroyImage() {
 		device.destroyImage(image);
 		device.destroyImageView(imageView);
-		device.freeMemory(imageMemory);
+		vkUtilities::freeMemory(device, imageMemory);
+		streamSource.reset();
+	}
+
+	bool Texture::isStreamed() const {
+		return static_cast<bool>(streamSource);
+	}
+
+	int Texture::getWidth() const {
+		return width;
+	}
+
+	uint32_t Texture::getMipLevelCount() const {
+		return mipLevels;
+	}
+
+	uint32_t Texture::getResidentLevel() const {
+		return residentLevel;
+	}
+
+	uint32_t Texture::getAllocatedLevel() const {
+		return allocatedLevel;
+	}
+
+	vk::DeviceSize Texture::getLevelsSize(uint32_t firstLevel, uint32_t lastLevel) const {
+		vk::DeviceSize size = 0;
+		for (uint32_t level = firstLevel; level < lastLevel; level++) {
+			size += getEncodedSize(format, std::max(1, width >> level), std::max(1, height >> level)) * filenames.size();
+		}
+		return size;
+	}
+
+	std::vector<vk::DeviceSize> Texture::stageLevels(uint32_t firstLevel, uint32_t lastLevel, vkUtilities::StagingRegion& staged) const {
+		staged = stagingRing->reserve(getLevelsSize(firstLevel, lastLevel));
+		return stageLevels(*streamSource, firstLevel, lastLevel, staged.data);
+	}
+
+	void Texture::reallocate(uint32_t firstLevel, vk::CommandBuffer commandBuffer, vk::Queue queue) {
+		vk::Image oldImage = image;
+		vkUtilities::Allocation oldMemory = imageMemory;
+		vk::ImageView oldView = imageView;
+		vk::Sampler oldSampler = sampler;
+		uint32_t oldAllocated = allocatedLevel;
+
+		// levels both images have move over on the GPU, finer ones are left for fillLevels
+		uint32_t keptLevel = std::max(firstLevel, residentLevel);
+		allocatedLevel = firstLevel;
+		makeResidentImage();
+
+		vkUtilities::UploadBatch batch;
+		beginBatch(batch, commandBuffer, queue, false);
+
+		ImageLevelCopyInput copyInput;
+		copyInput.commandBuffer = batch.getCommandBuffer();
+		copyInput.srcImage = oldImage;
+		copyInput.dstImage = image;
+		copyInput.width = std::max(1, width >> keptLevel);
+		copyInput.height = std::max(1, height >> keptLevel);
+		copyInput.arrayCount = filenames.size();
+		copyInput.srcBaseLevel = keptLevel - oldAllocated;
+		copyInput.dstBaseLevel = keptLevel - allocatedLevel;
+		copyInput.levelCount = mipLevels - keptLevel;
+		copyInput.dstMipLevels = mipLevels - allocatedLevel;
+		recordImageLevelCopy(copyInput);
+		batch.wait();
+		residentLevel = keptLevel;
+
+		device.destroyImageView(oldView);
+		device.destroyImage(oldImage);
+		vkUtilities::freeMemory(device, oldMemory);
+		device.destroySampler(oldSampler);
+
+		makeView();
+		makeSampler();
+		makeDescriptorSet(dstBinding);
+	}
+
+	void Texture::fillLevels(vkUtilities::StagingRegion& staged, const std::vector<vk::DeviceSize>& levelOffsets, vkUtilities::UploadBatch& batch) {
+		// the pending levels are the image's first ones and nothing has sampled them
+		ImageLayoutTransitionInput layoutInput;
+		layoutInput.commandBuffer = batch.getCommandBuffer();
+		layoutInput.image = image;
+		layoutInput.oldLayout = vk::ImageLayout::eUndefined;
+		layoutInput.newLayout = vk::ImageLayout::eTransferDstOptimal;
+		layoutInput.arrayCount = filenames.size();
+		layoutInput.mipLevels = residentLevel - allocatedLevel;
+		recordLayoutTransition(layoutInput);
+
+		BufferCopyInput copyInput;
+		copyInput.commandBuffer = batch.getCommandBuffer();
+		copyInput.image = image;
+		copyInput.width = std::max(1, width >> allocatedLevel);
+		copyInput.height = std::max(1, height >> allocatedLevel);
+		copyInput.srcBuffer = staged.buffer;
+		copyInput.arrayCount = filenames.size();
+		for (vk::DeviceSize offset : levelOffsets) {
+			copyInput.levelOffsets.push_back(staged.offset + offset);
+		}
+		recordBufferToImageCopy(copyInput);
+
+		vk::ImageSubresourceRange levels(vk::ImageAspectFlagBits::eColor, 0, residentLevel - allocatedLevel, 0, static_cast<uint32_t>(filenames.size()));
+		batch.releaseImage(image, levels, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+		batch.stage(staged);
+	}
+
+	void Texture::landLevels() {
+		// the clamp comes off now every level is there
+		residentLevel = allocatedLevel;
+		device.destroySampler(sampler);
+		makeSampler();
+		makeDescriptorSet(dstBinding);
+	}
+
+	const vkUtilities::Allocation& Texture::getAllocation() const {
+		return imageMemory;
+	}
+
+	vk::MemoryRequirements Texture::getMemoryRequirements() const {
+		return device.getImageMemoryRequirements(image);
+	}
+
+	bool Texture::canMove() const {
+		// images handed in with their view aren't the texture's own
+		return image && imageMemory.memory && residentLevel == allocatedLevel;
+	}
+
+	void Texture::recordMove(vk::CommandBuffer commandBuffer, const vkUtilities::Allocation& destination) {
+		movedImage = makeImage(getResidentImageInput());
+		movedMemory = destination;
+		try {
+			device.bindImageMemory(movedImage, destination.memory, destination.offset);
+		}
+		catch (vk::SystemError err) {
+			std::cout << "Unable to bind image memory" << std::endl;
+		}
+
+		ImageLevelCopyInput copyInput;
+		copyInput.commandBuffer = commandBuffer;
+		copyInput.srcImage = image;
+		copyInput.dstImage = movedImage;
+		copyInput.width = std::max(1, width >> allocatedLevel);
+		copyInput.height = std::max(1, height >> allocatedLevel);
+		copyInput.arrayCount = filenames.size();
+		copyInput.srcBaseLevel = 0;
+		copyInput.dstBaseLevel = 0;
+		copyInput.levelCount = mipLevels - allocatedLevel;
+		copyInput.dstMipLevels = mipLevels - allocatedLevel;
+		recordImageLevelCopy(copyInput);
+
+		// frames recorded before finishMove still sample the original
+		vk::ImageMemoryBarrier source;
+		source.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		source.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		source.image = image;
+		source.subresourceRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, mipLevels - allocatedLevel, 0, static_cast<uint32_t>(filenames.size()));
+		source.oldLayout = vk::ImageLayout::eTransferSrcOptimal;
+		source.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+		source.srcAccessMask = vk::AccessFlagBits::eTransferRead;
+		source.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlags(), nullptr, nullptr, source);
+	}
+
+	void Texture::finishMove() {
+		originalImage = image;
+		originalMemory = imageMemory;
+		originalView = imageView;
+
+		image = movedImage;
+		imageMemory = movedMemory;
+		movedImage = nullptr;
+		movedMemory = vkUtilities::Allocation();
+
+		makeView();
+
+		// the set being swapped out was last bound by frames the original outlives
+		vk::DescriptorSet boundSet = descSet;
+		descSet = spareDescSet;
+		makeDescriptorSet(dstBinding);
+		spareDescSet = boundSet;
+	}
+
+	void Texture::releaseOriginal() {
+		device.destroyImageView(originalView);
+		device.destroyImage(originalImage);
+		vkUtilities::freeMemory(device, originalMemory);
+
+		originalView = nullptr;
+		originalImage = nullptr;
+		originalMemory = vkUtilities::Allocation();
+	}
+
+	bool Texture::isMoving() const {
+		return movedImage || originalImage;
 	}
 
 	void Texture::destroySampler() {
@@ -78,7 +303,7 @@ namespace vkImage {
 		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, set, descSet, nullptr);
 	}
 
-	void Texture::load() {
+	void Texture::load(TextureCache& cache) {
 		// log errors for inappropriate sizes
 		if (filenames.size() < 1) {
 			std::cerr << "WARNING: No file names included in texture creation" << std::endl;
@@ -89,89 +314,253 @@ namespace vkImage {
 		else if (filenames.size() != 6 && textureType == vk::ImageViewType::eCube) {
 			std::cerr << "WARNING: More or less than 6 files included for cubemap texture" << std::endl;
 		}
-		// initialize pixels
-		pixels = new stbi_uc* [filenames.size()];
-		
-		for (int i = 0; i < filenames.size(); i++) {
-			pixels[i] = stbi_load(filenames[i].c_str(), &width, &height, &channels, STBI_rgb_alpha);
-			if (!pixels[i]) {
-				std::cout << "Failed to load filename: " << filenames[i] << std::endl;
+
+		// a cooked copy skips decoding entirely
+		const vkCook::CookedAsset* cooked = cookedAssets ? cookedAssets->find("texture", vkCook::makeTextureKey(filenames)) : nullptr;
+		if (cooked && cache.load(cooked->cookedPath, cooked->sourceHash) && cache.getLayerCount() == filenames.size()) {
+			loadedFromCache = true;
+			width = static_cast<int>(cache.getWidth());
+			height = static_cast<int>(cache.getHeight());
+			channels = STBI_rgb_alpha;
+			mipLevels = cache.getLevelCount();
+
+			// block formats need textureCompressionBC, without it the blocks are decoded on the CPU
+			format = cache.getFormat();
+			vk::FormatProperties properties = physicalDevice.getFormatProperties(format);
+			decodeOnUpload = !(properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImage);
+			if (decodeOnUpload) {
+				format = vk::Format::eR8G8B8A8Unorm;
 			}
+
+			return;
+		}
+		cache.close();
+		
+		// every layer must be the first one's size, it's only decoded once there's somewhere to put it
+		// a first layer that can't be read is reported when decoding, and leaves a black texel
+		channels = STBI_rgb_alpha;
+		if (filenames.size() > 0 && !readImageSize(filenames[0], &width, &height)) {
+			width = 1;
+			height = 1;
 		}
+
+		// decoded textures get their levels made on the GPU, or on the CPU if the format can't be blitted
+		mipLevels = vkImage::getMipLevelCount(width, height);
+		blitMips = canGenerateMipmaps(physicalDevice, format);
 	}
 
-	void Texture::populate() {
-		BufferInput input;
-		input.device = device;
-		input.physicalDevice = physicalDevice;
-		input.memoryProperties = vk::MemoryPropertyFlagBits::eHostCoherent | vk::MemoryPropertyFlagBits::eHostVisible;
-		input.usage = vk::BufferUsageFlagBits::eTransferSrc;
-		size_t image_size = width * height * sizeof(float);
-		input.size = image_size * filenames.size();
-		Buffer stagingbuffer = vkUtilities::createBuffer(input);
+	void Texture::populate(const TextureCache& cache) {
+		// everything but a blitted chain is staged level by level, only the resident levels of a streamed one
+		bool blitted = !loadedFromCache && blitMips;
+		uint32_t stagedLevels = blitted ? residentLevel + 1 : mipLevels;
+		// blits need a graphics queue, plain copies go on the transfer queue
+		vkUtilities::UploadBatch batch;
+		beginBatch(batch, commandBuffer, queue, !blitted);
+		vkUtilities::StagingRegion staged = batch.reserve(getLevelsSize(residentLevel, stagedLevels));
 
-		for (int i = 0; i < filenames.size(); i++) {
-			void* writeLocation = device.mapMemory(stagingbuffer.bufferMemory, i * image_size, image_size);
-			memcpy(writeLocation, pixels[i], image_size);
-			device.unmapMemory(stagingbuffer.bufferMemory);
+		std::vector<vk::DeviceSize> levelOffsets;
+		if (loadedFromCache) {
+			levelOffsets = stageLevels(cache, residentLevel, mipLevels, staged.data);
+		}
+		else {
+			decodeLayers(staged.data);
+			levelOffsets = blitMips ? std::vector<vk::DeviceSize>{ 0 } : downsampleLevels(staged.data);
+		}
+		for (vk::DeviceSize& offset : levelOffsets) {
+			offset += staged.offset;
 		}
 
 		ImageLayoutTransitionInput layoutInput;
-		layoutInput.commandBuffer = commandBuffer;
-		layoutInput.queue = queue;
+		layoutInput.commandBuffer = batch.getCommandBuffer();
 		layoutInput.image = image;
 		layoutInput.oldLayout = vk::ImageLayout::eUndefined;
 		layoutInput.newLayout = vk::ImageLayout::eTransferDstOptimal;
 		layoutInput.arrayCount = filenames.size();
-		transitionImageLayout(layoutInput);
+		layoutInput.mipLevels = mipLevels - residentLevel;
+		recordLayoutTransition(layoutInput);
 
 		// Copy to image
 		BufferCopyInput copyInput;
-		copyInput.commandBuffer = commandBuffer;
-		copyInput.queue = queue;
+		copyInput.commandBuffer = batch.getCommandBuffer();
 		copyInput.image = image;
-		copyInput.width = width;
-		copyInput.height = height;
-		copyInput.srcBuffer = stagingbuffer.buffer;
+		copyInput.width = std::max(1, width >> residentLevel);
+		copyInput.height = std::max(1, height >> residentLevel);
+		copyInput.srcBuffer = staged.buffer;
 		copyInput.arrayCount = filenames.size();
-		copyBufferToImage(copyInput);
+		copyInput.levelOffsets = levelOffsets;
+		recordBufferToImageCopy(copyInput);
 
+		// only level 0 was copied, the blits fill the rest and leave every level ready to sample
+		if (blitted) {
+			MipmapInput mipmapInput;
+			mipmapInput.commandBuffer = batch.getCommandBuffer();
+			mipmapInput.image = image;
+			mipmapInput.width = width;
+			mipmapInput.height = height;
+			mipmapInput.arrayCount = filenames.size();
+			mipmapInput.mipLevels = mipLevels;
+			recordMipmaps(mipmapInput);
+		}
+		else {
+			vk::ImageSubresourceRange levels(vk::ImageAspectFlagBits::eColor, 0, mipLevels - residentLevel, 0, static_cast<uint32_t>(filenames.size()));
+			batch.releaseImage(image, levels, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+		}
+
+		// the whole texture goes in one submission, and the worker's command buffer is free again once it lands
+		batch.wait();
+		acquire(batch, commandBuffer, queue);
+		batch.destroy();
+	}
 
-		layoutInput.oldLayout = vk::ImageLayout::eTransferDstOptimal;
-		layoutInput.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-		transitionImageLayout(layoutInput);
+	void Texture::beginBatch(vkUtilities::UploadBatch& batch, vk::CommandBuffer commandBuffer, vk::Queue queue, bool transfer) const {
+		vkUtilities::UploadBatchInput batchInput;
+		batchInput.device = device;
+		batchInput.commandBuffer = commandBuffer;
+		batchInput.queue = queue;
+		batchInput.queueFamily = uploadQueues.graphicsFamily;
+		batchInput.ownerFamily = uploadQueues.graphicsFamily;
+		batchInput.stagingRing = stagingRing;
+
+		// the worker's command buffer belongs to the graphics family, so the batch records into one of its own
+		if (transfer && uploadQueues.isDedicated()) {
+			batchInput.commandBuffer = nullptr;
+			batchInput.queue = uploadQueues.transferQueue;
+			batchInput.queueFamily = uploadQueues.transferFamily;
+		}
+		batch.begin(batchInput);
+	}
+
+	void Texture::acquire(const vkUtilities::UploadBatch& upload, vk::CommandBuffer commandBuffer, vk::Queue queue) const {
+		if (!upload.needsAcquire()) {
+			return;
+		}
+
+		vkUtilities::UploadBatch batch;
+		beginBatch(batch, commandBuffer, queue, false);
+		upload.recordAcquire(batch.getCommandBuffer());
+		batch.wait();
+	}
+
+	void Texture::decodeLayers(unsigned char* destination) {
+		size_t layerSize = getEncodedSize(format, width, height);
+		std::vector<vkJob::DecodedImage> images(filenames.size());
+		for (size_t layer = 0; layer < filenames.size(); layer++) {
+			images[layer].destination = destination + layer * layerSize;
+			images[layer].destinationSize = layerSize;
+		}
+
+		// every layer decodes as its own job, so a cubemap's six faces go side by side
+		vkJob::decodeImages(filenames, images, jobQueue);
+		for (size_t layer = 0; layer < filenames.size(); layer++) {
+			if (images[layer].pixels) {
+				continue;
+			}
+
+			if (images[layer].width > 0) {
+				std::cout << "\"" << filenames[layer] << "\" is a different size from the texture's other layers" << std::endl;
+			}
+			else {
+				std::cout << "Failed to load filename: " << filenames[layer] << std::endl;
+			}
+			memset(images[layer].destination, 0, layerSize);
+		}
+	}
+
+	std::vector<vk::DeviceSize> Texture::downsampleLevels(unsigned char* destination) {
+		size_t layerSize = getEncodedSize(format, width, height);
+		std::vector<vk::DeviceSize> levelOffsets = { 0 };
+		vk::DeviceSize offset = layerSize * filenames.size();
+		std::vector<unsigned char> level;
+		for (uint32_t i = 1; i < mipLevels; i++) {
+			uint32_t aboveWidth = std::max(1, width >> (i - 1));
+			uint32_t aboveHeight = std::max(1, height >> (i - 1));
+			size_t aboveSize = getEncodedSize(format, aboveWidth, aboveHeight);
+			size_t levelSize = getEncodedSize(format, std::max(1u, aboveWidth / 2), std::max(1u, aboveHeight / 2));
+
+			// each layer's level is filtered from its level above, already in the staging buffer
+			for (size_t layer = 0; layer < filenames.size(); layer++) {
+				downsampleImage(destination + levelOffsets.back() + layer * aboveSize, aboveWidth, aboveHeight, level);
+				memcpy(destination + offset + layer * levelSize, level.data(), levelSize);
+			}
+
+			levelOffsets.push_back(offset);
+			offset += levelSize * filenames.size();
+		}
+
+		return levelOffsets;
+	}
+
+	std::vector<vk::DeviceSize> Texture::stageLevels(const TextureCache& cache, uint32_t firstLevel, uint32_t lastLevel, unsigned char* destination) const {
+		std::vector<vk::DeviceSize> levelOffsets;
+		vk::DeviceSize offset = 0;
+		for (uint32_t level = firstLevel; level < lastLevel; level++) {
+			levelOffsets.push_back(offset);
+			offset += getLevelsSize(level, level + 1);
+		}
+
+		// a whole payload decompresses across the job workers, streamed levels on whichever thread asked
+		bool whole = firstLevel == 0 && lastLevel == cache.getLevelCount();
+		std::vector<unsigned char> blocks;
+		unsigned char* levels = destination;
+		if (decodeOnUpload) {
+			const TextureLevel& last = cache.getLevel(lastLevel - 1);
+			blocks.resize(static_cast<size_t>(last.offset + last.size - cache.getLevel(firstLevel).offset));
+			levels = blocks.data();
+		}
+
+		bool copied = whole ? cache.copyPixels(levels, jobQueue) : cache.copyLevels(firstLevel, lastLevel, levels);
+		if (!copied) {
+			std::cout << "Cooked pixels for \"" << filenames[0] << "\" are corrupt" << std::endl;
+		}
+
+		// devices without the block format get every layer of every level decoded to RGBA8
+		if (decodeOnUpload) {
+			for (uint32_t level = firstLevel; level < lastLevel; level++) {
+				uint32_t levelWidth = std::max(1u, cache.getWidth() >> level);
+				uint32_t levelHeight = std::max(1u, cache.getHeight() >> level);
+				size_t encodedSize = getEncodedSize(cache.getFormat(), levelWidth, levelHeight);
+				size_t decodedSize = getEncodedSize(format, levelWidth, levelHeight);
+				size_t encodedOffset = static_cast<size_t>(cache.getLevel(level).offset - cache.getLevel(firstLevel).offset);
+
+				for (uint32_t layer = 0; layer < cache.getLayerCount(); layer++) {
+					decodeImage(cache.getFormat(), blocks.data() + encodedOffset + layer * encodedSize, levelWidth, levelHeight, destination + levelOffsets[level - firstLevel] + layer * decodedSize);
+				}
+			}
+		}
 
-		device.freeMemory(stagingbuffer.bufferMemory);
-		device.destroyBuffer(stagingbuffer.buffer);
+		return levelOffsets;
 	}
 
 	void Texture::makeView() {
 		imageView = makeImageView(device, 
 								  image, 
-								  vk::Format::eR8G8B8A8Unorm, 
+								  format, 
 								  vk::ImageAspectFlagBits::eColor,
 								  textureType,
-								  filenames.size());
+								  filenames.size(),
+								  mipLevels - allocatedLevel);
 	}
 
 	void Texture::makeSampler() {
 		// Populate input create info
 		vk::SamplerCreateInfo createInfo;
 		createInfo.flags = vk::SamplerCreateFlags();
-		createInfo.minFilter = vk::Filter::eNearest;
+		createInfo.minFilter = vk::Filter::eLinear;
 		createInfo.magFilter = vk::Filter::eLinear;
 		createInfo.addressModeU = vk::SamplerAddressMode::eRepeat;
 		createInfo.addressModeV = vk::SamplerAddressMode::eRepeat;
 		createInfo.addressModeW = vk::SamplerAddressMode::eRepeat;
-		createInfo.anisotropyEnable = false;
-		createInfo.maxAnisotropy = 1.0f;
+		// mips take care of minification, anisotropy keeps surfaces seen at a glancing angle sharp
+		createInfo.anisotropyEnable = mipLevels > 1 && physicalDevice.getFeatures().samplerAnisotropy;
+		createInfo.maxAnisotropy = createInfo.anisotropyEnable ? std::min(MAX_SAMPLER_ANISOTROPY, physicalDevice.getProperties().limits.maxSamplerAnisotropy) : 1.0f;
 		createInfo.borderColor = vk::BorderColor::eIntOpaqueBlack;
 		createInfo.compareEnable = false;
 		createInfo.compareOp = vk::CompareOp::eAlways;
 		createInfo.mipmapMode = vk::SamplerMipmapMode::eLinear;
 		createInfo.mipLodBias = 0.0f;
-		createInfo.minLod = 0.0f;
-		createInfo.maxLod = 0.0f;
+		// relative to the image's first level, levels still streaming in are clamped off
+		createInfo.minLod = static_cast<float>(residentLevel - allocatedLevel);
+		createInfo.maxLod = static_cast<float>(mipLevels - allocatedLevel);
 
 		try {
 			sampler = device.createSampler(createInfo);
@@ -2,10 +2,16 @@
 #include "../../stb_image.h"
 #include "../config.h"
 #include "../image/Image.h"
+#include "TextureCache.h"
+#include "../utilities/UploadBatch.h"
+#include "../utilities/Defragmenter.h"
+#include <memory>
 
 namespace vkImage {
+	// anisotropic filtering taps, where the device allows that many
+	static const float MAX_SAMPLER_ANISOTROPY = 16.0f;
 
-	class Texture {
+	class Texture : public vkUtilities::Relocatable {
 	public:
 		Texture() {};
 
@@ -19,24 +25,84 @@ namespace vkImage {
 
 		void destroySampler();
 
+		// cooked textures loaded with a streaming start size keep their finer levels out of memory until asked for
+		bool isStreamed() const;
+		int getWidth() const;
+		uint32_t getMipLevelCount() const;
+		// finest level that can be sampled
+		uint32_t getResidentLevel() const;
+		// finest level the image has room for, the ones between it and the resident level are still streaming in
+		uint32_t getAllocatedLevel() const;
+		// bytes levels [firstLevel, lastLevel) take on the GPU
+		vk::DeviceSize getLevelsSize(uint32_t firstLevel, uint32_t lastLevel) const;
+
+		// reads levels [firstLevel, lastLevel) of a streamed texture out of its blob into a staging region, safe from any thread
+		std::vector<vk::DeviceSize> stageLevels(uint32_t firstLevel, uint32_t lastLevel, vkUtilities::StagingRegion& staged) const;
+		/*
+			Moves a streamed texture to an image starting at firstLevel, nothing may
+			be using the old one. Coarser starts just drop levels, finer ones copy
+			the resident levels over and clamp sampling to them until fillLevels.
+		*/
+		void reallocate(uint32_t firstLevel, vk::CommandBuffer commandBuffer, vk::Queue queue);
+		// records the upload of what stageLevels read for the levels reallocate left empty, the region goes back with the batch
+		void fillLevels(vkUtilities::StagingRegion& staged, const std::vector<vk::DeviceSize>& levelOffsets, vkUtilities::UploadBatch& batch);
+		// takes the clamp off once the batch fillLevels recorded into has finished and been acquired, nothing may be using the texture
+		void landLevels();
+
+		// the image moves with every level it has, textures partway through streaming in stay put
+		virtual const vkUtilities::Allocation& getAllocation() const final;
+		virtual vk::MemoryRequirements getMemoryRequirements() const final;
+		virtual bool canMove() const final;
+		// the original goes back to being sampled once it's copied, frames keep drawing with it until finishMove
+		virtual void recordMove(vk::CommandBuffer commandBuffer, const vkUtilities::Allocation& destination) final;
+		// switches to a second descriptor set, the one frames in flight have bound is only rewritten by the next move
+		virtual void finishMove() final;
+		virtual void releaseOriginal() final;
+		// between recordMove and releaseOriginal, the texture can't be reallocated
+		bool isMoving() const;
+
 	private:
 		int width, height, channels;
 		vk::Device device;
 		vk::PhysicalDevice physicalDevice;
 		std::vector<std::string> filenames;
 
-		// array to data
-		stbi_uc** pixels;
+		const vkCook::CookManifest* cookedAssets = nullptr;
+		vkUtilities::StagingRing* stagingRing = nullptr;
+		vkUtilities::UploadQueues uploadQueues;
+		vkUtilities::DeviceAllocator* allocator = nullptr;
+		vkJob::JobQueue* jobQueue = nullptr;
+		bool loadedFromCache = false;
+		// cooked block formats the device can't sample are decoded to RGBA8 on the way into the staging buffer
+		bool decodeOnUpload = false;
+		vk::Format format = vk::Format::eR8G8B8A8Unorm;
+		uint32_t mipLevels = 1;
+		uint32_t residentLevel = 0;
+		uint32_t allocatedLevel = 0;
+		// set while a texture is streamed, its blob stays mapped for the levels that aren't resident
+		std::shared_ptr<TextureCache> streamSource;
+		uint32_t dstBinding = 0;
+		// decoded textures upload level 0 and blit the rest from it where the format allows
+		bool blitMips = false;
 
 		// Resources
 		vk::Image image;
-		vk::DeviceMemory imageMemory;
+		vkUtilities::Allocation imageMemory;
 		vk::ImageView imageView;
 		vk::Sampler sampler;
+		// the copy being made by recordMove
+		vk::Image movedImage;
+		vkUtilities::Allocation movedMemory;
+		// what finishMove switched away from, kept until releaseOriginal
+		vk::Image originalImage;
+		vkUtilities::Allocation originalMemory;
+		vk::ImageView originalView;
 
 		// Resource Descriptors
 		vk::DescriptorSetLayout layout;
 		vk::DescriptorSet descSet;
+		// the set finishMove switches to, allocated from descPool on the first move
+		vk::DescriptorSet spareDescSet;
 		vk::DescriptorPool descPool;
 
 		// Command Handles
@@ -46,8 +112,23 @@ namespace vkImage {
 		// Texture Type
 		vk::ImageViewType textureType;
 
-		void load();
-		void populate();
+		// finds the size and format without touching any pixels, a cooked blob stays mapped in cache until populate
+		void load(TextureCache& cache);
+		// cooked pixels are copied or decompressed from the cache, and files decoded, straight into a staging region
+		void populate(const TextureCache& cache);
+		// decodes every layer into destination, layers that fail to load are left black
+		void decodeLayers(unsigned char* destination);
+		// filters every level below the decoded one already at destination on the CPU, returns where each level starts
+		std::vector<vk::DeviceSize> downsampleLevels(unsigned char* destination);
+		// writes levels [firstLevel, lastLevel) as the image stores them and returns where each one starts
+		std::vector<vk::DeviceSize> stageLevels(const TextureCache& cache, uint32_t firstLevel, uint32_t lastLevel, unsigned char* destination) const;
+		// image for levels [allocatedLevel, mipLevels)
+		ImageInput getResidentImageInput() const;
+		void makeResidentImage();
+		// starts recording a texture's upload, staging through the texture's ring, on the transfer queue when it's dedicated and asked for
+		void beginBatch(vkUtilities::UploadBatch& batch, vk::CommandBuffer commandBuffer, vk::Queue queue, bool transfer) const;
+		// hands what a finished transfer batch released over to the graphics family
+		void acquire(const vkUtilities::UploadBatch& upload, vk::CommandBuffer commandBuffer, vk::Queue queue) const;
 		void makeView();
 		void makeSampler();
 		void makeDescriptorSet(uint32_t binding, uint32_t bindingCount = 1);
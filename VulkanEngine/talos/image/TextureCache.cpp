@@ -0,0 +1,192 @@
+#include "TextureCache.h"
+#include "../utilities/CacheFile.h"
+#include "../job/Job.h"
+#include "TextureCompression.h"
+
+namespace vkImage {
+	uint64_t hashTextureSources(const std::vector<std::string>& filenames) {
+		uint64_t hash = vkUtilities::FNV_OFFSET_BASIS;
+		for (const std::string& filename : filenames) {
+			// a missing layer still moves the hash, so it can't line up with a complete texture
+			vkUtilities::MappedFile file;
+			file.open(filename);
+			uint64_t size = file.getSize();
+			hash = vkUtilities::hashBytes(hash, &size, sizeof(size));
+			hash = vkUtilities::hashBytes(hash, file.getData(), file.getSize());
+		}
+
+		return hash;
+	}
+
+	bool TextureCache::load(const std::string& filepath, uint64_t sourceHash) {
+		close();
+		if (!file.open(filepath)) {
+			return false;
+		}
+
+		if (file.getSize() < sizeof(TextureCacheHeader)) {
+			file.close();
+			return false;
+		}
+
+		const TextureCacheHeader* candidate = reinterpret_cast<const TextureCacheHeader*>(file.getData());
+		if (candidate->magic != TEXTURE_CACHE_MAGIC
+			|| candidate->version != TEXTURE_CACHE_VERSION
+			|| candidate->sourceHash != sourceHash
+			|| candidate->levelCount == 0
+			|| candidate->levelCount > getMipLevelCount(candidate->width, candidate->height)
+			|| file.getSize() < sizeof(TextureCacheHeader) + sizeof(TextureLevel) * candidate->levelCount) {
+			file.close();
+			return false;
+		}
+
+		// levels have to tile the payload in order, each exactly the size its format says
+		const TextureLevel* table = reinterpret_cast<const TextureLevel*>(file.getData() + sizeof(TextureCacheHeader));
+		vk::Format format = static_cast<vk::Format>(candidate->format);
+		uint64_t expectedOffset = 0;
+		for (uint32_t i = 0; i < candidate->levelCount; i++) {
+			uint32_t levelWidth = std::max(1u, candidate->width >> i);
+			uint32_t levelHeight = std::max(1u, candidate->height >> i);
+			if (table[i].offset != expectedOffset
+				|| table[i].size != getEncodedSize(format, levelWidth, levelHeight) * candidate->layerCount) {
+				file.close();
+				return false;
+			}
+			expectedOffset += table[i].size;
+		}
+
+		const char* stored = reinterpret_cast<const char*>(table + candidate->levelCount);
+		size_t storedSize = file.getSize() - (stored - file.getData());
+
+		bool sized = false;
+		if (candidate->compression == static_cast<uint32_t>(vkUtilities::BlobCompression::NONE)) {
+			sized = storedSize == expectedOffset;
+		}
+		else if (candidate->compression == static_cast<uint32_t>(vkUtilities::BlobCompression::LZ4_BLOCKS)) {
+			const vkUtilities::BlockStreamHeader* stream = vkUtilities::readBlockStream(stored, storedSize);
+			sized = stream && stream->rawSize == expectedOffset;
+		}
+
+		if (!sized) {
+			file.close();
+			return false;
+		}
+
+		header = candidate;
+		levels = table;
+		payload = stored;
+		payloadSize = static_cast<size_t>(expectedOffset);
+		return true;
+	}
+
+	void TextureCache::close() {
+		header = nullptr;
+		levels = nullptr;
+		payload = nullptr;
+		payloadSize = 0;
+		file.close();
+	}
+
+	bool TextureCache::write(const std::string& filepath, uint64_t sourceHash, uint32_t width, uint32_t height, uint32_t layerCount, vk::Format format, const std::vector<std::vector<unsigned char>>& levels, bool compress) {
+		TextureCacheHeader header;
+		header.magic = TEXTURE_CACHE_MAGIC;
+		header.version = TEXTURE_CACHE_VERSION;
+		header.sourceHash = sourceHash;
+		header.width = width;
+		header.height = height;
+		header.layerCount = layerCount;
+		header.levelCount = static_cast<uint32_t>(levels.size());
+		header.format = static_cast<uint32_t>(format);
+		header.compression = static_cast<uint32_t>(compress ? vkUtilities::BlobCompression::LZ4_BLOCKS : vkUtilities::BlobCompression::NONE);
+
+		std::vector<TextureLevel> table;
+		uint64_t offset = 0;
+		for (const std::vector<unsigned char>& level : levels) {
+			table.push_back(TextureLevel{ offset, level.size() });
+			offset += level.size();
+		}
+
+		std::vector<vkUtilities::FilePiece> pieces = {
+			{ &header, sizeof(TextureCacheHeader) },
+			{ table.data(), sizeof(TextureLevel) * table.size() }
+		};
+		if (!compress) {
+			for (const std::vector<unsigned char>& level : levels) {
+				pieces.push_back({ level.data(), level.size() });
+			}
+
+			return vkUtilities::writeCacheFile(filepath, pieces);
+		}
+
+		// levels are compressed as one run so blocks can straddle them
+		std::vector<char> pixels(static_cast<size_t>(offset));
+		for (size_t i = 0; i < levels.size(); i++) {
+			memcpy(pixels.data() + table[i].offset, levels[i].data(), levels[i].size());
+		}
+		std::vector<char> stream;
+		vkUtilities::compressBlocks(pixels.data(), pixels.size(), stream);
+		pieces.push_back({ stream.data(), stream.size() });
+
+		return vkUtilities::writeCacheFile(filepath, pieces);
+	}
+
+	uint32_t TextureCache::getWidth() const {
+		return header ? header->width : 0;
+	}
+
+	uint32_t TextureCache::getHeight() const {
+		return header ? header->height : 0;
+	}
+
+	uint32_t TextureCache::getLayerCount() const {
+		return header ? header->layerCount : 0;
+	}
+
+	uint32_t TextureCache::getLevelCount() const {
+		return header ? header->levelCount : 0;
+	}
+
+	vk::Format TextureCache::getFormat() const {
+		return header ? static_cast<vk::Format>(header->format) : vk::Format::eUndefined;
+	}
+
+	const TextureLevel& TextureCache::getLevel(uint32_t level) const {
+		return levels[level];
+	}
+
+	size_t TextureCache::getPayloadSize() const {
+		return payloadSize;
+	}
+
+	bool TextureCache::isCompressed() const {
+		return header && header->compression != static_cast<uint32_t>(vkUtilities::BlobCompression::NONE);
+	}
+
+	bool TextureCache::copyPixels(void* destination, vkJob::JobQueue* queue) const {
+		if (!header) {
+			return false;
+		}
+
+		if (!isCompressed()) {
+			memcpy(destination, payload, payloadSize);
+			return true;
+		}
+
+		return vkJob::decompressBlocks(payload, file.getSize() - (payload - file.getData()), destination, queue);
+	}
+
+	bool TextureCache::copyLevels(uint32_t firstLevel, uint32_t lastLevel, void* destination) const {
+		if (!header || firstLevel >= lastLevel || lastLevel > header->levelCount) {
+			return false;
+		}
+
+		size_t offset = static_cast<size_t>(levels[firstLevel].offset);
+		size_t size = static_cast<size_t>(levels[lastLevel - 1].offset + levels[lastLevel - 1].size) - offset;
+		if (!isCompressed()) {
+			memcpy(destination, payload + offset, size);
+			return true;
+		}
+
+		return vkUtilities::decompressByteRange(payload, offset, size, static_cast<char*>(destination));
+	}
+}
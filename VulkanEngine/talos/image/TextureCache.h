@@ -0,0 +1,77 @@
+#pragma once
+#include "../config.h"
+#include "../utilities/MappedFile.h"
+#include "../utilities/BlockCompression.h"
+
+namespace vkJob {
+	class JobQueue;
+}
+
+/*
+	Cooked copy of a texture, laid out like a KTX2 file: a header, a table
+	with one entry per mip level, then the payload. The payload holds every
+	layer (six for a cubemap) of level 0, then every layer of level 1 and so
+	on, each in the texture's format (RGBA8 or a BC block format), so it can
+	be copied into a staging buffer as is and uploaded level by level.
+	Compressed copies keep the payload as a block stream that decompresses
+	straight into the staging buffer instead, the level table stays readable.
+*/
+namespace vkImage {
+	static const uint32_t TEXTURE_CACHE_MAGIC = 0x58455454; // "TTEX"
+	static const uint32_t TEXTURE_CACHE_VERSION = 3;
+
+	struct TextureCacheHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t sourceHash;
+		uint32_t width;
+		uint32_t height;
+		uint32_t layerCount;
+		uint32_t levelCount;
+		// a vk::Format
+		uint32_t format;
+		// a vkUtilities::BlobCompression
+		uint32_t compression;
+	};
+
+	// where a level's layers sit in the decompressed payload
+	struct TextureLevel {
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	// content hash of every layer's source image, in order
+	uint64_t hashTextureSources(const std::vector<std::string>& filenames);
+
+	class TextureCache {
+	public:
+		// returns false if the file is missing, truncated or was cooked from different sources
+		bool load(const std::string& filepath, uint64_t sourceHash);
+		void close();
+
+		// levels[i] holds every layer of level i back to back, already in format
+		static bool write(const std::string& filepath, uint64_t sourceHash, uint32_t width, uint32_t height, uint32_t layerCount, vk::Format format, const std::vector<std::vector<unsigned char>>& levels, bool compress = false);
+
+		uint32_t getWidth() const;
+		uint32_t getHeight() const;
+		uint32_t getLayerCount() const;
+		uint32_t getLevelCount() const;
+		vk::Format getFormat() const;
+		const TextureLevel& getLevel(uint32_t level) const;
+		// bytes of every level, as copyPixels writes them
+		size_t getPayloadSize() const;
+		bool isCompressed() const;
+
+		// writes the whole payload into destination, decompressing on the queue's workers if there is one
+		bool copyPixels(void* destination, vkJob::JobQueue* queue) const;
+		// writes levels [firstLevel, lastLevel) back to back into destination, on the calling thread
+		bool copyLevels(uint32_t firstLevel, uint32_t lastLevel, void* destination) const;
+
+	private:
+		vkUtilities::MappedFile file;
+		const TextureCacheHeader* header = nullptr;
+		const TextureLevel* levels = nullptr;
+		const char* payload = nullptr;
+		size_t payloadSize = 0;
+	};
+}
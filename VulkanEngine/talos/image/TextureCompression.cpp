@@ -0,0 +1,550 @@
+#include "TextureCompression.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace vkImage {
+	namespace {
+		// mode 6 steps from the first endpoint to the second, out of 64
+		const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		// BC1's four color palette as fractions of the way to the second endpoint
+		const float BC1_WEIGHTS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+		inline float clampChannel(float value) {
+			return std::min(255.0f, std::max(0.0f, value));
+		}
+
+		// principal axis of the block's first channelCount channels, by power iteration on their covariance
+		void findPrincipalAxis(const unsigned char* texels, int channelCount, float* mean, float* axis) {
+			for (int c = 0; c < channelCount; c++) {
+				mean[c] = 0.0f;
+				for (int i = 0; i < 16; i++) {
+					mean[c] += texels[i * 4 + c];
+				}
+				mean[c] /= 16.0f;
+			}
+
+			float covariance[4][4] = {};
+			for (int i = 0; i < 16; i++) {
+				float delta[4];
+				for (int c = 0; c < channelCount; c++) {
+					delta[c] = texels[i * 4 + c] - mean[c];
+				}
+				for (int a = 0; a < channelCount; a++) {
+					for (int b = 0; b < channelCount; b++) {
+						covariance[a][b] += delta[a] * delta[b];
+					}
+				}
+			}
+
+			// starting from the widest channel's column can't be orthogonal to the answer
+			int widest = 0;
+			for (int c = 1; c < channelCount; c++) {
+				if (covariance[c][c] > covariance[widest][widest]) {
+					widest = c;
+				}
+			}
+			for (int c = 0; c < channelCount; c++) {
+				axis[c] = covariance[c][widest];
+			}
+
+			for (int iteration = 0; iteration < 8; iteration++) {
+				float next[4] = {};
+				float length = 0.0f;
+				for (int a = 0; a < channelCount; a++) {
+					for (int b = 0; b < channelCount; b++) {
+						next[a] += covariance[a][b] * axis[b];
+					}
+					length += next[a] * next[a];
+				}
+
+				// a flat block has no axis, both endpoints land on the mean
+				if (length < 1e-12f) {
+					for (int c = 0; c < channelCount; c++) {
+						axis[c] = 0.0f;
+					}
+					return;
+				}
+
+				length = std::sqrt(length);
+				for (int c = 0; c < channelCount; c++) {
+					axis[c] = next[c] / length;
+				}
+			}
+		}
+
+		// ends of the line through the mean along the axis that just covers every texel
+		void findEndpoints(const unsigned char* texels, int channelCount, const float* mean, const float* axis, float* low, float* high) {
+			float minimum = 0.0f;
+			float maximum = 0.0f;
+			for (int i = 0; i < 16; i++) {
+				float projection = 0.0f;
+				for (int c = 0; c < channelCount; c++) {
+					projection += (texels[i * 4 + c] - mean[c]) * axis[c];
+				}
+				minimum = std::min(minimum, projection);
+				maximum = std::max(maximum, projection);
+			}
+
+			for (int c = 0; c < channelCount; c++) {
+				low[c] = clampChannel(mean[c] + axis[c] * minimum);
+				high[c] = clampChannel(mean[c] + axis[c] * maximum);
+			}
+		}
+
+		// least squares endpoints given how far each texel sits toward the second one
+		bool fitEndpoints(const unsigned char* texels, int channelCount, const float* weights, float* low, float* high) {
+			float lowLow = 0.0f, lowHigh = 0.0f, highHigh = 0.0f;
+			float lowSum[4] = {}, highSum[4] = {};
+			for (int i = 0; i < 16; i++) {
+				float weight = weights[i];
+				lowLow += (1.0f - weight) * (1.0f - weight);
+				lowHigh += (1.0f - weight) * weight;
+				highHigh += weight * weight;
+				for (int c = 0; c < channelCount; c++) {
+					lowSum[c] += (1.0f - weight) * texels[i * 4 + c];
+					highSum[c] += weight * texels[i * 4 + c];
+				}
+			}
+
+			float determinant = lowLow * highHigh - lowHigh * lowHigh;
+			if (std::fabs(determinant) < 1e-6f) {
+				return false;
+			}
+
+			for (int c = 0; c < channelCount; c++) {
+				low[c] = clampChannel((highHigh * lowSum[c] - lowHigh * highSum[c]) / determinant);
+				high[c] = clampChannel((lowLow * highSum[c] - lowHigh * lowSum[c]) / determinant);
+			}
+			return true;
+		}
+
+		inline uint16_t packRgb565(const float* color) {
+			uint16_t red = static_cast<uint16_t>(std::lround(color[0] * 31.0f / 255.0f));
+			uint16_t green = static_cast<uint16_t>(std::lround(color[1] * 63.0f / 255.0f));
+			uint16_t blue = static_cast<uint16_t>(std::lround(color[2] * 31.0f / 255.0f));
+			return static_cast<uint16_t>((red << 11) | (green << 5) | blue);
+		}
+
+		inline void unpackRgb565(uint16_t packed, int* color) {
+			int red = (packed >> 11) & 31;
+			int green = (packed >> 5) & 63;
+			int blue = packed & 31;
+			color[0] = (red << 3) | (red >> 2);
+			color[1] = (green << 2) | (green >> 4);
+			color[2] = (blue << 3) | (blue >> 2);
+		}
+
+		// BC7 is a 128 bit little endian bit stream
+		struct BitWriter {
+			unsigned char* output;
+			int position = 0;
+
+			void write(uint32_t value, int count) {
+				for (int i = 0; i < count; i++, position++) {
+					if ((value >> i) & 1) {
+						output[position >> 3] |= static_cast<unsigned char>(1 << (position & 7));
+					}
+				}
+			}
+		};
+
+		struct BitReader {
+			const unsigned char* input;
+			int position = 0;
+
+			uint32_t read(int count) {
+				uint32_t value = 0;
+				for (int i = 0; i < count; i++, position++) {
+					value |= static_cast<uint32_t>((input[position >> 3] >> (position & 7)) & 1) << i;
+				}
+				return value;
+			}
+		};
+
+		// 7 bits per channel plus a shared low bit, the p bit is whichever lands closer
+		void quantizeBc7Endpoint(const float* endpoint, int* quantized, int& pBit) {
+			// fully opaque and fully clear have to come back exact, only one p bit reaches each
+			int firstCandidate = endpoint[3] >= 254.5f ? 1 : 0;
+			int lastCandidate = endpoint[3] <= 0.5f ? 0 : 1;
+
+			float bestError = 0.0f;
+			for (int candidate = firstCandidate; candidate <= lastCandidate; candidate++) {
+				int values[4];
+				float error = 0.0f;
+				for (int c = 0; c < 4; c++) {
+					values[c] = std::min(127, std::max(0, static_cast<int>(std::lround((endpoint[c] - candidate) / 2.0f))));
+					float delta = static_cast<float>((values[c] << 1) | candidate) - endpoint[c];
+					error += delta * delta;
+				}
+
+				if (candidate == firstCandidate || error < bestError) {
+					bestError = error;
+					pBit = candidate;
+					std::copy(values, values + 4, quantized);
+				}
+			}
+		}
+
+		// fetches a 4x4 block, repeating the last row and column past the image's edge
+		void gatherBlock(const unsigned char* pixels, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, unsigned char* texels) {
+			for (uint32_t y = 0; y < 4; y++) {
+				uint32_t sourceY = std::min(blockY * 4 + y, height - 1);
+				for (uint32_t x = 0; x < 4; x++) {
+					uint32_t sourceX = std::min(blockX * 4 + x, width - 1);
+					memcpy(texels + (y * 4 + x) * 4, pixels + (static_cast<size_t>(sourceY) * width + sourceX) * 4, 4);
+				}
+			}
+		}
+	}
+
+	vk::Format getEncodingFormat(TextureEncoding encoding) {
+		switch (encoding) {
+		case TextureEncoding::BC1:
+			return vk::Format::eBc1RgbUnormBlock;
+		case TextureEncoding::BC7:
+			return vk::Format::eBc7UnormBlock;
+		default:
+			return vk::Format::eR8G8B8A8Unorm;
+		}
+	}
+
+	uint32_t getFormatBlockSize(vk::Format format) {
+		return format == vk::Format::eBc1RgbUnormBlock || format == vk::Format::eBc7UnormBlock ? 4 : 1;
+	}
+
+	size_t getEncodedSize(vk::Format format, uint32_t width, uint32_t height) {
+		size_t blocks = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4);
+		switch (format) {
+		case vk::Format::eBc1RgbUnormBlock:
+			return blocks * 8;
+		case vk::Format::eBc7UnormBlock:
+			return blocks * 16;
+		default:
+			return static_cast<size_t>(width) * height * 4;
+		}
+	}
+
+	uint32_t getMipLevelCount(uint32_t width, uint32_t height) {
+		uint32_t levels = 1;
+		while (width > 1 || height > 1) {
+			width = std::max(1u, width / 2);
+			height = std::max(1u, height / 2);
+			levels++;
+		}
+		return levels;
+	}
+
+	void downsampleImage(const unsigned char* pixels, uint32_t width, uint32_t height, std::vector<unsigned char>& output) {
+		uint32_t halfWidth = std::max(1u, width / 2);
+		uint32_t halfHeight = std::max(1u, height / 2);
+		output.resize(static_cast<size_t>(halfWidth) * halfHeight * 4);
+
+		for (uint32_t y = 0; y < halfHeight; y++) {
+			uint32_t top = std::min(y * 2, height - 1);
+			uint32_t bottom = std::min(y * 2 + 1, height - 1);
+			for (uint32_t x = 0; x < halfWidth; x++) {
+				uint32_t left = std::min(x * 2, width - 1);
+				uint32_t right = std::min(x * 2 + 1, width - 1);
+				for (int c = 0; c < 4; c++) {
+					int sum = pixels[(static_cast<size_t>(top) * width + left) * 4 + c]
+						+ pixels[(static_cast<size_t>(top) * width + right) * 4 + c]
+						+ pixels[(static_cast<size_t>(bottom) * width + left) * 4 + c]
+						+ pixels[(static_cast<size_t>(bottom) * width + right) * 4 + c];
+					output[(static_cast<size_t>(y) * halfWidth + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+				}
+			}
+		}
+	}
+
+	bool hasTranslucency(const unsigned char* pixels, uint32_t width, uint32_t height) {
+		size_t count = static_cast<size_t>(width) * height;
+		for (size_t i = 0; i < count; i++) {
+			if (pixels[i * 4 + 3] != 255) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void encodeImage(TextureEncoding encoding, const unsigned char* pixels, uint32_t width, uint32_t height, unsigned char* output) {
+		if (encoding == TextureEncoding::RGBA8) {
+			memcpy(output, pixels, static_cast<size_t>(width) * height * 4);
+			return;
+		}
+
+		size_t blockBytes = encoding == TextureEncoding::BC1 ? 8 : 16;
+		uint32_t blocksWide = (width + 3) / 4;
+		uint32_t blocksHigh = (height + 3) / 4;
+		unsigned char texels[64];
+		for (uint32_t blockY = 0; blockY < blocksHigh; blockY++) {
+			for (uint32_t blockX = 0; blockX < blocksWide; blockX++) {
+				gatherBlock(pixels, width, height, blockX, blockY, texels);
+				unsigned char* block = output + (static_cast<size_t>(blockY) * blocksWide + blockX) * blockBytes;
+				if (encoding == TextureEncoding::BC1) {
+					encodeBc1Block(texels, block);
+				}
+				else {
+					encodeBc7Block(texels, block);
+				}
+			}
+		}
+	}
+
+	void decodeImage(vk::Format format, const unsigned char* blocks, uint32_t width, uint32_t height, unsigned char* output) {
+		if (getFormatBlockSize(format) == 1) {
+			memcpy(output, blocks, static_cast<size_t>(width) * height * 4);
+			return;
+		}
+
+		size_t blockBytes = format == vk::Format::eBc1RgbUnormBlock ? 8 : 16;
+		uint32_t blocksWide = (width + 3) / 4;
+		uint32_t blocksHigh = (height + 3) / 4;
+		unsigned char texels[64];
+		for (uint32_t blockY = 0; blockY < blocksHigh; blockY++) {
+			for (uint32_t blockX = 0; blockX < blocksWide; blockX++) {
+				const unsigned char* block = blocks + (static_cast<size_t>(blockY) * blocksWide + blockX) * blockBytes;
+				if (format == vk::Format::eBc1RgbUnormBlock) {
+					decodeBc1Block(block, texels);
+				}
+				else {
+					decodeBc7Block(block, texels);
+				}
+
+				// edge blocks hang past the image, drop what's outside it
+				for (uint32_t y = 0; y < 4 && blockY * 4 + y < height; y++) {
+					for (uint32_t x = 0; x < 4 && blockX * 4 + x < width; x++) {
+						memcpy(output + ((static_cast<size_t>(blockY) * 4 + y) * width + blockX * 4 + x) * 4, texels + (y * 4 + x) * 4, 4);
+					}
+				}
+			}
+		}
+	}
+
+	void encodeBc1Block(const unsigned char* texels, unsigned char* output) {
+		float mean[4], axis[4];
+		float endpoints[2][4];
+		findPrincipalAxis(texels, 3, mean, axis);
+		findEndpoints(texels, 3, mean, axis, endpoints[1], endpoints[0]);
+
+		// the first try takes the principal axis, the second refits to the indices it picked
+		uint16_t bestColors[2] = { 0, 0 };
+		uint32_t bestIndices = 0;
+		float bestError = -1.0f;
+		for (int attempt = 0; attempt < 2; attempt++) {
+			uint16_t colors[2] = { packRgb565(endpoints[0]), packRgb565(endpoints[1]) };
+			// the first color has to be the larger one to get four colors rather than three and transparent
+			if (colors[0] < colors[1]) {
+				std::swap(colors[0], colors[1]);
+			}
+
+			int palette[4][3];
+			unpackRgb565(colors[0], palette[0]);
+			unpackRgb565(colors[1], palette[1]);
+			for (int c = 0; c < 3; c++) {
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			// equal colors decode in three color mode where index 3 is transparent, so only use index 0
+			int paletteSize = colors[0] == colors[1] ? 1 : 4;
+
+			uint32_t indices = 0;
+			float error = 0.0f;
+			float weights[16];
+			for (int i = 0; i < 16; i++) {
+				int bestIndex = 0;
+				int bestDistance = INT32_MAX;
+				for (int j = 0; j < paletteSize; j++) {
+					int distance = 0;
+					for (int c = 0; c < 3; c++) {
+						int delta = texels[i * 4 + c] - palette[j][c];
+						distance += delta * delta;
+					}
+					if (distance < bestDistance) {
+						bestDistance = distance;
+						bestIndex = j;
+					}
+				}
+
+				indices |= static_cast<uint32_t>(bestIndex) << (i * 2);
+				error += static_cast<float>(bestDistance);
+				weights[i] = BC1_WEIGHTS[bestIndex];
+			}
+
+			if (bestError < 0.0f || error < bestError) {
+				bestError = error;
+				bestColors[0] = colors[0];
+				bestColors[1] = colors[1];
+				bestIndices = indices;
+			}
+
+			// weights are toward the second packed color, which may have been swapped in
+			float refitted[2][4];
+			if (!fitEndpoints(texels, 3, weights, refitted[0], refitted[1])) {
+				break;
+			}
+			memcpy(endpoints, refitted, sizeof(endpoints));
+		}
+
+		output[0] = static_cast<unsigned char>(bestColors[0] & 0xFF);
+		output[1] = static_cast<unsigned char>(bestColors[0] >> 8);
+		output[2] = static_cast<unsigned char>(bestColors[1] & 0xFF);
+		output[3] = static_cast<unsigned char>(bestColors[1] >> 8);
+		for (int i = 0; i < 4; i++) {
+			output[4 + i] = static_cast<unsigned char>((bestIndices >> (i * 8)) & 0xFF);
+		}
+	}
+
+	void decodeBc1Block(const unsigned char* block, unsigned char* texels) {
+		uint16_t colors[2] = {
+			static_cast<uint16_t>(block[0] | (block[1] << 8)),
+			static_cast<uint16_t>(block[2] | (block[3] << 8))
+		};
+
+		int palette[4][4];
+		unpackRgb565(colors[0], palette[0]);
+		unpackRgb565(colors[1], palette[1]);
+		palette[0][3] = 255;
+		palette[1][3] = 255;
+		for (int c = 0; c < 3; c++) {
+			if (colors[0] > colors[1]) {
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			else {
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+		}
+		palette[2][3] = 255;
+		palette[3][3] = colors[0] > colors[1] ? 255 : 0;
+
+		uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | (static_cast<uint32_t>(block[7]) << 24);
+		for (int i = 0; i < 16; i++) {
+			int index = (indices >> (i * 2)) & 3;
+			for (int c = 0; c < 4; c++) {
+				texels[i * 4 + c] = static_cast<unsigned char>(palette[index][c]);
+			}
+		}
+	}
+
+	void encodeBc7Block(const unsigned char* texels, unsigned char* output) {
+		float mean[4], axis[4];
+		float endpoints[2][4];
+		findPrincipalAxis(texels, 4, mean, axis);
+		findEndpoints(texels, 4, mean, axis, endpoints[0], endpoints[1]);
+
+		int bestQuantized[2][4] = {};
+		int bestPBits[2] = { 0, 0 };
+		int bestIndices[16] = {};
+		float bestError = -1.0f;
+		for (int attempt = 0; attempt < 2; attempt++) {
+			int quantized[2][4];
+			int pBits[2];
+			int decoded[2][4];
+			for (int e = 0; e < 2; e++) {
+				quantizeBc7Endpoint(endpoints[e], quantized[e], pBits[e]);
+				for (int c = 0; c < 4; c++) {
+					decoded[e][c] = (quantized[e][c] << 1) | pBits[e];
+				}
+			}
+
+			int palette[16][4];
+			for (int j = 0; j < 16; j++) {
+				for (int c = 0; c < 4; c++) {
+					palette[j][c] = ((64 - BC7_WEIGHTS[j]) * decoded[0][c] + BC7_WEIGHTS[j] * decoded[1][c] + 32) >> 6;
+				}
+			}
+
+			int indices[16];
+			float error = 0.0f;
+			float weights[16];
+			for (int i = 0; i < 16; i++) {
+				int bestIndex = 0;
+				int bestDistance = INT32_MAX;
+				for (int j = 0; j < 16; j++) {
+					int distance = 0;
+					for (int c = 0; c < 4; c++) {
+						int delta = texels[i * 4 + c] - palette[j][c];
+						distance += delta * delta;
+					}
+					if (distance < bestDistance) {
+						bestDistance = distance;
+						bestIndex = j;
+					}
+				}
+
+				indices[i] = bestIndex;
+				error += static_cast<float>(bestDistance);
+				weights[i] = BC7_WEIGHTS[bestIndex] / 64.0f;
+			}
+
+			if (bestError < 0.0f || error < bestError) {
+				bestError = error;
+				memcpy(bestQuantized, quantized, sizeof(quantized));
+				memcpy(bestPBits, pBits, sizeof(pBits));
+				memcpy(bestIndices, indices, sizeof(indices));
+			}
+
+			if (!fitEndpoints(texels, 4, weights, endpoints[0], endpoints[1])) {
+				break;
+			}
+		}
+
+		// the first texel's index is stored without its top bit, so flip the block if it's set
+		if (bestIndices[0] & 8) {
+			std::swap(bestQuantized[0], bestQuantized[1]);
+			std::swap(bestPBits[0], bestPBits[1]);
+			for (int i = 0; i < 16; i++) {
+				bestIndices[i] = 15 - bestIndices[i];
+			}
+		}
+
+		memset(output, 0, 16);
+		BitWriter writer{ output };
+		writer.write(1 << 6, 7);
+		for (int c = 0; c < 4; c++) {
+			writer.write(bestQuantized[0][c], 7);
+			writer.write(bestQuantized[1][c], 7);
+		}
+		writer.write(bestPBits[0], 1);
+		writer.write(bestPBits[1], 1);
+		writer.write(bestIndices[0], 3);
+		for (int i = 1; i < 16; i++) {
+			writer.write(bestIndices[i], 4);
+		}
+	}
+
+	void decodeBc7Block(const unsigned char* block, unsigned char* texels) {
+		if ((block[0] & 0x7F) != 0x40) {
+			for (int i = 0; i < 16; i++) {
+				texels[i * 4 + 0] = 255;
+				texels[i * 4 + 1] = 0;
+				texels[i * 4 + 2] = 255;
+				texels[i * 4 + 3] = 255;
+			}
+			return;
+		}
+
+		BitReader reader{ block };
+		reader.read(7);
+		int decoded[2][4];
+		for (int c = 0; c < 4; c++) {
+			decoded[0][c] = reader.read(7) << 1;
+			decoded[1][c] = reader.read(7) << 1;
+		}
+		int pBits[2] = { static_cast<int>(reader.read(1)), static_cast<int>(reader.read(1)) };
+		for (int c = 0; c < 4; c++) {
+			decoded[0][c] |= pBits[0];
+			decoded[1][c] |= pBits[1];
+		}
+
+		for (int i = 0; i < 16; i++) {
+			int index = reader.read(i == 0 ? 3 : 4);
+			for (int c = 0; c < 4; c++) {
+				texels[i * 4 + c] = static_cast<unsigned char>(((64 - BC7_WEIGHTS[index]) * decoded[0][c] + BC7_WEIGHTS[index] * decoded[1][c] + 32) >> 6);
+			}
+		}
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "../config.h"
+
+/*
+	CPU side of the compressed texture pipeline. talos-cook builds a texture's
+	mip chain here and encodes every level into GPU block formats, and the
+	runtime decodes those blocks back to RGBA8 on devices that can't sample
+	them. BC1 blocks are 8 bytes of opaque color per 4x4 texels, BC7 blocks
+	are 16 bytes of color and alpha, always written in mode 6 (one pair of
+	RGBA endpoints with 16 steps between them).
+*/
+namespace vkImage {
+	enum class TextureEncoding {
+		RGBA8,
+		BC1,
+		BC7
+	};
+
+	vk::Format getEncodingFormat(TextureEncoding encoding);
+
+	// 4 for the block formats, 1 for uncompressed ones
+	uint32_t getFormatBlockSize(vk::Format format);
+
+	// bytes of one layer of an image this size in format
+	size_t getEncodedSize(vk::Format format, uint32_t width, uint32_t height);
+
+	// levels down to 1x1, counting the full size one
+	uint32_t getMipLevelCount(uint32_t width, uint32_t height);
+
+	// halves an RGBA8 image with a 2x2 box filter, odd sizes round down and never go below 1
+	void downsampleImage(const unsigned char* pixels, uint32_t width, uint32_t height, std::vector<unsigned char>& output);
+
+	// true if any texel isn't fully opaque, which BC1 can't keep
+	bool hasTranslucency(const unsigned char* pixels, uint32_t width, uint32_t height);
+
+	// output must hold getEncodedSize bytes, blocks go row by row and edge blocks repeat the last texel
+	void encodeImage(TextureEncoding encoding, const unsigned char* pixels, uint32_t width, uint32_t height, unsigned char* output);
+
+	// back to RGBA8 for devices without the block format, output must hold width * height * 4 bytes
+	void decodeImage(vk::Format format, const unsigned char* blocks, uint32_t width, uint32_t height, unsigned char* output);
+
+	// one 4x4 block, texels in rows of 4 RGBA8
+	void encodeBc1Block(const unsigned char* texels, unsigned char* output);
+	void encodeBc7Block(const unsigned char* texels, unsigned char* output);
+	void decodeBc1Block(const unsigned char* block, unsigned char* texels);
+	// only mode 6 is understood, other modes decode to magenta
+	void decodeBc7Block(const unsigned char* block, unsigned char* texels);
+}
@@ -0,0 +1,277 @@
+#include "TextureStreamer.h"
+#include "../job/WorkerThread.h"
+#include "../utilities/DeviceAllocator.h"
+#include <algorithm>
+
+namespace vkImage {
+	StageLevelsJob::StageLevelsJob(const Texture* texture, uint32_t firstLevel, uint32_t lastLevel) {
+		this->texture = texture;
+		this->firstLevel = firstLevel;
+		this->lastLevel = lastLevel;
+	}
+
+	void StageLevelsJob::execute(vk::CommandBuffer commandBuffer, vk::Queue queue) {
+		levelOffsets = texture->stageLevels(firstLevel, lastLevel, staged);
+		status = vkJob::JobStatus::FINISHED;
+	}
+
+	void TextureStreamer::create(TextureStreamerInput input) {
+		this->input = input;
+		budget = input.budget;
+	}
+
+	void TextureStreamer::add(Texture* texture) {
+		if (!texture->isStreamed() || indices.count(texture)) {
+			return;
+		}
+
+		indices.insert({ texture, textures.size() });
+		textures.push_back(StreamedTexture{ texture, texture->getResidentLevel(), texture->getResidentLevel(), 0, nullptr, nullptr });
+	}
+
+	void TextureStreamer::request(Texture* texture, uint32_t level) {
+		std::unordered_map<const Texture*, size_t>::iterator found = indices.find(texture);
+		if (found == indices.end()) {
+			return;
+		}
+
+		StreamedTexture& streamed = textures[found->second];
+		level = std::min(level, streamed.startLevel);
+		if (streamed.lastRequestFrame != frame) {
+			streamed.requestedLevel = level;
+			streamed.lastRequestFrame = frame;
+		}
+		else {
+			streamed.requestedLevel = std::min(streamed.requestedLevel, level);
+		}
+	}
+
+	vk::DeviceSize TextureStreamer::getSize(const StreamedTexture& streamed) const {
+		return streamed.texture->getLevelsSize(streamed.texture->getAllocatedLevel(), streamed.texture->getMipLevelCount());
+	}
+
+	vk::DeviceSize TextureStreamer::getBudget(vk::DeviceSize residentSize) const {
+		if (!input.allocator) {
+			return input.budget;
+		}
+
+		// resident levels would be freed by shrinking, so they count toward what's available
+		vk::DeviceSize available = residentSize + input.allocator->getAvailable(vk::MemoryPropertyFlagBits::eDeviceLocal);
+		if (available <= input.headroom) {
+			return 0;
+		}
+		return std::min(input.budget, available - input.headroom);
+	}
+
+	bool TextureStreamer::isBusy(const StreamedTexture& streamed) const {
+		return streamed.job || streamed.upload || streamed.texture->isMoving();
+	}
+
+	vk::DeviceSize TextureStreamer::getResidentSize() const {
+		vk::DeviceSize size = 0;
+		for (const StreamedTexture& streamed : textures) {
+			size += getSize(streamed);
+		}
+		return size;
+	}
+
+	bool TextureStreamer::evict(vk::DeviceSize needed, vk::DeviceSize& residentSize, std::vector<std::pair<size_t, uint32_t>>& changes) {
+		// unseen textures fall back to where they started, seen ones only to what they were asked for
+		std::vector<std::pair<size_t, uint32_t>> candidates;
+		for (size_t i = 0; i < textures.size(); i++) {
+			const StreamedTexture& streamed = textures[i];
+			bool changing = std::any_of(changes.begin(), changes.end(), [i](const std::pair<size_t, uint32_t>& change) { return change.first == i; });
+			if (isBusy(streamed) || changing) {
+				continue;
+			}
+
+			uint32_t target = streamed.lastRequestFrame + 1 == frame ? streamed.requestedLevel : streamed.startLevel;
+			if (target > streamed.texture->getAllocatedLevel()) {
+				candidates.push_back({ i, target });
+			}
+		}
+
+		std::sort(candidates.begin(), candidates.end(), [this](const std::pair<size_t, uint32_t>& a, const std::pair<size_t, uint32_t>& b) {
+			return textures[a.first].lastRequestFrame < textures[b.first].lastRequestFrame;
+		});
+
+		for (const std::pair<size_t, uint32_t>& candidate : candidates) {
+			if (residentSize + needed <= budget) {
+				break;
+			}
+
+			const Texture* texture = textures[candidate.first].texture;
+			residentSize -= texture->getLevelsSize(texture->getAllocatedLevel(), candidate.second);
+			changes.push_back(candidate);
+		}
+
+		return residentSize + needed <= budget;
+	}
+
+	void TextureStreamer::update() {
+		frame++;
+
+		// picks up jobs added while the last worker was already on its way out
+		startWorker();
+		upload();
+
+		// only copies that have finished swap in, the rest carry on beside the frame
+		std::vector<size_t> fills;
+		for (size_t i = 0; i < textures.size(); i++) {
+			if (textures[i].upload && textures[i].upload->isFinished() && fills.size() < input.maxChangesPerFrame) {
+				fills.push_back(i);
+			}
+		}
+
+		// the new start level of each texture that moves, finer or coarser
+		std::vector<std::pair<size_t, uint32_t>> changes;
+		vk::DeviceSize residentSize = getResidentSize();
+		budget = getBudget(residentSize);
+		if (residentSize > budget) {
+			evict(0, residentSize, changes);
+		}
+
+		// textures furthest from the detail they're seen at grow first
+		std::vector<size_t> growing;
+		for (size_t i = 0; i < textures.size(); i++) {
+			const StreamedTexture& streamed = textures[i];
+			if (!isBusy(streamed) && streamed.lastRequestFrame + 1 == frame && streamed.requestedLevel < streamed.texture->getAllocatedLevel()) {
+				growing.push_back(i);
+			}
+		}
+		std::sort(growing.begin(), growing.end(), [this](size_t a, size_t b) {
+			return textures[a].texture->getAllocatedLevel() - textures[a].requestedLevel > textures[b].texture->getAllocatedLevel() - textures[b].requestedLevel;
+		});
+
+		uint32_t grown = 0;
+		for (size_t i : growing) {
+			if (fills.size() + grown >= input.maxChangesPerFrame) {
+				break;
+			}
+
+			const StreamedTexture& streamed = textures[i];
+			vk::DeviceSize growth = streamed.texture->getLevelsSize(streamed.requestedLevel, streamed.texture->getAllocatedLevel());
+			if (residentSize + growth > budget && !evict(growth, residentSize, changes)) {
+				continue;
+			}
+
+			changes.push_back({ i, streamed.requestedLevel });
+			residentSize += growth;
+			grown++;
+		}
+
+		if (fills.empty() && changes.empty()) {
+			return;
+		}
+
+		// textures are bound by every frame in flight, so nothing can be drawing while they swap images
+		input.device.waitIdle();
+
+		// every landing texture is acquired from the transfer family in one submission
+		if (input.uploadQueues.isDedicated() && !fills.empty()) {
+			vkUtilities::UploadBatchInput batchInput;
+			batchInput.device = input.device;
+			batchInput.commandBuffer = input.commandBuffer;
+			batchInput.queue = input.queue;
+			batchInput.queueFamily = input.uploadQueues.graphicsFamily;
+			batchInput.ownerFamily = input.uploadQueues.graphicsFamily;
+			batchInput.stagingRing = input.stagingRing;
+			vkUtilities::UploadBatch batch;
+			batch.begin(batchInput);
+			for (size_t i : fills) {
+				textures[i].upload->recordAcquire(batch.getCommandBuffer());
+			}
+			batch.wait();
+		}
+
+		for (size_t i : fills) {
+			StreamedTexture& streamed = textures[i];
+			streamed.texture->landLevels();
+			streamed.upload->destroy();
+			streamed.upload.reset();
+		}
+
+		for (const std::pair<size_t, uint32_t>& change : changes) {
+			StreamedTexture& streamed = textures[change.first];
+			streamed.texture->reallocate(change.second, input.commandBuffer, input.queue);
+
+			// grown textures are clamped to what they had until the worker reads the rest
+			if (streamed.texture->getResidentLevel() > streamed.texture->getAllocatedLevel()) {
+				streamed.job = std::make_unique<StageLevelsJob>(streamed.texture, streamed.texture->getAllocatedLevel(), streamed.texture->getResidentLevel());
+				jobQueue.add(streamed.job.get());
+			}
+		}
+
+		startWorker();
+
+		if (input.debug) {
+			std::cout << "Texture streaming: " << fills.size() << " textures filled, " << changes.size() << " resized, "
+				<< getResidentSize() / (1024 * 1024) << "MB of " << budget / (1024 * 1024) << "MB resident" << std::endl;
+		}
+	}
+
+	void TextureStreamer::startWorker() {
+		if (working) {
+			return;
+		}
+
+		// with no worker running, any unfinished job is still sitting in the queue
+		bool staging = std::any_of(textures.begin(), textures.end(), [](const StreamedTexture& streamed) {
+			return streamed.job && streamed.job->status != vkJob::JobStatus::FINISHED;
+		});
+		if (!staging) {
+			return;
+		}
+
+		// the last worker is past its final job, joining only waits for it to return
+		if (worker.joinable()) {
+			worker.join();
+		}
+
+		working = true;
+		worker = std::thread([this]() {
+			vkJob::WorkerThread(jobQueue, nullptr, nullptr)();
+			working = false;
+		});
+	}
+
+	void TextureStreamer::upload() {
+		for (StreamedTexture& streamed : textures) {
+			if (!streamed.job || streamed.job->status != vkJob::JobStatus::FINISHED) {
+				continue;
+			}
+
+			// a command buffer per upload, each is recorded and left in flight independently
+			vkUtilities::UploadBatchInput batchInput;
+			batchInput.device = input.device;
+			batchInput.commandBuffer = nullptr;
+			batchInput.queue = input.uploadQueues.transferQueue;
+			batchInput.queueFamily = input.uploadQueues.transferFamily;
+			batchInput.ownerFamily = input.uploadQueues.graphicsFamily;
+			batchInput.stagingRing = input.stagingRing;
+			streamed.upload = std::make_unique<vkUtilities::UploadBatch>();
+			streamed.upload->begin(batchInput);
+
+			streamed.texture->fillLevels(streamed.job->staged, streamed.job->levelOffsets, *streamed.upload);
+			streamed.upload->submit();
+			streamed.job.reset();
+		}
+	}
+
+	void TextureStreamer::destroy() {
+		jobQueue.clearQueue();
+		if (worker.joinable()) {
+			worker.join();
+		}
+		for (StreamedTexture& streamed : textures) {
+			if (streamed.job) {
+				input.stagingRing->release(streamed.job->staged);
+			}
+			if (streamed.upload) {
+				streamed.upload->destroy();
+			}
+		}
+		textures.clear();
+		indices.clear();
+	}
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include "../config.h"
+#include "Texture.h"
+#include "../job/Job.h"
+#include <memory>
+#include <atomic>
+
+/*
+	Keeps streamed textures at the detail they're seen at. The engine asks
+	for a level per texture every frame from how big its instances are on
+	screen, update grows textures toward that on a background thread and
+	drops the finer levels of textures that haven't been asked for lately
+	whenever growing would go over the budget. With an allocator the budget
+	also shrinks to what the device local heap can spare, so textures give
+	up levels when other memory grows. A growing texture swaps to its
+	bigger image straight away, still sampling only the levels it had until
+	the rest land. Those are uploaded on the transfer queue while frames keep
+	rendering, and only handed over once the copy has finished.
+*/
+namespace vkImage {
+	// cooked textures bigger than this many texels across start with their coarse levels only
+	static const uint32_t TEXTURE_STREAMING_START_SIZE = 256;
+	// device memory streamed textures leave spare for everything else
+	static const vk::DeviceSize TEXTURE_STREAMING_HEADROOM = 64 * 1024 * 1024;
+
+	struct TextureStreamerInput {
+		vk::Device device;
+		// residency changes are recorded and submitted here, on the thread calling update
+		vk::CommandBuffer commandBuffer;
+		vk::Queue queue;
+		// staged levels upload here without waiting on anything
+		vkUtilities::UploadQueues uploadQueues;
+		// device memory streamed textures may take between them
+		vk::DeviceSize budget;
+		// when set, the budget is cut to what its device local heap has available less the headroom
+		vkUtilities::DeviceAllocator* allocator = nullptr;
+		vk::DeviceSize headroom = TEXTURE_STREAMING_HEADROOM;
+		// every change waits for the device, so only this many go through a frame
+		uint32_t maxChangesPerFrame = 4;
+		// the same ring the textures were loaded through, levels staged but never filled go back to it
+		vkUtilities::StagingRing* stagingRing;
+		bool debug;
+	};
+
+	class StageLevelsJob : public vkJob::Job {
+	public:
+		const Texture* texture;
+		uint32_t firstLevel;
+		uint32_t lastLevel;
+		vkUtilities::StagingRegion staged;
+		std::vector<vk::DeviceSize> levelOffsets;
+		StageLevelsJob(const Texture* texture, uint32_t firstLevel, uint32_t lastLevel);
+		virtual void execute(vk::CommandBuffer commandBuffer, vk::Queue queue) final;
+	};
+
+	class TextureStreamer {
+	public:
+		void create(TextureStreamerInput input);
+		// textures that aren't streamed are ignored
+		void add(Texture* texture);
+		// finest level the texture is needed at this frame, the finest of every request counts
+		void request(Texture* texture, uint32_t level);
+		// lands finished levels and moves textures toward what was requested last frame, before any recording
+		void update();
+		void destroy();
+
+		vk::DeviceSize getResidentSize() const;
+
+	private:
+		struct StreamedTexture {
+			Texture* texture;
+			// never dropped below the levels it started with
+			uint32_t startLevel;
+			uint32_t requestedLevel;
+			uint64_t lastRequestFrame;
+			std::unique_ptr<StageLevelsJob> job;
+			// the staged levels' copy, in flight until it's finished and landed
+			std::unique_ptr<vkUtilities::UploadBatch> upload;
+		};
+
+		TextureStreamerInput input;
+		std::vector<StreamedTexture> textures;
+		std::unordered_map<const Texture*, size_t> indices;
+		vkJob::JobQueue jobQueue;
+		std::thread worker;
+		// cleared by the worker as it leaves, whatever is still queued then waits for the next one
+		std::atomic<bool> working{ false };
+		uint64_t frame = 0;
+		// this frame's budget, input.budget or less when the device is short
+		vk::DeviceSize budget = 0;
+
+		vk::DeviceSize getSize(const StreamedTexture& streamed) const;
+		vk::DeviceSize getBudget(vk::DeviceSize residentSize) const;
+		// levels are being read or uploaded, or the defragmenter is moving it, the texture can't change size until that's done
+		bool isBusy(const StreamedTexture& streamed) const;
+		// starts a worker for any levels still waiting to be read, unless one is already running
+		void startWorker();
+		// submits the copy of every staged texture's levels, never waiting for one
+		void upload();
+		// frees room by dropping the least recently seen textures to their start levels
+		bool evict(vk::DeviceSize needed, vk::DeviceSize& residentSize, std::vector<std::pair<size_t, uint32_t>>& changes);
+	};
+}
@@ -1,4 +1,6 @@
 #include "Job.h"
+#include <algorithm>
+#include <memory>
 
 namespace vkJob {
 	LoadModelJob::LoadModelJob(vkMesh::ObjMesh& mesh, std::string objFilepath, std::string mtlFilepath, glm::mat4 preTransform) : mesh(mesh) {
@@ -9,7 +11,19 @@ namespace vkJob {
 
 	// TODO: Removed unused parameters
 	void LoadModelJob::execute(vk::CommandBuffer commandBuffer, vk::Queue queue) {
-		mesh.load(objFilepath, mtlFilepath, preTransform);
+		if (cookedPath.empty() || !mesh.loadCooked(cookedPath, cookedHash)) {
+			mesh.load(objFilepath, mtlFilepath, preTransform);
+		}
+		status = JobStatus::FINISHED;
+	}
+
+	ParseObjChunkJob::ParseObjChunkJob(const vkMesh::ObjMesh& mesh, const char* begin, const char* end, vkMesh::ObjChunk& chunk) : mesh(mesh), chunk(chunk) {
+		this->begin = begin;
+		this->end = end;
+	}
+
+	void ParseObjChunkJob::execute(vk::CommandBuffer commandBuffer, vk::Queue queue) {
+		mesh.readChunk(begin, end, chunk);
 		status = JobStatus::FINISHED;
 	}
 
@@ -25,10 +39,89 @@ namespace vkJob {
 		status = JobStatus::FINISHED;
 	}
 
+	DecodeImageJob::DecodeImageJob(std::string filename, DecodedImage& image) : image(image) {
+		this->filename = filename;
+	}
+
+	void DecodeImageJob::execute(vk::CommandBuffer commandBuffer, vk::Queue queue) {
+		image.pixels = vkImage::loadImageFile(filename, &image.width, &image.height, &image.channels, STBI_rgb_alpha);
+
+		// stbi only decodes into memory of its own, so it's handed back as soon as the pixels are out
+		if (image.pixels && image.destination) {
+			bool fits = static_cast<size_t>(image.width) * image.height * STBI_rgb_alpha == image.destinationSize;
+			if (fits) {
+				memcpy(image.destination, image.pixels, image.destinationSize);
+			}
+			stbi_image_free(image.pixels);
+			image.pixels = fits ? image.destination : nullptr;
+		}
+		status = JobStatus::FINISHED;
+	}
+
+	DecompressBlocksJob::DecompressBlocksJob(const char* stream, uint32_t firstBlock, uint32_t lastBlock, char* destination) {
+		this->stream = stream;
+		this->firstBlock = firstBlock;
+		this->lastBlock = lastBlock;
+		this->destination = destination;
+	}
+
+	void DecompressBlocksJob::execute(vk::CommandBuffer commandBuffer, vk::Queue queue) {
+		succeeded = vkUtilities::decompressBlockRange(stream, firstBlock, lastBlock, destination);
+		status = JobStatus::FINISHED;
+	}
+
+	bool decompressBlocks(const char* stream, size_t streamSize, void* destination, JobQueue* queue) {
+		const vkUtilities::BlockStreamHeader* header = vkUtilities::readBlockStream(stream, streamSize);
+		if (!header) {
+			return false;
+		}
+
+		char* output = static_cast<char*>(destination);
+		if (!queue || header->blockCount <= DECOMPRESS_BLOCKS_PER_JOB) {
+			return vkUtilities::decompressBlockRange(stream, 0, header->blockCount, output);
+		}
+
+		// blocks write disjoint ranges of the destination, so the jobs never touch the same bytes
+		std::vector<std::unique_ptr<DecompressBlocksJob>> jobs;
+		std::vector<Job*> queued;
+		for (uint32_t block = 0; block < header->blockCount; block += DECOMPRESS_BLOCKS_PER_JOB) {
+			uint32_t lastBlock = std::min(block + DECOMPRESS_BLOCKS_PER_JOB, header->blockCount);
+			jobs.push_back(std::make_unique<DecompressBlocksJob>(stream, block, lastBlock, output));
+			queued.push_back(jobs.back().get());
+		}
+		queue->runAndWait(queued);
+
+		bool succeeded = true;
+		for (std::unique_ptr<DecompressBlocksJob>& job : jobs) {
+			succeeded = succeeded && job->succeeded;
+		}
+
+		return succeeded;
+	}
+
+	void decodeImages(const std::vector<std::string>& filenames, std::vector<DecodedImage>& images, JobQueue* queue) {
+		images.resize(filenames.size());
+		std::vector<std::unique_ptr<DecodeImageJob>> jobs;
+		std::vector<Job*> queued;
+		for (size_t i = 0; i < filenames.size(); i++) {
+			jobs.push_back(std::make_unique<DecodeImageJob>(filenames[i], images[i]));
+			queued.push_back(jobs.back().get());
+		}
+
+		if (!queue || jobs.size() == 1) {
+			for (std::unique_ptr<DecodeImageJob>& job : jobs) {
+				job->execute(nullptr, nullptr);
+			}
+			return;
+		}
+
+		queue->runAndWait(queued);
+	}
+
 	// TODO: Move this stuff to a separate class mayhaps
 	void JobQueue::add(Job* job) {
 		lock.lock();
-		jobQueue.emplace(job);
+		jobQueue.push_back(job);
 		finished = false;
 		lock.unlock();
 	}
@@ -43,11 +136,41 @@ namespace vkJob {
 		}
 
 		Job* nextJob = jobQueue.front();
-		jobQueue.pop();
+		jobQueue.pop_front();
 		lock.unlock();
 		return nextJob;	
 	}
 
+	bool JobQueue::remove(Job* job) {
+		lock.lock();
+		std::deque<Job*>::iterator position = std::find(jobQueue.begin(), jobQueue.end(), job);
+		bool found = position != jobQueue.end();
+		if (found) {
+			jobQueue.erase(position);
+		}
+		lock.unlock();
+		return found;
+	}
+
+	void JobQueue::runAndWait(const std::vector<Job*>& jobs) {
+		for (Job* job : jobs) {
+			add(job);
+		}
+
+		// workers may already have run out of other work and left, so the caller works through its own jobs too
+		for (Job* job : jobs) {
+			if (remove(job)) {
+				job->execute(nullptr, nullptr);
+			}
+		}
+
+		for (Job* job : jobs) {
+			while (job->status != JobStatus::FINISHED) {
+				std::this_thread::yield();
+			}
+		}
+	}
+
 	void JobQueue::clearQueue() {
 		lock.lock();
 		jobQueue = {};
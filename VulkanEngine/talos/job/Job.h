@@ -3,7 +3,9 @@
 #include "../mesh/ObjMesh.h"
 #include "../image/Image.h"
 #include "../image/Texture.h"
-#include <queue>
+#include "../utilities/BlockCompression.h"
+#include <deque>
+#include <atomic>
 
 namespace vkJob {
 	enum class JobStatus {
@@ -14,7 +16,8 @@ namespace vkJob {
 
 	class Job {
 	public:
-		JobStatus status = JobStatus::PENDING;
+		// atomic so whoever queued the job can poll it while a worker runs it
+		std::atomic<JobStatus> status{ JobStatus::PENDING };
 		virtual void execute(vk::CommandBuffer commandBuffer, vk::Queue queue) = 0;
 	};
 
@@ -23,11 +26,24 @@ namespace vkJob {
 		std::string objFilepath;
 		std::string mtlFilepath;
 		glm::mat4 preTransform;
+		// a blob from talos-cook to try before the sources, if set
+		std::string cookedPath;
+		uint64_t cookedHash = 0;
 		vkMesh::ObjMesh& mesh;
 		LoadModelJob(vkMesh::ObjMesh& objMesh, std::string objFilepath, std::string mtlFilepath, glm::mat4 preTransform);
 		virtual void execute(vk::CommandBuffer commandBuffer, vk::Queue queue) final;
 	};
 
+	class ParseObjChunkJob : public Job {
+	public:
+		const vkMesh::ObjMesh& mesh;
+		const char* begin;
+		const char* end;
+		vkMesh::ObjChunk& chunk;
+		ParseObjChunkJob(const vkMesh::ObjMesh& mesh, const char* begin, const char* end, vkMesh::ObjChunk& chunk);
+		virtual void execute(vk::CommandBuffer commandBuffer, vk::Queue queue) final;
+	};
+
 	class LoadTextureJob : public Job {
 	public:
 		vkImage::TextureInput texInfo;
@@ -36,14 +52,66 @@ namespace vkJob {
 		virtual void execute(vk::CommandBuffer commandBuffer, vk::Queue queue) final;
 	};
 
+	// one layer of a texture decoded to RGBA8, pixels stay null if the file couldn't be read
+	struct DecodedImage {
+		stbi_uc* pixels = nullptr;
+		int width = 0;
+		int height = 0;
+		int channels = 0;
+		// when set the layer lands here instead and pixels points at it, only if it decodes to exactly destinationSize bytes
+		unsigned char* destination = nullptr;
+		size_t destinationSize = 0;
+	};
+
+	class DecodeImageJob : public Job {
+	public:
+		std::string filename;
+		DecodedImage& image;
+		DecodeImageJob(std::string filename, DecodedImage& image);
+		virtual void execute(vk::CommandBuffer commandBuffer, vk::Queue queue) final;
+	};
+
+	class DecompressBlocksJob : public Job {
+	public:
+		const char* stream;
+		uint32_t firstBlock;
+		uint32_t lastBlock;
+		char* destination;
+		bool succeeded = false;
+		DecompressBlocksJob(const char* stream, uint32_t firstBlock, uint32_t lastBlock, char* destination);
+		virtual void execute(vk::CommandBuffer commandBuffer, vk::Queue queue) final;
+	};
+
 	class JobQueue {
 		private:
-			std::queue<Job*> jobQueue;
+			std::deque<Job*> jobQueue;
 			std::mutex lock;
 			bool finished = false;
 		public:
 			void add(Job* job);
 			Job* getNextJob();
+			// takes a job back out if no worker has picked it up yet, so the caller can run it itself
+			bool remove(Job* job);
+			// queues every job, runs whichever no worker has picked up on the calling thread and returns once all are finished
+			void runAndWait(const std::vector<Job*>& jobs);
 			void clearQueue();
 	};
+
+	// compressed blocks handed to each decompression job, 1MB of output at the default block size
+	static const uint32_t DECOMPRESS_BLOCKS_PER_JOB = 4;
+
+	/*
+		Decompresses a whole block stream straight into destination, which must
+		hold its raw size. With a queue the blocks are spread over its workers
+		and the calling thread works through whatever they haven't picked up.
+	*/
+	bool decompressBlocks(const char* stream, size_t streamSize, void* destination, JobQueue* queue);
+
+	/*
+		Decodes every file into images, in order, keeping any destinations
+		already set on them. With a queue each file is its
+		own job, so a cubemap's faces decode side by side, and the calling
+		thread works through whatever the workers haven't picked up.
+	*/
+	void decodeImages(const std::vector<std::string>& filenames, std::vector<DecodedImage>& images, JobQueue* queue);
 }
\ No newline at end of file
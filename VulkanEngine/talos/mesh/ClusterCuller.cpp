@@ -0,0 +1,262 @@
+#include "ClusterCuller.h"
+#include "../utilities/FileLoader.h"
+
+namespace vkMesh {
+	namespace {
+		// must match local_size_x in cluster_cull.comp
+		const uint32_t CULL_GROUP_SIZE = 64;
+
+		enum CullBinding : uint32_t {
+			MESHLETS = 0,
+			MESHLET_VERTICES = 1,
+			MESHLET_TRIANGLES = 2,
+			MODEL_TRANSFORMS = 3,
+			DRAWS = 4,
+			INDIRECT_COMMANDS = 5,
+			OUTPUT_INDICES = 6,
+			BINDING_COUNT = 7
+		};
+
+		vk::WriteDescriptorSet makeBufferWrite(vk::DescriptorSet set, uint32_t binding, const vk::DescriptorBufferInfo* info) {
+			vk::WriteDescriptorSet write;
+			write.dstSet = set;
+			write.dstBinding = binding;
+			write.dstArrayElement = 0;
+			write.descriptorType = vk::DescriptorType::eStorageBuffer;
+			write.descriptorCount = 1;
+			write.pBufferInfo = info;
+			return write;
+		}
+	}
+
+	void extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]) {
+		// rows of the matrix, glm stores it by column
+		glm::vec4 rows[4];
+		for (int row = 0; row < 4; row++) {
+			rows[row] = glm::vec4(viewProjection[0][row], viewProjection[1][row], viewProjection[2][row], viewProjection[3][row]);
+		}
+
+		planes[0] = rows[3] + rows[0];
+		planes[1] = rows[3] - rows[0];
+		planes[2] = rows[3] + rows[1];
+		planes[3] = rows[3] - rows[1];
+		// vulkan clips depth to 0..w, so the near plane is the third row alone
+		planes[4] = rows[2];
+		planes[5] = rows[3] - rows[2];
+
+		for (int i = 0; i < 6; i++) {
+			float length = glm::length(glm::vec3(planes[i]));
+			if (length > 0.0f) {
+				planes[i] = planes[i] * (1.0f / length);
+			}
+		}
+	}
+
+	bool ClusterCuller::create(const ClusterCullerInput& input) {
+		device = input.device;
+		settings = input;
+
+		vkInit::DescriptorSetLayoutData bindings;
+		bindings.count = BINDING_COUNT;
+		for (uint32_t i = 0; i < BINDING_COUNT; i++) {
+			bindings.indices.push_back(i);
+			bindings.types.push_back(vk::DescriptorType::eStorageBuffer);
+			bindings.counts.push_back(1);
+			bindings.shaderStages.push_back(vk::ShaderStageFlagBits::eCompute);
+		}
+		descriptorSetLayout = vkInit::makeDescriptorSetLayout(device, bindings);
+		descriptorPool = vkInit::createDescriptorPool(device, input.frameCount, bindings);
+
+		if (!createPipeline()) {
+			return false;
+		}
+
+		frames.resize(input.frameCount);
+		for (Frame& frame : frames) {
+			createFrame(frame);
+		}
+		return true;
+	}
+
+	bool ClusterCuller::createPipeline() {
+		vk::PushConstantRange constantRange;
+		constantRange.stageFlags = vk::ShaderStageFlagBits::eCompute;
+		constantRange.offset = 0;
+		constantRange.size = sizeof(CullingConstants);
+
+		vk::PipelineLayoutCreateInfo layoutInfo;
+		layoutInfo.flags = vk::PipelineLayoutCreateFlags();
+		layoutInfo.setLayoutCount = 1;
+		layoutInfo.pSetLayouts = &descriptorSetLayout;
+		layoutInfo.pushConstantRangeCount = 1;
+		layoutInfo.pPushConstantRanges = &constantRange;
+
+		try {
+			pipelineLayout = device.createPipelineLayout(layoutInfo);
+		}
+		catch (vk::SystemError err) {
+			std::cerr << "Failed to make cluster cull pipeline layout due to " << err.what() << std::endl;
+			return false;
+		}
+
+		vk::ShaderModule computeShader = vkUtilities::createModule("Shaders/cluster_cull_comp.spv", device, settings.debug);
+		if (!computeShader) {
+			std::cerr << "Failed to load the cluster cull shader \"Shaders/cluster_cull_comp.spv\"" << std::endl;
+			return false;
+		}
+
+		vk::PipelineShaderStageCreateInfo stageInfo;
+		stageInfo.flags = vk::PipelineShaderStageCreateFlags();
+		stageInfo.stage = vk::ShaderStageFlagBits::eCompute;
+		stageInfo.module = computeShader;
+		stageInfo.pName = "main";
+
+		vk::ComputePipelineCreateInfo pipelineInfo;
+		pipelineInfo.flags = vk::PipelineCreateFlags();
+		pipelineInfo.stage = stageInfo;
+		pipelineInfo.layout = pipelineLayout;
+		pipelineInfo.basePipelineHandle = nullptr;
+
+		try {
+			pipeline = (device.createComputePipeline(nullptr, pipelineInfo)).value;
+		}
+		catch (vk::SystemError err) {
+			std::cerr << "Encountered an error while trying to create the cluster cull pipeline: " << err.what() << std::endl;
+		}
+
+		device.destroyShaderModule(computeShader);
+		return static_cast<bool>(pipeline);
+	}
+
+	void ClusterCuller::createFrame(Frame& frame) {
+		BufferInput input;
+		input.device = device;
+		input.physicalDevice = settings.physicalDevice;
+		input.allocator = settings.allocator;
+		input.category = vkUtilities::MemoryCategory::FRAME;
+
+		// the cpu rewrites the draw list and resets the commands every frame, so both stay host visible
+		input.memoryProperties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+		input.size = sizeof(ClusterDraw) * settings.maxDraws;
+		input.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+		frame.drawBuffer = vkUtilities::createBuffer(input);
+		frame.drawWriteLocation = frame.drawBuffer.bufferMemory.data;
+
+		input.size = sizeof(vk::DrawIndexedIndirectCommand) * settings.maxDraws;
+		input.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer;
+		frame.indirectBuffer = vkUtilities::createBuffer(input);
+		frame.indirectWriteLocation = frame.indirectBuffer.bufferMemory.data;
+
+		input.memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+		input.size = sizeof(uint32_t) * settings.maxOutputIndices;
+		input.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndexBuffer;
+		frame.outputIndexBuffer = vkUtilities::createBuffer(input);
+
+		frame.descriptorSet = vkInit::allocateDescriptorSet(device, descriptorPool, descriptorSetLayout);
+
+		vk::DescriptorBufferInfo meshletInfo(settings.meshletBuffer.buffer, 0, settings.meshletBufferSize);
+		vk::DescriptorBufferInfo meshletVertexInfo(settings.meshletVertexBuffer.buffer, 0, settings.meshletVertexBufferSize);
+		vk::DescriptorBufferInfo meshletTriangleInfo(settings.meshletTriangleBuffer.buffer, 0, settings.meshletTriangleBufferSize);
+		vk::DescriptorBufferInfo drawInfo(frame.drawBuffer.buffer, 0, sizeof(ClusterDraw) * settings.maxDraws);
+		vk::DescriptorBufferInfo indirectInfo(frame.indirectBuffer.buffer, 0, sizeof(vk::DrawIndexedIndirectCommand) * settings.maxDraws);
+		vk::DescriptorBufferInfo outputInfo(frame.outputIndexBuffer.buffer, 0, sizeof(uint32_t) * settings.maxOutputIndices);
+
+		// model transforms belong to the swapchain frame and are written in prepareFrame
+		std::vector<vk::WriteDescriptorSet> writes = {
+			makeBufferWrite(frame.descriptorSet, MESHLETS, &meshletInfo),
+			makeBufferWrite(frame.descriptorSet, MESHLET_VERTICES, &meshletVertexInfo),
+			makeBufferWrite(frame.descriptorSet, MESHLET_TRIANGLES, &meshletTriangleInfo),
+			makeBufferWrite(frame.descriptorSet, DRAWS, &drawInfo),
+			makeBufferWrite(frame.descriptorSet, INDIRECT_COMMANDS, &indirectInfo),
+			makeBufferWrite(frame.descriptorSet, OUTPUT_INDICES, &outputInfo)
+		};
+		device.updateDescriptorSets(static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	}
+
+	void ClusterCuller::prepareFrame(uint32_t frameIndex, const std::vector<ClusterDraw>& draws, const std::vector<int32_t>& baseVertices, const CullingConstants& constants, vk::DescriptorBufferInfo modelTransforms) {
+		currentFrame = frameIndex;
+		currentConstants = constants;
+		Frame& frame = frames[frameIndex];
+
+		size_t drawCount = std::min(draws.size(), static_cast<size_t>(settings.maxDraws));
+		currentConstants.drawCount = static_cast<uint32_t>(drawCount);
+		memcpy(frame.drawWriteLocation, draws.data(), sizeof(ClusterDraw) * drawCount);
+
+		// every command starts empty, the shader adds each surviving cluster's indices
+		vk::DrawIndexedIndirectCommand* commands = static_cast<vk::DrawIndexedIndirectCommand*>(frame.indirectWriteLocation);
+		for (size_t i = 0; i < drawCount; i++) {
+			commands[i].indexCount = 0;
+			commands[i].instanceCount = 1;
+			commands[i].firstIndex = draws[i].firstIndex;
+			commands[i].vertexOffset = baseVertices[i];
+			commands[i].firstInstance = draws[i].instance;
+		}
+
+		std::vector<vk::WriteDescriptorSet> writes = { makeBufferWrite(frame.descriptorSet, MODEL_TRANSFORMS, &modelTransforms) };
+		vk::DescriptorBufferInfo meshletInfo(settings.meshletBuffer.buffer, 0, settings.meshletBufferSize);
+		vk::DescriptorBufferInfo meshletVertexInfo(settings.meshletVertexBuffer.buffer, 0, settings.meshletVertexBufferSize);
+		vk::DescriptorBufferInfo meshletTriangleInfo(settings.meshletTriangleBuffer.buffer, 0, settings.meshletTriangleBufferSize);
+		if (frame.meshletsMoved) {
+			writes.push_back(makeBufferWrite(frame.descriptorSet, MESHLETS, &meshletInfo));
+			writes.push_back(makeBufferWrite(frame.descriptorSet, MESHLET_VERTICES, &meshletVertexInfo));
+			writes.push_back(makeBufferWrite(frame.descriptorSet, MESHLET_TRIANGLES, &meshletTriangleInfo));
+			frame.meshletsMoved = false;
+		}
+		device.updateDescriptorSets(static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	}
+
+	void ClusterCuller::setMeshletBuffers(const Buffer& meshletBuffer, const Buffer& meshletVertexBuffer, const Buffer& meshletTriangleBuffer) {
+		settings.meshletBuffer = meshletBuffer;
+		settings.meshletVertexBuffer = meshletVertexBuffer;
+		settings.meshletTriangleBuffer = meshletTriangleBuffer;
+
+		for (Frame& frame : frames) {
+			frame.meshletsMoved = true;
+		}
+	}
+
+	void ClusterCuller::record(vk::CommandBuffer commandBuffer) {
+		if (currentConstants.drawCount == 0) {
+			return;
+		}
+
+		Frame& frame = frames[currentFrame];
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, frame.descriptorSet, nullptr);
+		commandBuffer.pushConstants(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(CullingConstants), &currentConstants);
+
+		// one row of groups per draw, wide enough for the mesh with the most meshlets
+		uint32_t groupsPerDraw = (settings.maxMeshletsPerDraw + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE;
+		commandBuffer.dispatch(groupsPerDraw, currentConstants.drawCount, 1);
+
+		vk::MemoryBarrier barrier;
+		barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+		barrier.dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eIndexRead;
+		commandBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eComputeShader,
+			vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexInput,
+			vk::DependencyFlags(), 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	vk::Buffer ClusterCuller::getIndirectBuffer() const {
+		return frames[currentFrame].indirectBuffer.buffer;
+	}
+
+	vk::Buffer ClusterCuller::getIndexBuffer() const {
+		return frames[currentFrame].outputIndexBuffer.buffer;
+	}
+
+	void ClusterCuller::destroy() {
+		for (Frame& frame : frames) {
+			vkUtilities::destroyBuffer(device, frame.drawBuffer);
+			vkUtilities::destroyBuffer(device, frame.indirectBuffer);
+			vkUtilities::destroyBuffer(device, frame.outputIndexBuffer);
+		}
+		frames.clear();
+
+		device.destroyPipeline(pipeline);
+		device.destroyPipelineLayout(pipelineLayout);
+		device.destroyDescriptorPool(descriptorPool);
+		device.destroyDescriptorSetLayout(descriptorSetLayout);
+	}
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include "../config.h"
+#include "../utilities/Memory.h"
+#include "../pipeline/Descriptors.h"
+#include "Meshlet.h"
+
+/*
+	Per frame compute pass that culls meshlets against the view frustum and
+	their normal cones, then writes the triangles of the survivors into a
+	compacted index buffer. Every mesh instance gets one indirect draw whose
+	index count the shader grows as clusters pass, so the graphics passes only
+	ever see visible triangles.
+*/
+namespace vkMesh {
+	// std430 layout of one entry in the draw buffer: one instance of one mesh
+	struct ClusterDraw {
+		uint32_t firstMeshlet;
+		uint32_t meshletCount;
+		// index into the frame's model transforms
+		uint32_t instance;
+		// where this draw's surviving indices start in the output index buffer
+		uint32_t firstIndex;
+	};
+
+	// push constants for the cull shader, exactly the 128 bytes every device guarantees
+	struct CullingConstants {
+		// world space, xyz inward normal and w distance
+		glm::vec4 frustumPlanes[6];
+		glm::vec4 cameraPosition;
+		uint32_t drawCount;
+		uint32_t padding[3];
+	};
+
+	struct ClusterCullerInput {
+		vk::Device device;
+		vk::PhysicalDevice physicalDevice;
+		// where each frame's draw, command and index buffers are placed
+		vkUtilities::DeviceAllocator* allocator = nullptr;
+		uint32_t frameCount;
+		// most draws and surviving indices any one frame can hold
+		uint32_t maxDraws;
+		vk::DeviceSize maxOutputIndices;
+		// the largest meshlet count of any culled mesh, sizes the dispatch
+		uint32_t maxMeshletsPerDraw;
+		Buffer meshletBuffer;
+		vk::DeviceSize meshletBufferSize;
+		Buffer meshletVertexBuffer;
+		vk::DeviceSize meshletVertexBufferSize;
+		Buffer meshletTriangleBuffer;
+		vk::DeviceSize meshletTriangleBufferSize;
+		bool debug = false;
+	};
+
+	// planes from a view projection matrix, for a 0 to 1 depth range
+	void extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]);
+
+	class ClusterCuller {
+	public:
+		// false if the cull pipeline couldn't be made, destroy still has to be called
+		bool create(const ClusterCullerInput& input);
+		void destroy();
+
+		// fills the frame's draw list and resets its indirect commands; base vertices index the draws
+		void prepareFrame(uint32_t frameIndex, const std::vector<ClusterDraw>& draws, const std::vector<int32_t>& baseVertices, const CullingConstants& constants, vk::DescriptorBufferInfo modelTransforms);
+
+		// records the dispatch and the barrier that makes its output visible to indirect draws, outside any render pass
+		void record(vk::CommandBuffer commandBuffer);
+
+		// points each frame at meshlet buffers that have moved the next time it's prepared, frames in flight keep the old ones
+		void setMeshletBuffers(const Buffer& meshletBuffer, const Buffer& meshletVertexBuffer, const Buffer& meshletTriangleBuffer);
+
+		// buffers of the frame last prepared
+		vk::Buffer getIndirectBuffer() const;
+		vk::Buffer getIndexBuffer() const;
+
+	private:
+		struct Frame {
+			Buffer drawBuffer;
+			void* drawWriteLocation = nullptr;
+			Buffer indirectBuffer;
+			void* indirectWriteLocation = nullptr;
+			Buffer outputIndexBuffer;
+			vk::DescriptorSet descriptorSet;
+			// the meshlet buffers moved since the set was last written
+			bool meshletsMoved = false;
+		};
+
+		vk::Device device;
+		vk::DescriptorSetLayout descriptorSetLayout;
+		vk::DescriptorPool descriptorPool;
+		vk::PipelineLayout pipelineLayout;
+		vk::Pipeline pipeline;
+
+		ClusterCullerInput settings;
+		std::vector<Frame> frames;
+		uint32_t currentFrame = 0;
+		CullingConstants currentConstants{};
+
+		bool createPipeline();
+		void createFrame(Frame& frame);
+	};
+}
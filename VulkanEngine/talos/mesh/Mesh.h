@@ -1,71 +1,197 @@
 #pragma once
 #include "../config.h"
+#include <array>
+#include <cstddef>
 
-// Refactor so stride doesn't have to be hardcoded ffs
 namespace vkMesh {
-	static int NUM_ATTRIBUTES = 7;
+	// std430 layout of one entry in the material storage buffer, ks.w holds the specular exponent
+	struct GpuMaterial {
+		glm::vec4 ka;
+		glm::vec4 kd;
+		glm::vec4 ks;
+	};
 
-	// Outputs vertex input for position and color
-	inline vk::VertexInputBindingDescription getPosColorBindingDescription() {
+	// interleaved vertex used by the forward and prepass pipelines
+	struct Vertex {
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec2 texCoord;
+		// index into the material buffer
+		uint32_t materialIndex;
+	};
 
-		vk::VertexInputBindingDescription bindingDesc;
-		bindingDesc.binding = 0;
-		bindingDesc.stride = sizeof(float) * 18;
-		bindingDesc.inputRate = vk::VertexInputRate::eVertex;
+	// tightly packed stream for passes that only need depth
+	struct PositionVertex {
+		glm::vec3 position;
+	};
 
-		return bindingDesc;
+	// packed vertex for meshes whose asset file asks for "vertexformat compact", 20 bytes against Vertex's 36
+	struct QuantizedPosition {
+		// unorm16 across the mesh bounds, w only pads the attribute out to a format every device can fetch
+		uint16_t x, y, z, w;
+	};
+
+	struct OctahedralNormal {
+		// unit normal folded onto an octahedron, as snorm16
+		int16_t x, y;
+	};
+
+	struct HalfTexCoord {
+		uint16_t u, v;
+	};
+
+	struct CompactVertex {
+		QuantizedPosition position;
+		OctahedralNormal normal;
+		HalfTexCoord texCoord;
+		uint32_t materialIndex;
+	};
+
+	// how a mesh's vertices are stored on the gpu
+	enum class VertexFormat {
+		FLOAT,
+		COMPACT
+	};
+
+	// turns a compact mesh's quantized positions back into model space, pushed per draw
+	struct MeshBounds {
+		glm::vec4 minimum;
+		glm::vec4 extent;
+	};
+
+	// one level of detail of a mesh: a run of indices into the same vertices as the full mesh
+	struct MeshLod {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		// how far, in model units, the simplified surface strays from the full one
+		float error;
+	};
+
+	// which vertex buffer a pass binds
+	enum class VertexStream {
+		FULL,
+		POSITION_ONLY
+	};
+
+	static_assert(sizeof(Vertex) == 36, "Vertex must stay tightly packed to match the shader inputs");
+	static_assert(sizeof(PositionVertex) == 12, "PositionVertex must stay tightly packed");
+	static_assert(sizeof(CompactVertex) == 20, "CompactVertex must stay tightly packed to match the shader inputs");
+
+	/*
+		Maps a vertex member's C++ type to the format the input assembler reads it as.
+		Add a specialization here before using a new member type in a vertex struct.
+	*/
+	template <typename T>
+	struct VertexAttributeFormat;
+
+	template <>
+	struct VertexAttributeFormat<float> {
+		static constexpr vk::Format format = vk::Format::eR32Sfloat;
+	};
+
+	template <>
+	struct VertexAttributeFormat<glm::vec2> {
+		static constexpr vk::Format format = vk::Format::eR32G32Sfloat;
+	};
+
+	template <>
+	struct VertexAttributeFormat<glm::vec3> {
+		static constexpr vk::Format format = vk::Format::eR32G32B32Sfloat;
+	};
+
+	template <>
+	struct VertexAttributeFormat<glm::vec4> {
+		static constexpr vk::Format format = vk::Format::eR32G32B32A32Sfloat;
+	};
+
+	template <>
+	struct VertexAttributeFormat<uint32_t> {
+		static constexpr vk::Format format = vk::Format::eR32Uint;
+	};
+
+	template <>
+	struct VertexAttributeFormat<QuantizedPosition> {
+		static constexpr vk::Format format = vk::Format::eR16G16B16A16Unorm;
+	};
+
+	template <>
+	struct VertexAttributeFormat<OctahedralNormal> {
+		static constexpr vk::Format format = vk::Format::eR16G16Snorm;
+	};
+
+	template <>
+	struct VertexAttributeFormat<HalfTexCoord> {
+		static constexpr vk::Format format = vk::Format::eR16G16Sfloat;
+	};
+
+	template <typename Member>
+	inline vk::VertexInputAttributeDescription makeVertexAttribute(uint32_t location, uint32_t binding, uint32_t offset) {
+		vk::VertexInputAttributeDescription attribute;
+		attribute.binding = binding;
+		attribute.location = location;
+		attribute.format = VertexAttributeFormat<Member>::format;
+		attribute.offset = offset;
+
+		return attribute;
 	}
 
-	inline std::vector<vk::VertexInputAttributeDescription> getPosColorAttributeDescriptions() {
-		std::vector<vk::VertexInputAttributeDescription> attributes;
-		vk::VertexInputAttributeDescription temp;
+	// format and offset both come from the member itself, so the struct is the only place the layout is written down
+	#define TALOS_VERTEX_ATTRIBUTE(VertexType, member, location, binding) \
+		vkMesh::makeVertexAttribute<decltype(VertexType::member)>(location, binding, static_cast<uint32_t>(offsetof(VertexType, member)))
+
+	/*
+		Lists a vertex struct's shader inputs. Each vertex type specializes this with
+		attributes(binding) returning one entry per member, in shader location order.
+	*/
+	template <typename V>
+	struct VertexLayout;
+
+	template <>
+	struct VertexLayout<Vertex> {
+		static std::array<vk::VertexInputAttributeDescription, 4> attributes(uint32_t binding) {
+			return { {
+				TALOS_VERTEX_ATTRIBUTE(Vertex, position, 0, binding),
+				TALOS_VERTEX_ATTRIBUTE(Vertex, normal, 1, binding),
+				TALOS_VERTEX_ATTRIBUTE(Vertex, texCoord, 2, binding),
+				TALOS_VERTEX_ATTRIBUTE(Vertex, materialIndex, 3, binding)
+			} };
+		}
+	};
+
+	template <>
+	struct VertexLayout<PositionVertex> {
+		static std::array<vk::VertexInputAttributeDescription, 1> attributes(uint32_t binding) {
+			return { {
+				TALOS_VERTEX_ATTRIBUTE(PositionVertex, position, 0, binding)
+			} };
+		}
+	};
 
-		for (int i = 0; i < NUM_ATTRIBUTES; i++) {
-			attributes.push_back(temp);
+	template <>
+	struct VertexLayout<CompactVertex> {
+		static std::array<vk::VertexInputAttributeDescription, 4> attributes(uint32_t binding) {
+			return { {
+				TALOS_VERTEX_ATTRIBUTE(CompactVertex, position, 0, binding),
+				TALOS_VERTEX_ATTRIBUTE(CompactVertex, normal, 1, binding),
+				TALOS_VERTEX_ATTRIBUTE(CompactVertex, texCoord, 2, binding),
+				TALOS_VERTEX_ATTRIBUTE(CompactVertex, materialIndex, 3, binding)
+			} };
 		}
+	};
+
+	template <typename V>
+	inline vk::VertexInputBindingDescription getBindingDescription(uint32_t binding = 0) {
+		vk::VertexInputBindingDescription bindingDesc;
+		bindingDesc.binding = binding;
+		bindingDesc.stride = sizeof(V);
+		bindingDesc.inputRate = vk::VertexInputRate::eVertex;
+
+		return bindingDesc;
+	}
 
-		// position
-		attributes[0].binding = 0;
-		attributes[0].location = 0;
-		attributes[0].format = vk::Format::eR32G32B32Sfloat;
-		attributes[0].offset = 0;
-
-		// Ka
-		attributes[1].binding = 0;
-		attributes[1].location = 1;
-		attributes[1].format = vk::Format::eR32G32B32Sfloat;
-		attributes[1].offset = 3 * sizeof(float);
-
-		// Kd
-		attributes[2].binding = 0;
-		attributes[2].location = 2;
-		attributes[2].format = vk::Format::eR32G32B32Sfloat;
-		attributes[2].offset = 6 * sizeof(float);
-
-		// Ks
-		attributes[3].binding = 0;
-		attributes[3].location = 3;
-		attributes[3].format = vk::Format::eR32G32B32Sfloat;
-		attributes[3].offset = 9 * sizeof(float);
-
-		// e
-		attributes[4].binding = 0;
-		attributes[4].location = 4;
-		attributes[4].format = vk::Format::eR32Sfloat;
-		attributes[4].offset = 12 * sizeof(float);
-
-		// UV Coordinates
-		attributes[5].binding = 0;
-		attributes[5].location = 5;
-		attributes[5].format = vk::Format::eR32G32Sfloat;
-		attributes[5].offset = 13 * sizeof(float);
-
-		// Normal Coordinates
-		attributes[6].binding = 0;
-		attributes[6].location = 6;
-		attributes[6].format = vk::Format::eR32G32B32Sfloat;
-		attributes[6].offset = 15 * sizeof(float);;
-
-		return attributes;
+	template <typename V>
+	inline std::vector<vk::VertexInputAttributeDescription> getAttributeDescriptions(uint32_t binding = 0) {
+		auto attributes = VertexLayout<V>::attributes(binding);
+		return std::vector<vk::VertexInputAttributeDescription>(attributes.begin(), attributes.end());
 	}
-};
\ No newline at end of file
+};
@@ -0,0 +1,170 @@
+#include "MeshCache.h"
+#include "../utilities/CacheFile.h"
+#include "../job/Job.h"
+
+namespace vkMesh {
+	uint64_t hashMeshSource(const vkUtilities::MappedFile& objFile, const vkUtilities::MappedFile& mtlFile, const glm::mat4& preTransform, bool optimizeOverdraw) {
+		using vkUtilities::hashBytes;
+		uint64_t hash = vkUtilities::FNV_OFFSET_BASIS;
+
+		// sizes go in first so bytes can't shift between the two files without changing the key
+		uint64_t sizes[2] = { objFile.getSize(), mtlFile.getSize() };
+		hash = hashBytes(hash, sizes, sizeof(sizes));
+		hash = hashBytes(hash, objFile.getData(), objFile.getSize());
+		hash = hashBytes(hash, mtlFile.getData(), mtlFile.getSize());
+
+		for (int column = 0; column < 4; column++) {
+			for (int row = 0; row < 4; row++) {
+				float value = preTransform[column][row];
+				hash = hashBytes(hash, &value, sizeof(float));
+			}
+		}
+
+		uint8_t options = optimizeOverdraw ? 1 : 0;
+		hash = hashBytes(hash, &options, sizeof(options));
+
+		return hash;
+	}
+
+	std::string getMeshCachePath(uint64_t sourceHash, const std::string& directory) {
+		return vkUtilities::makeCachePath(directory, sourceHash, ".mesh");
+	}
+
+	bool MeshCache::load(const std::string& filepath, uint64_t sourceHash, vkJob::JobQueue* queue) {
+		header.reset();
+		payload = nullptr;
+		decompressed.reset();
+		if (!file.open(filepath)) {
+			return false;
+		}
+
+		if (file.getSize() < sizeof(MeshCacheHeader)) {
+			file.close();
+			return false;
+		}
+
+		const MeshCacheHeader* candidate = reinterpret_cast<const MeshCacheHeader*>(file.getData());
+		size_t payloadSize = candidate->materialCount * sizeof(GpuMaterial)
+			+ candidate->vertexCount * sizeof(Vertex)
+			+ candidate->indexCount * sizeof(uint32_t)
+			+ candidate->lodCount * sizeof(MeshLod)
+			+ candidate->lodIndexCount * sizeof(uint32_t);
+
+		if (candidate->magic != MESH_CACHE_MAGIC
+			|| candidate->version != MESH_CACHE_VERSION
+			|| candidate->sourceHash != sourceHash) {
+			file.close();
+			return false;
+		}
+
+		const char* stored = file.getData() + sizeof(MeshCacheHeader);
+		size_t storedSize = file.getSize() - sizeof(MeshCacheHeader);
+		if (candidate->compression == static_cast<uint32_t>(vkUtilities::BlobCompression::NONE) && storedSize == payloadSize) {
+			payload = stored;
+		}
+		else if (candidate->compression == static_cast<uint32_t>(vkUtilities::BlobCompression::LZ4_BLOCKS)) {
+			const vkUtilities::BlockStreamHeader* stream = vkUtilities::readBlockStream(stored, storedSize);
+			if (stream && stream->rawSize == payloadSize) {
+				decompressed = std::make_unique<char[]>(payloadSize);
+				if (vkJob::decompressBlocks(stored, storedSize, decompressed.get(), queue)) {
+					payload = decompressed.get();
+				}
+			}
+		}
+
+		if (!payload) {
+			decompressed.reset();
+			file.close();
+			return false;
+		}
+
+		header = *candidate;
+
+		// nothing reads the compressed copy again
+		if (decompressed) {
+			file.close();
+		}
+
+		return true;
+	}
+
+	bool MeshCache::write(const std::string& filepath, uint64_t sourceHash, const std::vector<GpuMaterial>& materials, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const std::vector<MeshLod>& lods, const std::vector<uint32_t>& lodIndices, bool compress) {
+		MeshCacheHeader header;
+		header.magic = MESH_CACHE_MAGIC;
+		header.version = MESH_CACHE_VERSION;
+		header.sourceHash = sourceHash;
+		header.materialCount = materials.size();
+		header.vertexCount = vertices.size();
+		header.indexCount = indices.size();
+		header.lodCount = lods.size();
+		header.lodIndexCount = lodIndices.size();
+		header.compression = static_cast<uint32_t>(compress ? vkUtilities::BlobCompression::LZ4_BLOCKS : vkUtilities::BlobCompression::NONE);
+		header.padding = 0;
+
+		std::vector<vkUtilities::FilePiece> pieces = {
+			{ materials.data(), materials.size() * sizeof(GpuMaterial) },
+			{ vertices.data(), vertices.size() * sizeof(Vertex) },
+			{ indices.data(), indices.size() * sizeof(uint32_t) },
+			{ lods.data(), lods.size() * sizeof(MeshLod) },
+			{ lodIndices.data(), lodIndices.size() * sizeof(uint32_t) }
+		};
+
+		if (!compress) {
+			pieces.insert(pieces.begin(), vkUtilities::FilePiece{ &header, sizeof(MeshCacheHeader) });
+			return vkUtilities::writeCacheFile(filepath, pieces);
+		}
+
+		// blocks are cut from the payload as one run of bytes
+		std::vector<char> raw;
+		for (const vkUtilities::FilePiece& piece : pieces) {
+			raw.insert(raw.end(), static_cast<const char*>(piece.data), static_cast<const char*>(piece.data) + piece.size);
+		}
+		std::vector<char> stream;
+		vkUtilities::compressBlocks(raw.data(), raw.size(), stream);
+
+		return vkUtilities::writeCacheFile(filepath, {
+			{ &header, sizeof(MeshCacheHeader) },
+			{ stream.data(), stream.size() }
+		});
+	}
+
+	const GpuMaterial* MeshCache::getMaterialData() const {
+		return reinterpret_cast<const GpuMaterial*>(payload);
+	}
+
+	size_t MeshCache::getMaterialCount() const {
+		return header ? static_cast<size_t>(header->materialCount) : 0;
+	}
+
+	const Vertex* MeshCache::getVertexData() const {
+		return reinterpret_cast<const Vertex*>(payload + getMaterialCount() * sizeof(GpuMaterial));
+	}
+
+	size_t MeshCache::getVertexCount() const {
+		return header ? static_cast<size_t>(header->vertexCount) : 0;
+	}
+
+	const uint32_t* MeshCache::getIndexData() const {
+		return reinterpret_cast<const uint32_t*>(reinterpret_cast<const char*>(getVertexData()) + getVertexCount() * sizeof(Vertex));
+	}
+
+	size_t MeshCache::getIndexCount() const {
+		return header ? static_cast<size_t>(header->indexCount) : 0;
+	}
+
+	const MeshLod* MeshCache::getLodData() const {
+		return reinterpret_cast<const MeshLod*>(getIndexData() + getIndexCount());
+	}
+
+	size_t MeshCache::getLodCount() const {
+		return header ? static_cast<size_t>(header->lodCount) : 0;
+	}
+
+	const uint32_t* MeshCache::getLodIndexData() const {
+		return reinterpret_cast<const uint32_t*>(getLodData() + getLodCount());
+	}
+
+	size_t MeshCache::getLodIndexCount() const {
+		return header ? static_cast<size_t>(header->lodIndexCount) : 0;
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "../config.h"
+#include "../utilities/MappedFile.h"
+#include "../utilities/BlockCompression.h"
+#include "Mesh.h"
+#include <memory>
+
+namespace vkJob {
+	class JobQueue;
+}
+
+/*
+	Cooked binary copy of a parsed obj/mtl pair. The file holds the material
+	table, the final interleaved vertex array, the index array and the coarser
+	levels of detail (their table, then their indices) back to back, so a cache hit is a single mapping that can be handed straight to the
+	vertex collection. Cooked copies compress that payload into blocks,
+	which are decompressed once on load.
+*/
+namespace vkMesh {
+	static const uint32_t MESH_CACHE_MAGIC = 0x4853454D; // "MESH"
+	static const uint32_t MESH_CACHE_VERSION = 7;
+	static const char* MESH_CACHE_DIRECTORY = "cache/meshes/";
+
+	struct MeshCacheHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t sourceHash;
+		uint64_t materialCount;
+		uint64_t vertexCount;
+		uint64_t indexCount;
+		uint64_t lodCount;
+		uint64_t lodIndexCount;
+		// a vkUtilities::BlobCompression
+		uint32_t compression;
+		uint32_t padding;
+	};
+
+	// content hash of everything that affects the cooked output
+	uint64_t hashMeshSource(const vkUtilities::MappedFile& objFile, const vkUtilities::MappedFile& mtlFile, const glm::mat4& preTransform, bool optimizeOverdraw);
+
+	std::string getMeshCachePath(uint64_t sourceHash, const std::string& directory = MESH_CACHE_DIRECTORY);
+
+	class MeshCache {
+	public:
+		// returns false if the file is missing, truncated or was cooked from different sources, compressed payloads decompress on the queue's workers if there is one
+		bool load(const std::string& filepath, uint64_t sourceHash, vkJob::JobQueue* queue = nullptr);
+
+		static bool write(const std::string& filepath, uint64_t sourceHash, const std::vector<GpuMaterial>& materials, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const std::vector<MeshLod>& lods, const std::vector<uint32_t>& lodIndices, bool compress = false);
+
+		const GpuMaterial* getMaterialData() const;
+		size_t getMaterialCount() const;
+		const Vertex* getVertexData() const;
+		size_t getVertexCount() const;
+		const uint32_t* getIndexData() const;
+		size_t getIndexCount() const;
+		const MeshLod* getLodData() const;
+		size_t getLodCount() const;
+		const uint32_t* getLodIndexData() const;
+		size_t getLodIndexCount() const;
+
+	private:
+		vkUtilities::MappedFile file;
+		// a copy, compressed files are let go once decompressed
+		std::optional<MeshCacheHeader> header;
+		// the mapping for stored payloads, the decompressed copy otherwise
+		const char* payload = nullptr;
+		std::unique_ptr<char[]> decompressed;
+	};
+}
@@ -0,0 +1,299 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace vkMesh {
+	namespace {
+		// size of the lru cache modelled while scoring, bigger than the real one so the order stays good across gpus
+		const int SCORING_CACHE_SIZE = 32;
+		const float LAST_TRIANGLE_SCORE = 0.75f;
+		const float CACHE_DECAY_POWER = 1.5f;
+		const float VALENCE_BOOST_SCALE = 2.0f;
+		const float VALENCE_BOOST_POWER = 0.5f;
+
+		float scoreVertex(int cachePosition, uint32_t remainingValence) {
+			if (remainingValence == 0) {
+				// nothing left to draw with it
+				return -1.0f;
+			}
+
+			float score = 0.0f;
+			if (cachePosition >= 0) {
+				if (cachePosition < 3) {
+					// used by the last triangle, fixed score so strips don't get unfairly favoured
+					score = LAST_TRIANGLE_SCORE;
+				}
+				else {
+					float scaler = 1.0f / (SCORING_CACHE_SIZE - 3);
+					score = std::pow(1.0f - (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+				}
+			}
+
+			// finish off vertices with few triangles left so they don't linger
+			score += VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remainingValence), -VALENCE_BOOST_POWER);
+			return score;
+		}
+
+		// per triangle fifo misses, used to find where the cache restarts
+		std::vector<uint32_t> simulateMisses(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize) {
+			std::vector<uint32_t> timestamps(vertexCount, 0);
+			std::vector<uint32_t> misses(indexCount / 3, 0);
+			uint32_t time = cacheSize + 1;
+
+			for (size_t i = 0; i < indexCount; i++) {
+				uint32_t index = indices[i];
+				if (time - timestamps[index] > cacheSize) {
+					timestamps[index] = time++;
+					misses[i / 3]++;
+				}
+			}
+
+			return misses;
+		}
+	}
+
+	float computeAcmr(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize) {
+		size_t triangleCount = indexCount / 3;
+		if (triangleCount == 0) {
+			return 0.0f;
+		}
+
+		std::vector<uint32_t> misses = simulateMisses(indices, indexCount, vertexCount, cacheSize);
+		size_t total = std::accumulate(misses.begin(), misses.end(), size_t(0));
+		return static_cast<float>(total) / static_cast<float>(triangleCount);
+	}
+
+	void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount) {
+		size_t triangleCount = indexCount / 3;
+		if (triangleCount == 0) {
+			return;
+		}
+
+		// vertex to triangle adjacency, in one flat array; each vertex's live triangles sit at the front of its range
+		std::vector<uint32_t> valence(vertexCount, 0);
+		for (size_t i = 0; i < indexCount; i++) {
+			valence[indices[i]]++;
+		}
+
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+		for (size_t vertex = 0; vertex < vertexCount; vertex++) {
+			adjacencyOffsets[vertex + 1] = adjacencyOffsets[vertex] + valence[vertex];
+		}
+
+		std::vector<uint32_t> adjacency(indexCount);
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < indexCount; i++) {
+			adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		std::vector<int> cachePositions(vertexCount, -1);
+		std::vector<float> vertexScores(vertexCount);
+		for (size_t vertex = 0; vertex < vertexCount; vertex++) {
+			vertexScores[vertex] = scoreVertex(-1, valence[vertex]);
+		}
+
+		std::vector<bool> emitted(triangleCount, false);
+		int bestTriangle = 0;
+		float bestStartScore = -1.0f;
+		for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+			const uint32_t* corners = indices + triangle * 3;
+			float score = vertexScores[corners[0]] + vertexScores[corners[1]] + vertexScores[corners[2]];
+			if (score > bestStartScore) {
+				bestStartScore = score;
+				bestTriangle = static_cast<int>(triangle);
+			}
+		}
+
+		std::vector<uint32_t> output;
+		output.reserve(indexCount);
+		std::vector<uint32_t> cache, nextCache;
+		cache.reserve(SCORING_CACHE_SIZE + 3);
+		nextCache.reserve(SCORING_CACHE_SIZE + 3);
+		size_t scanCursor = 0;
+
+		while (output.size() < indexCount) {
+			if (bestTriangle < 0) {
+				// dead end, nothing in the cache touches an undrawn triangle, so restart from the next one in file order
+				while (emitted[scanCursor]) {
+					scanCursor++;
+				}
+				bestTriangle = static_cast<int>(scanCursor);
+			}
+
+			const uint32_t* corners = indices + static_cast<size_t>(bestTriangle) * 3;
+			emitted[bestTriangle] = true;
+			output.insert(output.end(), corners, corners + 3);
+
+			nextCache.assign(corners, corners + 3);
+			for (int corner = 0; corner < 3; corner++) {
+				uint32_t vertex = corners[corner];
+
+				// swap the triangle out of the vertex's live range
+				uint32_t* begin = adjacency.data() + adjacencyOffsets[vertex];
+				uint32_t* end = begin + valence[vertex];
+				uint32_t* found = std::find(begin, end, static_cast<uint32_t>(bestTriangle));
+				std::swap(*found, *(end - 1));
+				valence[vertex]--;
+			}
+
+			for (uint32_t vertex : cache) {
+				if (vertex != corners[0] && vertex != corners[1] && vertex != corners[2]) {
+					nextCache.push_back(vertex);
+				}
+			}
+
+			// rescore everything that moved, including the vertices that just fell out of the cache
+			for (size_t i = 0; i < nextCache.size(); i++) {
+				uint32_t vertex = nextCache[i];
+				cachePositions[vertex] = i < SCORING_CACHE_SIZE ? static_cast<int>(i) : -1;
+				vertexScores[vertex] = scoreVertex(cachePositions[vertex], valence[vertex]);
+			}
+
+			bestTriangle = -1;
+			float bestScore = -1.0f;
+			for (uint32_t vertex : nextCache) {
+				uint32_t* begin = adjacency.data() + adjacencyOffsets[vertex];
+				for (uint32_t* triangle = begin; triangle < begin + valence[vertex]; triangle++) {
+					const uint32_t* triangleCorners = indices + static_cast<size_t>(*triangle) * 3;
+					float score = vertexScores[triangleCorners[0]] + vertexScores[triangleCorners[1]] + vertexScores[triangleCorners[2]];
+					if (score > bestScore) {
+						bestScore = score;
+						bestTriangle = static_cast<int>(*triangle);
+					}
+				}
+			}
+
+			if (nextCache.size() > SCORING_CACHE_SIZE) {
+				nextCache.resize(SCORING_CACHE_SIZE);
+			}
+			std::swap(cache, nextCache);
+		}
+
+		std::copy(output.begin(), output.end(), indices);
+	}
+
+	void optimizeOverdraw(uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, float threshold) {
+		size_t triangleCount = indexCount / 3;
+		if (triangleCount == 0) {
+			return;
+		}
+
+		// hard boundaries are where every corner of a triangle missed, the cache has restarted there anyway
+		std::vector<uint32_t> misses = simulateMisses(indices, indexCount, vertexCount, ACMR_CACHE_SIZE);
+		std::vector<size_t> hardBoundaries;
+		for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+			if (triangle == 0 || misses[triangle] == 3) {
+				hardBoundaries.push_back(triangle);
+			}
+		}
+		hardBoundaries.push_back(triangleCount);
+
+		// soft boundaries split a hard cluster further wherever doing so keeps its acmr within the threshold
+		std::vector<size_t> clusterStarts;
+		std::vector<uint32_t> timestamps(vertexCount, 0);
+		uint32_t time = ACMR_CACHE_SIZE + 1;
+		for (size_t cluster = 0; cluster + 1 < hardBoundaries.size(); cluster++) {
+			size_t start = hardBoundaries[cluster];
+			size_t end = hardBoundaries[cluster + 1];
+
+			size_t clusterMisses = 0;
+			for (size_t triangle = start; triangle < end; triangle++) {
+				clusterMisses += misses[triangle];
+			}
+			float clusterAcmr = static_cast<float>(clusterMisses) / static_cast<float>(end - start);
+
+			clusterStarts.push_back(start);
+			time += ACMR_CACHE_SIZE + 1;
+			size_t softStart = start;
+			size_t softMisses = 0;
+			for (size_t triangle = start; triangle < end; triangle++) {
+				for (int corner = 0; corner < 3; corner++) {
+					uint32_t index = indices[triangle * 3 + corner];
+					if (time - timestamps[index] > ACMR_CACHE_SIZE) {
+						timestamps[index] = time++;
+						softMisses++;
+					}
+				}
+
+				size_t softTriangles = triangle + 1 - softStart;
+				if (triangle + 1 < end && static_cast<float>(softMisses) / softTriangles <= clusterAcmr * threshold) {
+					clusterStarts.push_back(triangle + 1);
+					softStart = triangle + 1;
+					softMisses = 0;
+					// starting a cluster means starting with a cold cache
+					time += ACMR_CACHE_SIZE + 1;
+				}
+			}
+		}
+		clusterStarts.push_back(triangleCount);
+
+		size_t clusterCount = clusterStarts.size() - 1;
+		std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3(0.0f));
+		std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0.0f));
+		glm::vec3 meshCentroid = glm::vec3(0.0f);
+		float meshArea = 0.0f;
+
+		for (size_t cluster = 0; cluster < clusterCount; cluster++) {
+			float clusterArea = 0.0f;
+			for (size_t triangle = clusterStarts[cluster]; triangle < clusterStarts[cluster + 1]; triangle++) {
+				glm::vec3 a = vertices[indices[triangle * 3 + 0]].position;
+				glm::vec3 b = vertices[indices[triangle * 3 + 1]].position;
+				glm::vec3 c = vertices[indices[triangle * 3 + 2]].position;
+
+				// cross product length is twice the area, which cancels out in the weighting
+				glm::vec3 normal = glm::cross(b - a, c - a);
+				float area = glm::length(normal);
+				glm::vec3 centroid = (a + b + c) / 3.0f;
+
+				clusterCentroids[cluster] += centroid * area;
+				clusterNormals[cluster] += normal;
+				clusterArea += area;
+			}
+
+			meshCentroid += clusterCentroids[cluster];
+			meshArea += clusterArea;
+			clusterCentroids[cluster] = clusterArea > 0.0f ? clusterCentroids[cluster] / clusterArea : glm::vec3(0.0f);
+		}
+		meshCentroid = meshArea > 0.0f ? meshCentroid / meshArea : glm::vec3(0.0f);
+
+		// clusters facing away from the middle of the mesh are the likely occluders, so they draw first
+		std::vector<float> sortKeys(clusterCount);
+		for (size_t cluster = 0; cluster < clusterCount; cluster++) {
+			float normalLength = glm::length(clusterNormals[cluster]);
+			glm::vec3 normal = normalLength > 0.0f ? clusterNormals[cluster] / normalLength : glm::vec3(0.0f);
+			sortKeys[cluster] = glm::dot(clusterCentroids[cluster] - meshCentroid, normal);
+		}
+
+		std::vector<size_t> order(clusterCount);
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&sortKeys](size_t a, size_t b) {
+			return sortKeys[a] > sortKeys[b];
+		});
+
+		std::vector<uint32_t> output;
+		output.reserve(indexCount);
+		for (size_t cluster : order) {
+			output.insert(output.end(), indices + clusterStarts[cluster] * 3, indices + clusterStarts[cluster + 1] * 3);
+		}
+
+		std::copy(output.begin(), output.end(), indices);
+	}
+
+	void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+		const uint32_t UNUSED = 0xFFFFFFFF;
+		std::vector<uint32_t> remap(vertices.size(), UNUSED);
+		std::vector<Vertex> reordered;
+		reordered.reserve(vertices.size());
+
+		for (uint32_t& index : indices) {
+			if (remap[index] == UNUSED) {
+				remap[index] = static_cast<uint32_t>(reordered.size());
+				reordered.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+
+		vertices = std::move(reordered);
+	}
+}
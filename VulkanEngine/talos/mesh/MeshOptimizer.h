@@ -0,0 +1,26 @@
+#pragma once
+#include "../config.h"
+#include "Mesh.h"
+
+/*
+	Index and vertex reordering run once when a mesh is cooked. Triangles are
+	reordered for the post transform vertex cache (Forsyth's greedy scoring),
+	optionally regrouped so outward facing clusters draw first to cut overdraw
+	(Tipsify style, clusters are only split where the cache would miss anyway),
+	and vertices are then renumbered in first use order for fetch locality.
+*/
+namespace vkMesh {
+	// fifo size used for acmr reports, close to what most current gpus behave like
+	static const uint32_t ACMR_CACHE_SIZE = 16;
+
+	// average cache miss ratio, transformed vertices per triangle; 0.5 is ideal and 3 is the worst case
+	float computeAcmr(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = ACMR_CACHE_SIZE);
+
+	void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+	// expects vertex cache ordered indices; threshold is how much worse than its cluster's acmr a split may make things
+	void optimizeOverdraw(uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, float threshold = 1.05f);
+
+	// renumbers vertices in the order the indices first touch them, dropping any that are never drawn
+	void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+}
@@ -0,0 +1,399 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace vkMesh {
+	namespace {
+		// a level has to drop at least this share of the previous one's triangles to be worth keeping
+		const float MIN_LOD_REDUCTION = 0.15f;
+
+		// collapses that turn a neighbouring triangle further than this (cosine) are refused
+		const float FLIP_COSINE_LIMIT = 0.01f;
+
+		// how strongly seam edges hold their line, relative to the surface planes around them
+		const double SEAM_WEIGHT = 10.0;
+
+		const uint32_t NO_VERTEX = 0xFFFFFFFF;
+
+		// symmetric 4x4 matrix summing squared distances to a set of planes, weighted by triangle area
+		struct Quadric {
+			double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+			double a11 = 0, a12 = 0, a13 = 0;
+			double a22 = 0, a23 = 0;
+			double a33 = 0;
+			double weight = 0;
+
+			void addPlane(const glm::dvec3& normal, double distance, double planeWeight) {
+				a00 += planeWeight * normal.x * normal.x;
+				a01 += planeWeight * normal.x * normal.y;
+				a02 += planeWeight * normal.x * normal.z;
+				a03 += planeWeight * normal.x * distance;
+				a11 += planeWeight * normal.y * normal.y;
+				a12 += planeWeight * normal.y * normal.z;
+				a13 += planeWeight * normal.y * distance;
+				a22 += planeWeight * normal.z * normal.z;
+				a23 += planeWeight * normal.z * distance;
+				a33 += planeWeight * distance * distance;
+				weight += planeWeight;
+			}
+
+			void add(const Quadric& other) {
+				a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+				a11 += other.a11; a12 += other.a12; a13 += other.a13;
+				a22 += other.a22; a23 += other.a23;
+				a33 += other.a33;
+				weight += other.weight;
+			}
+
+			// mean squared distance from p to the planes
+			double error(const glm::dvec3& p) const {
+				double rx = a00 * p.x + a01 * p.y + a02 * p.z + a03;
+				double ry = a01 * p.x + a11 * p.y + a12 * p.z + a13;
+				double rz = a02 * p.x + a12 * p.y + a22 * p.z + a23;
+				double sum = rx * p.x + ry * p.y + rz * p.z + a03 * p.x + a13 * p.y + a23 * p.z + a33;
+				return weight > 0 ? std::max(sum, 0.0) / weight : 0.0;
+			}
+		};
+
+		struct PositionKey {
+			uint32_t x, y, z;
+
+			bool operator==(const PositionKey& other) const {
+				return x == other.x && y == other.y && z == other.z;
+			}
+		};
+
+		struct PositionKeyHash {
+			size_t operator()(const PositionKey& key) const {
+				return (key.x * 73856093u) ^ (key.y * 19349663u) ^ (key.z * 83492791u);
+			}
+		};
+
+		struct Collapse {
+			// the position that moves, a seam position drags both of its vertices along the seam
+			uint32_t from;
+			// the vertex of the moving position on the collapsing edge, and the vertex it lands on
+			uint32_t fromVertex;
+			uint32_t to;
+			double cost;
+		};
+
+		uint64_t edgeKey(uint32_t a, uint32_t b) {
+			return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+		}
+
+		// maps every vertex to the first vertex sharing its position
+		void weldPositions(const Vertex* vertices, size_t vertexCount, std::vector<uint32_t>& remap) {
+			std::unordered_map<PositionKey, uint32_t, PositionKeyHash> firstVertices;
+			firstVertices.reserve(vertexCount);
+			remap.resize(vertexCount);
+
+			for (size_t i = 0; i < vertexCount; i++) {
+				PositionKey key;
+				memcpy(&key, &vertices[i].position, sizeof(PositionKey));
+				auto inserted = firstVertices.insert({ key, static_cast<uint32_t>(i) });
+				remap[i] = inserted.first->second;
+			}
+		}
+
+		glm::dvec3 triangleNormal(const glm::dvec3& p0, const glm::dvec3& p1, const glm::dvec3& p2) {
+			return glm::cross(p1 - p0, p2 - p0);
+		}
+	}
+
+	float simplifyMesh(const Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount, size_t targetIndexCount, float targetError, std::vector<uint32_t>& output) {
+		output.assign(indices, indices + indexCount);
+		if (indexCount <= targetIndexCount || vertexCount == 0) {
+			return 0.0f;
+		}
+
+		std::vector<uint32_t> remap;
+		weldPositions(vertices, vertexCount, remap);
+
+		std::vector<glm::dvec3> positions(vertexCount);
+		for (size_t i = 0; i < vertexCount; i++) {
+			positions[i] = glm::dvec3(vertices[i].position);
+		}
+
+		// edges of the welded surface with anything but two triangles are open borders or non manifold
+		std::unordered_map<uint64_t, uint32_t> edgeUses;
+		edgeUses.reserve(indexCount);
+		for (size_t i = 0; i < indexCount; i += 3) {
+			for (int corner = 0; corner < 3; corner++) {
+				uint32_t a = remap[indices[i + corner]];
+				uint32_t b = remap[indices[i + (corner + 1) % 3]];
+				edgeUses[edgeKey(a, b)]++;
+			}
+		}
+
+		// vertices sharing a position form a ring, so a collapse can walk all of them
+		std::vector<uint32_t> nextWedges(vertexCount);
+		for (size_t i = 0; i < vertexCount; i++) {
+			nextWedges[i] = static_cast<uint32_t>(i);
+			if (remap[i] != i) {
+				nextWedges[i] = nextWedges[remap[i]];
+				nextWedges[remap[i]] = static_cast<uint32_t>(i);
+			}
+		}
+
+		std::vector<bool> locked(vertexCount, false);
+		for (const auto& [key, uses] : edgeUses) {
+			if (uses != 2) {
+				locked[static_cast<uint32_t>(key >> 32)] = true;
+				locked[static_cast<uint32_t>(key & 0xFFFFFFFF)] = true;
+			}
+		}
+
+		std::vector<Quadric> quadrics(vertexCount);
+		for (size_t i = 0; i < indexCount; i += 3) {
+			uint32_t r0 = remap[indices[i]], r1 = remap[indices[i + 1]], r2 = remap[indices[i + 2]];
+			glm::dvec3 normal = triangleNormal(positions[r0], positions[r1], positions[r2]);
+			double length = glm::length(normal);
+			if (length <= 0.0) {
+				continue;
+			}
+
+			normal /= length;
+			double distance = -glm::dot(normal, positions[r0]);
+			double area = 0.5 * length;
+			quadrics[r0].addPlane(normal, distance, area);
+			quadrics[r1].addPlane(normal, distance, area);
+			quadrics[r2].addPlane(normal, distance, area);
+		}
+
+		// seam edges get a plane standing up along them, so collapses slide along the seam instead of bending it
+		std::unordered_map<uint64_t, uint32_t> vertexEdgeUses;
+		vertexEdgeUses.reserve(indexCount);
+		for (size_t i = 0; i < indexCount; i++) {
+			vertexEdgeUses[edgeKey(indices[i], indices[i - i % 3 + (i + 1) % 3])]++;
+		}
+		for (size_t i = 0; i < indexCount; i += 3) {
+			uint32_t r[3] = { remap[indices[i]], remap[indices[i + 1]], remap[indices[i + 2]] };
+			glm::dvec3 normal = triangleNormal(positions[r[0]], positions[r[1]], positions[r[2]]);
+			double normalLength = glm::length(normal);
+			for (int corner = 0; corner < 3; corner++) {
+				uint32_t a = r[corner], b = r[(corner + 1) % 3];
+				if (normalLength <= 0.0 || edgeUses.at(edgeKey(a, b)) != 2
+					|| vertexEdgeUses.at(edgeKey(indices[i + corner], indices[i + (corner + 1) % 3])) != 1) {
+					continue;
+				}
+
+				glm::dvec3 edge = positions[b] - positions[a];
+				glm::dvec3 seamNormal = glm::cross(edge, normal / normalLength);
+				double seamLength = glm::length(seamNormal);
+				if (seamLength <= 0.0) {
+					continue;
+				}
+
+				seamNormal /= seamLength;
+				double distance = -glm::dot(seamNormal, positions[a]);
+				double weight = SEAM_WEIGHT * glm::dot(edge, edge);
+				quadrics[a].addPlane(seamNormal, distance, weight);
+				quadrics[b].addPlane(seamNormal, distance, weight);
+			}
+		}
+
+		double errorLimit = static_cast<double>(targetError) * targetError;
+		double reachedError = 0.0;
+		std::vector<uint32_t> collapseTo(vertexCount);
+		std::vector<bool> touched(vertexCount);
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+		std::vector<uint32_t> adjacency;
+		std::vector<Collapse> collapses;
+		std::vector<std::pair<uint32_t, uint32_t>> wedgeMoves;
+
+		// each pass collapses a batch of cheap edges that don't share vertices, then rebuilds the index list
+		while (output.size() > targetIndexCount) {
+			size_t triangleCount = output.size() / 3;
+
+			// welded position to triangle adjacency
+			std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+			for (uint32_t index : output) {
+				adjacencyOffsets[remap[index] + 1]++;
+			}
+			for (size_t i = 0; i < vertexCount; i++) {
+				adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+			}
+			adjacency.resize(output.size());
+			std::vector<uint32_t> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < output.size(); i++) {
+				adjacency[cursor[remap[output[i]]]++] = static_cast<uint32_t>(i / 3);
+			}
+
+			collapses.clear();
+			for (size_t i = 0; i < output.size(); i += 3) {
+				for (int corner = 0; corner < 3; corner++) {
+					uint32_t v0 = output[i + corner];
+					uint32_t v1 = output[i + (corner + 1) % 3];
+					uint32_t r0 = remap[v0], r1 = remap[v1];
+
+					// edges show up once from each of their triangles, the second copy finds its ends touched and is skipped
+					Quadric combined = quadrics[r0];
+					combined.add(quadrics[r1]);
+					Collapse best{ 0, 0, 0, -1.0 };
+					if (!locked[r0]) {
+						best = Collapse{ r0, v0, v1, combined.error(positions[r1]) };
+					}
+					if (!locked[r1]) {
+						double cost = combined.error(positions[r0]);
+						if (best.cost < 0.0 || cost < best.cost) {
+							best = Collapse{ r1, v1, v0, cost };
+						}
+					}
+					if (best.cost >= 0.0 && best.cost <= errorLimit) {
+						collapses.push_back(best);
+					}
+				}
+			}
+
+			if (collapses.empty()) {
+				break;
+			}
+
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+				return a.cost < b.cost;
+			});
+
+			for (size_t i = 0; i < vertexCount; i++) {
+				collapseTo[i] = static_cast<uint32_t>(i);
+			}
+			std::fill(touched.begin(), touched.end(), false);
+
+			// most collapses take out two triangles
+			size_t trianglesToRemove = (output.size() - targetIndexCount) / 3 + 1;
+			size_t removed = 0;
+			for (const Collapse& collapse : collapses) {
+				if (removed >= trianglesToRemove) {
+					break;
+				}
+
+				uint32_t target = remap[collapse.to];
+				if (touched[collapse.from] || touched[target]) {
+					continue;
+				}
+
+				// every vertex of the moving position has to land on the target vertex on its own side of the seams
+				wedgeMoves.clear();
+				uint32_t wedge = collapse.fromVertex;
+				do {
+					uint32_t landing = wedge == collapse.fromVertex ? collapse.to : NO_VERTEX;
+					for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1] && landing == NO_VERTEX; a++) {
+						const uint32_t* triangle = &output[adjacency[a] * 3];
+						if (triangle[0] != wedge && triangle[1] != wedge && triangle[2] != wedge) {
+							continue;
+						}
+						for (int corner = 0; corner < 3; corner++) {
+							if (remap[triangle[corner]] == target) {
+								landing = triangle[corner];
+							}
+						}
+					}
+
+					wedgeMoves.push_back({ wedge, landing });
+					wedge = nextWedges[wedge];
+				} while (wedge != collapse.fromVertex);
+
+				// a vertex with no edge to the target would have to jump across a seam, tearing it open
+				bool tears = false;
+				for (const auto& [moving, landing] : wedgeMoves) {
+					tears = tears || landing == NO_VERTEX;
+				}
+				if (tears) {
+					continue;
+				}
+
+				// refuse collapses that would fold a surviving neighbour over
+				bool flips = false;
+				for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1] && !flips; a++) {
+					const uint32_t* triangle = &output[adjacency[a] * 3];
+					uint32_t r[3] = { remap[triangle[0]], remap[triangle[1]], remap[triangle[2]] };
+					if (r[0] == target || r[1] == target || r[2] == target) {
+						continue;
+					}
+
+					glm::dvec3 before = triangleNormal(positions[r[0]], positions[r[1]], positions[r[2]]);
+					glm::dvec3 moved[3] = { positions[r[0]], positions[r[1]], positions[r[2]] };
+					for (int corner = 0; corner < 3; corner++) {
+						if (r[corner] == collapse.from) {
+							moved[corner] = positions[target];
+						}
+					}
+					glm::dvec3 after = triangleNormal(moved[0], moved[1], moved[2]);
+					flips = glm::dot(before, after) <= FLIP_COSINE_LIMIT * glm::length(before) * glm::length(after);
+				}
+				if (flips) {
+					continue;
+				}
+
+				// neighbours of both ends have stale quadrics and normals until the next pass
+				for (uint32_t end : { collapse.from, target }) {
+					for (uint32_t a = adjacencyOffsets[end]; a < adjacencyOffsets[end + 1]; a++) {
+						const uint32_t* triangle = &output[adjacency[a] * 3];
+						touched[remap[triangle[0]]] = true;
+						touched[remap[triangle[1]]] = true;
+						touched[remap[triangle[2]]] = true;
+					}
+				}
+
+				for (const auto& [moving, landing] : wedgeMoves) {
+					collapseTo[moving] = landing;
+				}
+				quadrics[target].add(quadrics[collapse.from]);
+				reachedError = std::max(reachedError, collapse.cost);
+				removed += 2;
+			}
+
+			if (removed == 0) {
+				break;
+			}
+
+			size_t write = 0;
+			for (size_t i = 0; i < triangleCount * 3; i += 3) {
+				uint32_t a = collapseTo[output[i]], b = collapseTo[output[i + 1]], c = collapseTo[output[i + 2]];
+				if (remap[a] == remap[b] || remap[b] == remap[c] || remap[a] == remap[c]) {
+					continue;
+				}
+
+				output[write++] = a;
+				output[write++] = b;
+				output[write++] = c;
+			}
+			output.resize(write);
+		}
+
+		return static_cast<float>(std::sqrt(reachedError));
+	}
+
+	void buildLodChain(const Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount, std::vector<uint32_t>& lodIndices, std::vector<MeshLod>& lods) {
+		if (vertexCount == 0 || indexCount == 0) {
+			return;
+		}
+
+		glm::vec3 minimum = vertices[0].position;
+		glm::vec3 maximum = vertices[0].position;
+		for (size_t i = 1; i < vertexCount; i++) {
+			minimum = glm::min(minimum, vertices[i].position);
+			maximum = glm::max(maximum, vertices[i].position);
+		}
+		float errorBudget = MAX_LOD_RELATIVE_ERROR * glm::length(maximum - minimum);
+
+		// every level starts from the full mesh so its error is measured against the real surface
+		size_t previousCount = indexCount;
+		std::vector<uint32_t> simplified;
+		for (uint32_t level = 1; level < MAX_MESH_LODS; level++) {
+			size_t target = (indexCount >> level) / 3 * 3;
+			float error = simplifyMesh(vertices, vertexCount, indices, indexCount, target, errorBudget, simplified);
+			if (simplified.empty() || simplified.size() > previousCount * (1.0f - MIN_LOD_REDUCTION)) {
+				break;
+			}
+
+			optimizeVertexCache(simplified.data(), simplified.size(), vertexCount);
+
+			lods.push_back(MeshLod{ static_cast<uint32_t>(lodIndices.size()), static_cast<uint32_t>(simplified.size()), error });
+			lodIndices.insert(lodIndices.end(), simplified.begin(), simplified.end());
+			previousCount = simplified.size();
+		}
+	}
+}
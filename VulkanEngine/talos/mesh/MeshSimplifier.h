@@ -0,0 +1,35 @@
+#pragma once
+#include "../config.h"
+#include "Mesh.h"
+
+/*
+	Quadric error edge collapse (Garland and Heckbert) used to cook levels of
+	detail. Simplification only ever rewrites indices, every level draws from
+	the full mesh's vertex array. Vertices on open borders stay where they
+	are. Positions split into several vertices by normal or texture seams
+	only move along an edge every one of their vertices shares with the
+	target, and seam edges carry extra planes, so levels slide along seams
+	instead of tearing them open.
+*/
+namespace vkMesh {
+	// levels a mesh can have, counting the full detail one
+	static const uint32_t MAX_MESH_LODS = 4;
+
+	// largest error a level may reach, as a fraction of the mesh's bounding box diagonal
+	static const float MAX_LOD_RELATIVE_ERROR = 0.05f;
+
+	/*
+		Collapses edges until at most targetIndexCount indices are left or the next
+		collapse would move the surface further than targetError (model units).
+		Returns the error actually reached.
+	*/
+	float simplifyMesh(const Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount, size_t targetIndexCount, float targetError, std::vector<uint32_t>& output);
+
+	/*
+		Builds up to MAX_MESH_LODS - 1 coarser levels, each aiming at half the
+		triangles of the one before. Levels are appended to lodIndices and lods
+		in order, firstIndex counting from the start of lodIndices. Stops early
+		once a level can't get meaningfully smaller within the error budget.
+	*/
+	void buildLodChain(const Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount, std::vector<uint32_t>& lodIndices, std::vector<MeshLod>& lods);
+}
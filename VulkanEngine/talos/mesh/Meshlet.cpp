@@ -0,0 +1,117 @@
+#include "Meshlet.h"
+#include <cmath>
+
+namespace vkMesh {
+	namespace {
+		// below this the normals spread too far for the cone to reject anything useful
+		const float MIN_CONE_SPREAD = 0.1f;
+
+		void computeBounds(GpuMeshlet& meshlet, const Vertex* vertices, const MeshletData& output) {
+			const uint32_t* meshletVertices = output.vertices.data() + meshlet.vertexOffset;
+			const uint32_t* meshletTriangles = output.triangles.data() + meshlet.triangleOffset;
+
+			// sphere around the box center, not minimal but cheap and stable
+			glm::vec3 minimum = vertices[meshletVertices[0]].position;
+			glm::vec3 maximum = minimum;
+			for (uint32_t i = 1; i < meshlet.vertexCount; i++) {
+				minimum = glm::min(minimum, vertices[meshletVertices[i]].position);
+				maximum = glm::max(maximum, vertices[meshletVertices[i]].position);
+			}
+
+			glm::vec3 center = (minimum + maximum) * 0.5f;
+			float radius = 0.0f;
+			for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+				radius = std::max(radius, glm::distance(center, vertices[meshletVertices[i]].position));
+			}
+			meshlet.sphere = glm::vec4(center, radius);
+
+			std::vector<glm::vec3> normals;
+			normals.reserve(meshlet.triangleCount);
+			glm::vec3 axis = glm::vec3(0.0f);
+			for (uint32_t triangle = 0; triangle < meshlet.triangleCount; triangle++) {
+				uint32_t packed = meshletTriangles[triangle];
+				glm::vec3 a = vertices[meshletVertices[packed & 0xFF]].position;
+				glm::vec3 b = vertices[meshletVertices[(packed >> 8) & 0xFF]].position;
+				glm::vec3 c = vertices[meshletVertices[(packed >> 16) & 0xFF]].position;
+
+				glm::vec3 normal = glm::cross(b - a, c - a);
+				float area = glm::length(normal);
+				if (area > 0.0f) {
+					normals.push_back(normal / area);
+					axis += normal / area;
+				}
+			}
+
+			float axisLength = glm::length(axis);
+			if (normals.empty() || axisLength <= 0.0f) {
+				meshlet.cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+				return;
+			}
+			axis /= axisLength;
+
+			float minimumDot = 1.0f;
+			for (const glm::vec3& normal : normals) {
+				minimumDot = std::min(minimumDot, glm::dot(axis, normal));
+			}
+
+			// the cone test wants the sine of the widest normal's angle from the axis
+			float cutoff = minimumDot <= MIN_CONE_SPREAD ? 1.0f : std::sqrt(1.0f - minimumDot * minimumDot);
+			meshlet.cone = glm::vec4(axis, cutoff);
+		}
+	}
+
+	void buildMeshlets(const Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount, MeshletData& output) {
+		// triangles are taken in index order, which the cooker has already made cache and so spatially coherent
+		const uint8_t UNASSIGNED = 0xFF;
+		std::vector<uint8_t> localIndices(vertexCount, UNASSIGNED);
+
+		GpuMeshlet meshlet{};
+		meshlet.vertexOffset = static_cast<uint32_t>(output.vertices.size());
+		meshlet.triangleOffset = static_cast<uint32_t>(output.triangles.size());
+
+		auto finishMeshlet = [&]() {
+			if (meshlet.triangleCount == 0) {
+				return;
+			}
+
+			computeBounds(meshlet, vertices, output);
+			output.meshlets.push_back(meshlet);
+
+			for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+				localIndices[output.vertices[meshlet.vertexOffset + i]] = UNASSIGNED;
+			}
+
+			meshlet = GpuMeshlet{};
+			meshlet.vertexOffset = static_cast<uint32_t>(output.vertices.size());
+			meshlet.triangleOffset = static_cast<uint32_t>(output.triangles.size());
+		};
+
+		for (size_t i = 0; i + 2 < indexCount; i += 3) {
+			uint32_t corners[3] = { indices[i], indices[i + 1], indices[i + 2] };
+
+			uint32_t newVertices = 0;
+			for (uint32_t corner : corners) {
+				newVertices += localIndices[corner] == UNASSIGNED ? 1 : 0;
+			}
+
+			if (meshlet.vertexCount + newVertices > MAX_MESHLET_VERTICES || meshlet.triangleCount + 1 > MAX_MESHLET_TRIANGLES) {
+				finishMeshlet();
+			}
+
+			uint32_t packed = 0;
+			for (int corner = 0; corner < 3; corner++) {
+				uint8_t& local = localIndices[corners[corner]];
+				if (local == UNASSIGNED) {
+					local = static_cast<uint8_t>(meshlet.vertexCount++);
+					output.vertices.push_back(corners[corner]);
+				}
+				packed |= static_cast<uint32_t>(local) << (8 * corner);
+			}
+
+			output.triangles.push_back(packed);
+			meshlet.triangleCount++;
+		}
+
+		finishMeshlet();
+	}
+}
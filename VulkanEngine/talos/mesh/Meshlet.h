@@ -0,0 +1,38 @@
+#pragma once
+#include "../config.h"
+#include "Mesh.h"
+
+/*
+	Splits a mesh into small clusters that can be culled on their own. Each
+	meshlet lists up to MAX_MESHLET_VERTICES mesh vertices and up to
+	MAX_MESHLET_TRIANGLES triangles that index into that list with 8 bit
+	local indices. Every meshlet carries a bounding sphere for frustum tests
+	and a normal cone for rejecting clusters that face entirely away.
+*/
+namespace vkMesh {
+	static const uint32_t MAX_MESHLET_VERTICES = 64;
+	static const uint32_t MAX_MESHLET_TRIANGLES = 124;
+
+	// std430 layout of one entry in the meshlet buffer
+	struct GpuMeshlet {
+		// xyz center, w radius, in model space
+		glm::vec4 sphere;
+		// xyz axis, w sine of the cone's half angle; w of 1 means the cone is too wide to ever cull
+		glm::vec4 cone;
+		uint32_t vertexOffset;
+		uint32_t triangleOffset;
+		uint32_t vertexCount;
+		uint32_t triangleCount;
+	};
+
+	struct MeshletData {
+		std::vector<GpuMeshlet> meshlets;
+		// mesh local vertex indices, each meshlet owns a run of them
+		std::vector<uint32_t> vertices;
+		// one triangle per entry, three 8 bit indices into the meshlet's vertex run
+		std::vector<uint32_t> triangles;
+	};
+
+	// appends the mesh's meshlets to output, offsets inside them point into output's arrays
+	void buildMeshlets(const Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount, MeshletData& output);
+}
@@ -0,0 +1,206 @@
+#include "ObjBenchmark.h"
+#include "ObjMesh.h"
+#include <chrono>
+
+namespace vkMesh {
+	namespace {
+		struct Material {
+			glm::vec3 ka;
+			glm::vec3 kd;
+			glm::vec3 ks;
+			float e;
+		};
+
+		// floats per vertex the baseline writes: position, ka, kd, ks, e, texcoord, normal
+		const size_t STREAM_VERTEX_FLOATS = 18;
+
+		// The getline/split/stof loader ObjMesh used before it parsed mapped files in place.
+		// Only kept as the baseline the benchmark measures against.
+		class StreamObjParser {
+		public:
+			std::vector<float> vertices;
+			std::vector<uint32_t> indices;
+			std::unordered_map<std::string, uint32_t> history;
+			std::unordered_map<std::string, Material> materials;
+			Material brushColor{};
+
+			std::vector<glm::vec3> v, vn;
+			std::vector<glm::vec2> vt;
+			glm::mat4 preTransform;
+
+			void load(std::string objFilepath, std::string mtlFilepath, glm::mat4 preTransform) {
+				this->preTransform = preTransform;
+
+				std::ifstream file;
+				file.open(mtlFilepath);
+				std::string line;
+				std::string materialName;
+				std::vector<std::string> words;
+
+				glm::vec3 ka = glm::vec3(0.0f);
+				glm::vec3 kd = glm::vec3(0.0f);
+				glm::vec3 ks = glm::vec3(0.0f);
+				float e = 0.0f;
+				while (std::getline(file, line)) {
+					words = split(line, " ");
+
+					if (!words[0].compare("newmtl")) {
+						materialName = words[1];
+					}
+
+					if (!words[0].compare("Ka")) {
+						ka = glm::vec3(std::stof(words[1]), std::stof(words[2]), std::stof(words[3]));
+					}
+
+					if (!words[0].compare("Kd")) {
+						kd = glm::vec3(std::stof(words[1]), std::stof(words[2]), std::stof(words[3]));
+					}
+
+					if (!words[0].compare("Ks")) {
+						ks = glm::vec3(std::stof(words[1]), std::stof(words[2]), std::stof(words[3]));
+					}
+
+					if (!words[0].compare("Ni")) {
+						e = std::stof(words[1]);
+						materials.insert({ materialName, Material{ka, kd, ks, e} });
+					}
+				}
+
+				file.close();
+
+				file.open(objFilepath);
+				while (std::getline(file, line)) {
+					words = split(line, " ");
+
+					if (!words[0].compare("v")) {
+						glm::vec4 newVertex = glm::vec4(std::stof(words[1]), std::stof(words[2]), std::stof(words[3]), 1.0f);
+						v.push_back(glm::vec3(preTransform * newVertex));
+					}
+
+					if (!words[0].compare("vt")) {
+						vt.push_back(glm::vec2(std::stof(words[1]), std::stof(words[2])));
+					}
+
+					if (!words[0].compare("vn")) {
+						glm::vec4 newVertex = glm::vec4(std::stof(words[1]), std::stof(words[2]), std::stof(words[3]), 0.0f);
+						vn.push_back(glm::vec3(preTransform * newVertex));
+					}
+
+					if (!words[0].compare("usemtl")) {
+						if (materials.find(words[1]) != materials.end()) {
+							brushColor = materials[words[1]];
+						}
+						else {
+							brushColor = Material{};
+						}
+					}
+
+					if (!words[0].compare("f")) {
+						size_t triangleCount = words.size() - 3;
+
+						for (int i = 0; i < triangleCount; i++) {
+							readCorner(words[1]);
+							readCorner(words[2 + i]);
+							readCorner(words[3 + i]);
+						}
+					}
+				}
+
+				file.close();
+			}
+
+			void readCorner(const std::string& vertexDesc) {
+				if (history.find(vertexDesc) != history.end()) {
+					indices.push_back(history[vertexDesc]);
+					return;
+				}
+
+				uint32_t index = static_cast<uint32_t>(history.size());
+				history.insert({ vertexDesc, index });
+				indices.push_back(index);
+
+				std::vector<std::string> vertexData = split(vertexDesc, "/");
+				glm::vec3 pos = v[std::stol(vertexData[0]) - 1];
+				vertices.insert(vertices.end(), { pos[0], pos[1], pos[2] });
+				vertices.insert(vertices.end(), { brushColor.ka[0], brushColor.ka[1], brushColor.ka[2] });
+				vertices.insert(vertices.end(), { brushColor.kd[0], brushColor.kd[1], brushColor.kd[2] });
+				vertices.insert(vertices.end(), { brushColor.ks[0], brushColor.ks[1], brushColor.ks[2] });
+				vertices.push_back(brushColor.e);
+
+				glm::vec2 texCoord = glm::vec2(0.0f, 0.0f);
+				if (vertexData.size() == 3 && vertexData[1].size() > 0) {
+					texCoord = vt[std::stol(vertexData[1]) - 1];
+				}
+				vertices.push_back(texCoord[0]);
+				vertices.push_back(1.0f - texCoord[1]);
+
+				glm::vec3 normal = vn[std::stol(vertexData[2]) - 1];
+				vertices.insert(vertices.end(), { normal[0], normal[1], normal[2] });
+			}
+		};
+
+		double toMegabytesPerSecond(size_t bytes, double seconds) {
+			return seconds > 0.0 ? (static_cast<double>(bytes) / (1024.0 * 1024.0)) / seconds : 0.0;
+		}
+	}
+
+	void benchmarkObjParsers(const std::string& objFilepath, const std::string& mtlFilepath, int iterations) {
+		if (iterations < 1) {
+			iterations = 1;
+		}
+
+		size_t bytesPerRun = 0;
+		vkUtilities::MappedFile sizeCheck;
+		if (sizeCheck.open(objFilepath)) {
+			bytesPerRun += sizeCheck.getSize();
+		}
+		if (sizeCheck.open(mtlFilepath)) {
+			bytesPerRun += sizeCheck.getSize();
+		}
+		sizeCheck.close();
+
+		if (bytesPerRun == 0) {
+			std::cout << "Nothing to benchmark in \"" << objFilepath << "\"" << std::endl;
+			return;
+		}
+
+		glm::mat4 preTransform = glm::mat4(1.0f);
+		preTransform[3][3] = 0.0f;
+
+		// Stream parser
+		StreamObjParser streamResult;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; i++) {
+			streamResult = StreamObjParser{};
+			streamResult.load(objFilepath, mtlFilepath, preTransform);
+		}
+		std::chrono::duration<double> streamTime = std::chrono::steady_clock::now() - start;
+
+		// In place parser, called below the cache so every run really parses
+		ObjMesh mappedResult;
+		start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; i++) {
+			mappedResult = ObjMesh{};
+			mappedResult.preTransform = preTransform;
+			mappedResult.parse(objFilepath, mtlFilepath);
+		}
+		std::chrono::duration<double> mappedTime = std::chrono::steady_clock::now() - start;
+
+		// the baseline keys corners on their text alone and bakes colours into each vertex, so rather than the vertex lists
+		// compare what every corner resolves to; a corner shared across usemtl groups keeps the first group's colours there
+		bool identical = streamResult.indices.size() == mappedResult.indices.size();
+		for (size_t i = 0; identical && i < mappedResult.indices.size(); i++) {
+			const float* streamVertex = streamResult.vertices.data() + streamResult.indices[i] * STREAM_VERTEX_FLOATS;
+			const Vertex& mappedVertex = mappedResult.vertices[mappedResult.indices[i]];
+			identical = glm::vec3(streamVertex[0], streamVertex[1], streamVertex[2]) == mappedVertex.position
+				&& glm::vec2(streamVertex[13], streamVertex[14]) == mappedVertex.texCoord
+				&& glm::vec3(streamVertex[15], streamVertex[16], streamVertex[17]) == mappedVertex.normal;
+		}
+
+		size_t totalBytes = bytesPerRun * iterations;
+		std::cout << "OBJ parse benchmark: " << objFilepath << " (" << bytesPerRun << " bytes, " << iterations << " runs)" << std::endl;
+		std::cout << "\tstream parser: " << toMegabytesPerSecond(totalBytes, streamTime.count()) << " MB/s" << std::endl;
+		std::cout << "\tmapped parser: " << toMegabytesPerSecond(totalBytes, mappedTime.count()) << " MB/s" << std::endl;
+		std::cout << "\toutputs " << (identical ? "match" : "DIFFER") << std::endl;
+	}
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include "../config.h"
+
+/*
+	Times ObjMesh's in place parser against the old stream based one on the same files
+*/
+namespace vkMesh {
+	void benchmarkObjParsers(const std::string& objFilepath, const std::string& mtlFilepath, int iterations);
+}
@@ -1,154 +1,493 @@
 #include "ObjMesh.h"
+#include "Mesh.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "../job/Job.h"
+#include <charconv>
+#include <memory>
 
 namespace vkMesh {
-	void ObjMesh::load(std::string objFilepath, std::string mtlFilepath, glm::mat4 preTransform) {
-		this->preTransform = preTransform;
+	namespace {
+		bool isBlank(char c) {
+			return c == ' ' || c == '\t' || c == '\r';
+		}
 
-		std::ifstream file;
-		file.open(mtlFilepath);
-		std::string line;
-		std::string materialName;
-		std::vector<std::string> words;
+		// returns the line starting at cursor without its line break, and moves cursor past it
+		std::string_view nextLine(const char*& cursor, const char* end) {
+			const char* lineEnd = static_cast<const char*>(memchr(cursor, '\n', end - cursor));
+			if (!lineEnd) {
+				lineEnd = end;
+			}
 
-		glm::vec3 ka;
-		glm::vec3 kd;
-		glm::vec3 ks;
-		float e;
-		while (std::getline(file, line)) {
-			words = split(line, " ");
-			
-			if (!words[0].compare("newmtl")) {
-				materialName = words[1];
+			std::string_view line(cursor, lineEnd - cursor);
+			cursor = lineEnd < end ? lineEnd + 1 : end;
+			return line;
+		}
+
+		// pops the next whitespace separated token off the line, empty once the line is used up
+		std::string_view nextToken(std::string_view& line) {
+			size_t start = 0;
+			while (start < line.size() && isBlank(line[start])) {
+				start++;
 			}
 
-			if (!words[0].compare("Ka")) {
-				ka = glm::vec3(std::stof(words[1]), std::stof(words[2]), std::stof(words[3]));
+			size_t stop = start;
+			while (stop < line.size() && !isBlank(line[stop])) {
+				stop++;
 			}
 
-			if (!words[0].compare("Kd")) {
-				kd = glm::vec3(std::stof(words[1]), std::stof(words[2]), std::stof(words[3]));
+			std::string_view token = line.substr(start, stop - start);
+			line.remove_prefix(stop);
+			return token;
+		}
+
+		float toFloat(std::string_view token) {
+			// from_chars doesn't take an explicit plus sign, stof did
+			if (!token.empty() && token[0] == '+') {
+				token.remove_prefix(1);
 			}
 
-			if (!words[0].compare("Ks")) {
-				ks = glm::vec3(std::stof(words[1]), std::stof(words[2]), std::stof(words[3]));
+			float value = 0.0f;
+			std::from_chars(token.data(), token.data() + token.size(), value);
+			return value;
+		}
+
+		long toIndex(std::string_view token) {
+			long value = 0;
+			std::from_chars(token.data(), token.data() + token.size(), value);
+			return value;
+		}
+
+		size_t hashCorner(const CornerKey& key) {
+			uint64_t hash = (static_cast<uint64_t>(key.position) << 32) | key.texCoord;
+			hash ^= ((static_cast<uint64_t>(key.normal) << 32) | key.material) * 0x9E3779B97F4A7C15ULL;
+			hash ^= hash >> 29;
+			hash *= 0xBF58476D1CE4E5B9ULL;
+			hash ^= hash >> 32;
+			return static_cast<size_t>(hash);
+		}
+
+		glm::vec3 readVec3(std::string_view& arguments) {
+			float x = toFloat(nextToken(arguments));
+			float y = toFloat(nextToken(arguments));
+			float z = toFloat(nextToken(arguments));
+			return glm::vec3(x, y, z);
+		}
+	}
+
+	void CornerTable::reserve(size_t cornerCount) {
+		// keep the load under one half so probe runs stay short
+		size_t capacity = 16;
+		while (capacity < cornerCount * 2) {
+			capacity *= 2;
+		}
+
+		if (capacity <= slots.size()) {
+			return;
+		}
+
+		std::vector<Slot> oldSlots = std::move(slots);
+		slots.assign(capacity, Slot{});
+		mask = capacity - 1;
+		count = 0;
+		for (const Slot& slot : oldSlots) {
+			if (slot.index != EMPTY) {
+				findOrInsert(slot.key, slot.index);
 			}
+		}
+	}
 
-			if (!words[0].compare("Ni")) {
-				e = std::stof(words[1]);
-				materials.insert({ materialName, Material{ka, kd, ks, e} });
+	uint32_t CornerTable::findOrInsert(const CornerKey& key, uint32_t newIndex) {
+		if ((count + 1) * 2 > slots.size()) {
+			grow();
+		}
+
+		size_t position = hashCorner(key) & mask;
+		while (slots[position].index != EMPTY) {
+			if (slots[position].key == key) {
+				return slots[position].index;
 			}
+			position = (position + 1) & mask;
 		}
 
-		file.close();
+		slots[position].key = key;
+		slots[position].index = newIndex;
+		count++;
+		return newIndex;
+	}
+
+	void CornerTable::grow() {
+		reserve(slots.size());
+	}
+
+	void CornerTable::release() {
+		slots = std::vector<Slot>();
+		mask = 0;
+		count = 0;
+	}
+
+	void ObjMesh::load(std::string objFilepath, std::string mtlFilepath, glm::mat4 preTransform) {
+		this->preTransform = preTransform;
+
+		// the cache is keyed on file contents, so any edit to the sources invalidates it
+		vkUtilities::MappedFile objFile;
+		vkUtilities::MappedFile mtlFile;
+		bool sourcesFound = objFile.open(objFilepath);
+		mtlFile.open(mtlFilepath);
+		sourceHash = hashMeshSource(objFile, mtlFile, preTransform, optimizeOverdraw);
+		objFile.close();
+		mtlFile.close();
+
+		cachePath = getMeshCachePath(sourceHash, cacheDirectory);
+		if (sourcesFound && cache.load(cachePath, sourceHash, chunkQueue)) {
+			loadedFromCache = true;
+			return;
+		}
+
+		parse(objFilepath, mtlFilepath);
+		optimize(objFilepath);
+
+		if (sourcesFound && !MeshCache::write(cachePath, sourceHash, materials, vertices, indices, lods, lodIndices, compressCache)) {
+			std::cout << "Failed to write mesh cache \"" << cachePath << "\"" << std::endl;
+		}
+	}
+
+	bool ObjMesh::loadCooked(const std::string& cookedPath, uint64_t cookedHash) {
+		loadedFromCache = cache.load(cookedPath, cookedHash, chunkQueue);
+		if (loadedFromCache) {
+			sourceHash = cookedHash;
+			cachePath = cookedPath;
+		}
+
+		return loadedFromCache;
+	}
+
+	void ObjMesh::parse(std::string objFilepath, std::string mtlFilepath) {
+		materials = { GpuMaterial{ glm::vec4(0.0f), glm::vec4(0.0f), glm::vec4(0.0f) } };
+		materialIndices.clear();
+		brushMaterial = 0;
+
+		vkUtilities::MappedFile mtlFile;
+		if (mtlFile.open(mtlFilepath)) {
+			readMaterials(mtlFile.getData(), mtlFile.getSize());
+		}
+		else {
+			std::cout << "Failed to load \"" << mtlFilepath << "\"" << std::endl;
+		}
+
+		vkUtilities::MappedFile objFile;
+		if (objFile.open(objFilepath)) {
+			readGeometry(objFile.getData(), objFile.getSize());
+		}
+		else {
+			std::cout << "Failed to load \"" << objFilepath << "\"" << std::endl;
+		}
+
+		// only the final vertices and indices outlive the parse
+		history.release();
+		v = std::vector<glm::vec3>();
+		vt = std::vector<glm::vec2>();
+		vn = std::vector<glm::vec3>();
+		materialIndices = std::unordered_map<std::string, uint32_t>();
+	}
+
+	void ObjMesh::optimize(const std::string& objFilepath) {
+		float acmrBefore = debug ? computeAcmr(indices.data(), indices.size(), vertices.size()) : 0.0f;
+
+		optimizeVertexCache(indices.data(), indices.size(), vertices.size());
+		if (optimizeOverdraw) {
+			vkMesh::optimizeOverdraw(indices.data(), indices.size(), vertices.data(), vertices.size());
+		}
+		optimizeVertexFetch(vertices, indices);
+
+		// levels are simplified from the final index order, so they share the fetch ordered vertices
+		lods.clear();
+		lodIndices.clear();
+		buildLodChain(vertices.data(), vertices.size(), indices.data(), indices.size(), lodIndices, lods);
+
+		if (debug) {
+			float acmrAfter = computeAcmr(indices.data(), indices.size(), vertices.size());
+			std::cout << "Optimized \"" << objFilepath << "\": ACMR " << acmrBefore << " -> " << acmrAfter
+				<< (optimizeOverdraw ? " (overdraw ordered)" : "") << ", " << lods.size() << " coarser levels of detail" << std::endl;
+		}
+	}
+
+	void ObjMesh::readMaterials(const char* data, size_t size) {
+		const char* cursor = data;
+		const char* end = data + size;
+		std::string materialName;
 
-		// OBJ File
-		file.open(objFilepath);
-		while (std::getline(file, line)) {
-			words = split(line, " ");
+		glm::vec3 ka = glm::vec3(0.0f);
+		glm::vec3 kd = glm::vec3(0.0f);
+		glm::vec3 ks = glm::vec3(0.0f);
+		float e = 0.0f;
+		while (cursor < end) {
+			std::string_view line = nextLine(cursor, end);
+			std::string_view keyword = nextToken(line);
 
-			if (!words[0].compare("v")) {
-				readVertexData(words);
+			if (keyword == "newmtl") {
+				materialName.assign(nextToken(line));
 			}
+			else if (keyword == "Ka") {
+				ka = readVec3(line);
+			}
+			else if (keyword == "Kd") {
+				kd = readVec3(line);
+			}
+			else if (keyword == "Ks") {
+				ks = readVec3(line);
+			}
+			else if (keyword == "Ni") {
+				e = toFloat(nextToken(line));
+				if (materialIndices.try_emplace(materialName, static_cast<uint32_t>(materials.size())).second) {
+					materials.push_back(GpuMaterial{ glm::vec4(ka, 0.0f), glm::vec4(kd, 0.0f), glm::vec4(ks, e) });
+				}
+			}
+		}
+	}
+
+	void ObjMesh::readGeometry(const char* data, size_t size) {
+		const char* end = data + size;
 
-			if (!words[0].compare("vt")) {
-				readTexCoordData(words);
+		// cut the file into line aligned pieces, small files stay in one piece
+		std::vector<const char*> boundaries = { data };
+		if (chunkQueue && chunkSize > 0) {
+			const char* boundary = data + chunkSize;
+			while (boundary < end) {
+				const char* lineEnd = static_cast<const char*>(memchr(boundary, '\n', end - boundary));
+				if (!lineEnd) {
+					break;
+				}
+
+				boundaries.push_back(lineEnd + 1);
+				boundary = lineEnd + 1 + chunkSize;
 			}
+		}
+		boundaries.push_back(end);
 
-			if (!words[0].compare("vn")) {
-				readNormalData(words);
+		size_t chunkCount = boundaries.size() - 1;
+		std::vector<ObjChunk> chunks(chunkCount);
+		if (chunkCount == 1) {
+			readChunk(data, end, chunks[0]);
+		}
+		else {
+			std::vector<std::unique_ptr<vkJob::Job>> jobs;
+			std::vector<vkJob::Job*> queued;
+			jobs.reserve(chunkCount);
+			for (size_t i = 0; i < chunkCount; i++) {
+				jobs.push_back(std::make_unique<vkJob::ParseObjChunkJob>(*this, boundaries[i], boundaries[i + 1], chunks[i]));
+				queued.push_back(jobs.back().get());
 			}
 
-			if (!words[0].compare("usemtl")) {
-				if (materials.find(words[1]) != materials.end()) {
-					brushColor = materials[words[1]];
+			// work through our own chunks too rather than idling until the workers get to them
+			chunkQueue->runAndWait(queued);
+		}
+
+		mergeChunks(chunks);
+	}
+
+	void ObjMesh::readChunk(const char* begin, const char* end, ObjChunk& chunk) const {
+		const char* cursor = begin;
+
+		// reused for material lookups so usemtl lines don't allocate
+		std::string materialName;
+
+		while (cursor < end) {
+			std::string_view line = nextLine(cursor, end);
+			std::string_view keyword = nextToken(line);
+
+			if (keyword == "v") {
+				readVertexData(line, chunk);
+			}
+			else if (keyword == "vt") {
+				readTexCoordData(line, chunk);
+			}
+			else if (keyword == "vn") {
+				readNormalData(line, chunk);
+			}
+			else if (keyword == "usemtl") {
+				materialName.assign(nextToken(line));
+				std::unordered_map<std::string, uint32_t>::const_iterator material = materialIndices.find(materialName);
+				if (material != materialIndices.end()) {
+					chunk.materialChanges.push_back({ chunk.corners.size(), material->second });
 				}
 				else {
-					brushColor = Material{};
+					chunk.materialChanges.push_back({ chunk.corners.size(), 0 });
 				}
 			}
-
-			if (!words[0].compare("f")) {
-				readFaceData(words);
+			else if (keyword == "f") {
+				readFaceData(line, chunk);
 			}
 		}
+	}
+
+	void ObjMesh::mergeChunks(std::vector<ObjChunk>& chunks) {
+		// prefix sum the per chunk counts to find where each chunk lands in the shared arrays
+		size_t positionCount = v.size();
+		size_t texCoordCount = vt.size();
+		size_t normalCount = vn.size();
+		size_t cornerCount = 0;
+		std::vector<size_t> positionOffsets, texCoordOffsets, normalOffsets;
+		for (const ObjChunk& chunk : chunks) {
+			positionOffsets.push_back(positionCount);
+			texCoordOffsets.push_back(texCoordCount);
+			normalOffsets.push_back(normalCount);
+			positionCount += chunk.v.size();
+			texCoordCount += chunk.vt.size();
+			normalCount += chunk.vn.size();
+			cornerCount += chunk.corners.size();
+		}
+
+		v.resize(positionCount);
+		vt.resize(texCoordCount);
+		vn.resize(normalCount);
+		for (size_t i = 0; i < chunks.size(); i++) {
+			std::copy(chunks[i].v.begin(), chunks[i].v.end(), v.begin() + positionOffsets[i]);
+			std::copy(chunks[i].vt.begin(), chunks[i].vt.end(), vt.begin() + texCoordOffsets[i]);
+			std::copy(chunks[i].vn.begin(), chunks[i].vn.end(), vn.begin() + normalOffsets[i]);
+		}
+
+		// face indices are global to the file, so corners can only be resolved once every chunk is in
+		indices.reserve(indices.size() + cornerCount);
+		history.reserve(cornerCount);
+		for (ObjChunk& chunk : chunks) {
+			size_t change = 0;
+			for (size_t corner = 0; corner < chunk.corners.size(); corner++) {
+				while (change < chunk.materialChanges.size() && chunk.materialChanges[change].first == corner) {
+					brushMaterial = chunk.materialChanges[change].second;
+					change++;
+				}
+
+				readCorner(chunk.corners[corner]);
+			}
 
-		file.close();
+			// a trailing usemtl still carries over into the next chunk
+			while (change < chunk.materialChanges.size()) {
+				brushMaterial = chunk.materialChanges[change].second;
+				change++;
+			}
 
+			chunk = ObjChunk{};
+		}
 	}
 
-	void ObjMesh::readVertexData(const std::vector<std::string>& words) {
-		glm::vec4 newVertex = glm::vec4(std::stof(words[1]), std::stof(words[2]), std::stof(words[3]), 1.0f);
+	void ObjMesh::readVertexData(std::string_view arguments, ObjChunk& chunk) const {
+		glm::vec4 newVertex = glm::vec4(readVec3(arguments), 1.0f);
 		glm::vec3 vertexPos = glm::vec3(preTransform * newVertex);
-		v.push_back(vertexPos);
+		chunk.v.push_back(vertexPos);
 	}
-	void ObjMesh::readTexCoordData(const std::vector<std::string>& words) {
-		glm::vec2 newVertex = glm::vec2(std::stof(words[1]), std::stof(words[2]));
-		vt.push_back(newVertex);
+
+	void ObjMesh::readTexCoordData(std::string_view arguments, ObjChunk& chunk) const {
+		float u = toFloat(nextToken(arguments));
+		float w = toFloat(nextToken(arguments));
+		chunk.vt.push_back(glm::vec2(u, w));
 	}
 
-	void ObjMesh::readNormalData(const std::vector<std::string>& words) {
-		glm::vec4 newVertex = glm::vec4(std::stof(words[1]), std::stof(words[2]), std::stof(words[3]), 0.0f);
+	void ObjMesh::readNormalData(std::string_view arguments, ObjChunk& chunk) const {
+		glm::vec4 newVertex = glm::vec4(readVec3(arguments), 0.0f);
 		glm::vec3 vertexNormal = glm::vec3(preTransform * newVertex);
-		vn.push_back(vertexNormal);
+		chunk.vn.push_back(vertexNormal);
 	}
 
-	void ObjMesh::readFaceData(const std::vector<std::string>& words) {
-		size_t triangleCount = words.size() - 3;
+	void ObjMesh::readFaceData(std::string_view arguments, ObjChunk& chunk) const {
+		// triangulate as a fan around the first corner
+		std::string_view first = nextToken(arguments);
+		std::string_view previous = nextToken(arguments);
+		std::string_view current = nextToken(arguments);
 
-		for (int i = 0; i < triangleCount; i++) {
-			readCorner(words[1]);
-			readCorner(words[2 + i]);
-			readCorner(words[3 + i]);
+		while (!current.empty()) {
+			chunk.corners.push_back(first);
+			chunk.corners.push_back(previous);
+			chunk.corners.push_back(current);
+
+			previous = current;
+			current = nextToken(arguments);
 		}
 	}
 
-	void ObjMesh::readCorner(const std::string& vertexDesc) {
-		if (history.find(vertexDesc) != history.end()) {
-			indices.push_back(history[vertexDesc]);
-			return;
+	void ObjMesh::readCorner(std::string_view vertexDesc) {
+		// split into position/texcoord/normal
+		std::string_view positionDesc = vertexDesc;
+		std::string_view texCoordDesc;
+		std::string_view normalDesc;
+		size_t slash = vertexDesc.find('/');
+		if (slash != std::string_view::npos) {
+			positionDesc = vertexDesc.substr(0, slash);
+			texCoordDesc = vertexDesc.substr(slash + 1);
+
+			slash = texCoordDesc.find('/');
+			if (slash != std::string_view::npos) {
+				normalDesc = texCoordDesc.substr(slash + 1);
+				texCoordDesc = texCoordDesc.substr(0, slash);
+			}
 		}
 
-		uint32_t index = static_cast<uint32_t>(history.size());
-		history.insert({ vertexDesc, index });
+		CornerKey key;
+		key.position = static_cast<uint32_t>(toIndex(positionDesc));
+		key.texCoord = static_cast<uint32_t>(toIndex(texCoordDesc));
+		key.normal = static_cast<uint32_t>(toIndex(normalDesc));
+		key.material = brushMaterial;
+
+		uint32_t newIndex = static_cast<uint32_t>(vertices.size());
+		uint32_t index = history.findOrInsert(key, newIndex);
 		indices.push_back(index);
+		if (index != newIndex) {
+			return;
+		}
 
-		// position
-		std::vector<std::string> vertexData = split(vertexDesc, "/");
-		glm::vec3 pos = v[std::stol(vertexData[0]) - 1];
-		vertices.push_back(pos[0]);
-		vertices.push_back(pos[1]);
-		vertices.push_back(pos[2]);
+		Vertex vertex;
+		vertex.position = v[key.position - 1];
 
-		// Ka
-		vertices.push_back(brushColor.ka[0]);
-		vertices.push_back(brushColor.ka[1]);
-		vertices.push_back(brushColor.ka[2]);
+		vertex.normal = glm::vec3(0.0f, 0.0f, 0.0f);
+		if (key.normal > 0) {
+			vertex.normal = vn[key.normal - 1];
+		}
 
-		// Kd
-		vertices.push_back(brushColor.kd[0]);
-		vertices.push_back(brushColor.kd[1]);
-		vertices.push_back(brushColor.kd[2]);
+		glm::vec2 texCoord = glm::vec2(0.0f, 0.0f);
+		if (key.texCoord > 0) {
+			texCoord = vt[key.texCoord - 1];
+		}
+		vertex.texCoord = glm::vec2(texCoord[0], 1.0f - texCoord[1]);
 
-		// Ks
-		vertices.push_back(brushColor.ks[0]);
-		vertices.push_back(brushColor.ks[1]);
-		vertices.push_back(brushColor.ks[2]);
+		// the colours themselves live in the material buffer
+		vertex.materialIndex = brushMaterial;
 
-		// e
-		vertices.push_back(brushColor.e);
+		vertices.push_back(vertex);
+	}
 
-		// Tex Coord
-		glm::vec2 texCoord = glm::vec2(0.0f, 0.0f);
-		if (vertexData.size() == 3 && vertexData[1].size() > 0) {
-			texCoord = vt[std::stol(vertexData[1]) - 1];
-		}
-		vertices.push_back(texCoord[0]);
-		vertices.push_back(1.0f - texCoord[1]);
+	const Vertex* ObjMesh::getVertexData() const {
+		return loadedFromCache ? cache.getVertexData() : vertices.data();
+	}
+
+	size_t ObjMesh::getVertexCount() const {
+		return loadedFromCache ? cache.getVertexCount() : vertices.size();
+	}
+
+	const uint32_t* ObjMesh::getIndexData() const {
+		return loadedFromCache ? cache.getIndexData() : indices.data();
+	}
+
+	size_t ObjMesh::getIndexCount() const {
+		return loadedFromCache ? cache.getIndexCount() : indices.size();
+	}
+
+	const GpuMaterial* ObjMesh::getMaterialData() const {
+		return loadedFromCache ? cache.getMaterialData() : materials.data();
+	}
+
+	size_t ObjMesh::getMaterialCount() const {
+		return loadedFromCache ? cache.getMaterialCount() : materials.size();
+	}
+
+	const MeshLod* ObjMesh::getLodData() const {
+		return loadedFromCache ? cache.getLodData() : lods.data();
+	}
+
+	size_t ObjMesh::getLodCount() const {
+		return loadedFromCache ? cache.getLodCount() : lods.size();
+	}
 
-		// Normal Coords
-		glm::vec3 normal = vn[std::stol(vertexData[2]) - 1];
-		vertices.push_back(normal[0]);
-		vertices.push_back(normal[1]);
-		vertices.push_back(normal[2]);
+	const uint32_t* ObjMesh::getLodIndexData() const {
+		return loadedFromCache ? cache.getLodIndexData() : lodIndices.data();
 	}
 }
\ No newline at end of file
@@ -1,31 +1,137 @@
 #pragma once
 #include "../config.h"
+#include "MeshCache.h"
+#include "Mesh.h"
+#include <string_view>
+
+namespace vkJob {
+	class JobQueue;
+}
 
 namespace vkMesh {
-	struct Material {
-		glm::vec3 ka;
-		glm::vec3 kd;
-		glm::vec3 ks;
-		float e;
+	// one obj face corner after parsing, indices are 1 based with 0 meaning absent
+	struct CornerKey {
+		uint32_t position;
+		uint32_t texCoord;
+		uint32_t normal;
+		uint32_t material;
+
+		bool operator==(const CornerKey& other) const {
+			return position == other.position && texCoord == other.texCoord
+				&& normal == other.normal && material == other.material;
+		}
+	};
+
+	// open addressing (linear probe) map from corner to vertex index, sized once up front
+	class CornerTable {
+	public:
+		void reserve(size_t cornerCount);
+
+		// returns the vertex already made for this corner, or records and returns newIndex
+		uint32_t findOrInsert(const CornerKey& key, uint32_t newIndex);
+
+		void release();
+
+	private:
+		static const uint32_t EMPTY = 0xFFFFFFFF;
+
+		struct Slot {
+			CornerKey key;
+			uint32_t index = EMPTY;
+		};
+
+		std::vector<Slot> slots;
+		size_t mask = 0;
+		size_t count = 0;
+
+		void grow();
 	};
 
+	// everything parsed out of one line aligned piece of an obj file
+	struct ObjChunk {
+		std::vector<glm::vec3> v, vn;
+		std::vector<glm::vec2> vt;
+
+		// triangle corners in file order, as written ("12/40/7")
+		std::vector<std::string_view> corners;
+
+		// usemtl switches as (first corner drawn with it, material index)
+		// corners before the first switch carry on with the previous chunk's material
+		std::vector<std::pair<size_t, uint32_t>> materialChanges;
+	};
+
+	// the transform every engine model is loaded and cooked with, w might need to be zero
+	inline glm::mat4 makeModelPreTransform() {
+		glm::mat4 preTransform = glm::mat4(1.0f);
+		preTransform[3][3] = 0.0f;
+		return preTransform;
+	}
+
 	class ObjMesh {
 	public:
-		std::vector<float> vertices;
+		std::vector<Vertex> vertices;
 		std::vector<uint32_t> indices;
-		std::unordered_map<std::string, uint32_t> history;
-		std::unordered_map<std::string, Material> materials;
-		Material brushColor;
+		// coarser levels of detail over the same vertices, firstIndex counts from the start of lodIndices
+		std::vector<MeshLod> lods;
+		std::vector<uint32_t> lodIndices;
+		// materials[0] is the blank material used before any usemtl and for unknown names
+		std::vector<GpuMaterial> materials;
+		std::unordered_map<std::string, uint32_t> materialIndices;
+		uint32_t brushMaterial = 0;
 
+		// parse scratch, released once parse() is done
+		CornerTable history;
 		std::vector<glm::vec3> v, vn;
 		std::vector<glm::vec2> vt;
 		glm::mat4 preTransform;
 
+		// when set, obj files bigger than chunkSize are split at line boundaries and parsed on the queue's workers,
+		// and compressed caches decompress there too
+		vkJob::JobQueue* chunkQueue = nullptr;
+		size_t chunkSize = 4 * 1024 * 1024;
+
+		// also order triangles against overdraw when cooking, at a small cost in vertex cache hits
+		bool optimizeOverdraw = false;
+		// reports the acmr change of every mesh it cooks
+		bool debug = false;
+
+		// set when the mesh was served from a cooked cache instead of the text files
+		bool loadedFromCache = false;
+		MeshCache cache;
+		// where load looks for and writes cooked copies, and the key and file it used last
+		std::string cacheDirectory = MESH_CACHE_DIRECTORY;
+		// smaller files for a slower load, worth it for cooked copies that ship
+		bool compressCache = false;
+		uint64_t sourceHash = 0;
+		std::string cachePath;
+
 		void load(std::string objFilepath, std::string mtlFilepath, glm::mat4 preTransform);
-		void readVertexData(const std::vector<std::string>& words);
-		void readTexCoordData(const std::vector<std::string>& words);
-		void readNormalData(const std::vector<std::string>& words);
-		void readFaceData(const std::vector<std::string>& words);
-		void readCorner(const std::string& vertexDesc);
+		// maps a blob made by talos-cook without touching the sources, false if it's missing or doesn't match
+		bool loadCooked(const std::string& cookedPath, uint64_t cookedHash);
+		void parse(std::string objFilepath, std::string mtlFilepath);
+		// reorders the parsed indices and vertices for the gpu, builds the levels of detail and, in debug, reports the acmr change
+		void optimize(const std::string& objFilepath);
+
+		// parsers work in place on the mapped text; each takes the rest of the line after its keyword
+		void readMaterials(const char* data, size_t size);
+		void readGeometry(const char* data, size_t size);
+		void readChunk(const char* begin, const char* end, ObjChunk& chunk) const;
+		void mergeChunks(std::vector<ObjChunk>& chunks);
+		void readVertexData(std::string_view arguments, ObjChunk& chunk) const;
+		void readTexCoordData(std::string_view arguments, ObjChunk& chunk) const;
+		void readNormalData(std::string_view arguments, ObjChunk& chunk) const;
+		void readFaceData(std::string_view arguments, ObjChunk& chunk) const;
+		void readCorner(std::string_view vertexDesc);
+
+		// final vertex and index data, wherever it was loaded from
+		const Vertex* getVertexData() const;
+		size_t getVertexCount() const;
+		const uint32_t* getIndexData() const;
+		size_t getIndexCount() const;
+		const GpuMaterial* getMaterialData() const;
+		size_t getMaterialCount() const;
+		const MeshLod* getLodData() const;
+		size_t getLodCount() const;
+		const uint32_t* getLodIndexData() const;
 	};
 }
\ No newline at end of file
@@ -1,89 +1,225 @@
 #include "VertexCollection.h"
+#include "Mesh.h"
+#include "VertexCompression.h"
 
 VertexCollection::VertexCollection() {
 	indexOffset = 0;
+	compactIndexOffset = 0;
 }
 
-void VertexCollection::consume(std::string type, std::vector<float> vertexData, std::vector<uint32_t> indices) {
+// vertex data may point straight into a mapped mesh cache, so it's copied in one go here
+void VertexCollection::consume(std::string type, const vkMesh::Vertex* vertexData, size_t vertexCount, const uint32_t* indices, size_t indexCount, const vkMesh::GpuMaterial* materials, size_t materialCount, vkMesh::VertexFormat format) {
 
-	// TODO: change this to be more flexible, maybe add another data type
-	int vertexCount = static_cast<int>(vertexData.size() / 8);
-	int indexCount = static_cast<int>(indices.size());
-	int lastIndexPosition = static_cast<int>(indexLump.size());
+	indexCounts.insert(std::make_pair(type.c_str(), static_cast<int>(indexCount)));
+	vertexFormats.insert(std::make_pair(type.c_str(), format));
 
-	firstIndices.insert(std::make_pair(type.c_str(), lastIndexPosition));
-	indexCounts.insert(std::make_pair(type.c_str(), indexCount));
+	// material indices are local to the mesh, shift them to where its table lands in the shared one
+	uint32_t materialOffset = static_cast<uint32_t>(materialLump.size());
+	materialLump.insert(materialLump.end(), materials, materials + materialCount);
 
-	for (float attribute : vertexData) {
-		vertexLump.push_back(attribute);
+	int baseVertex = 0;
+	if (format == vkMesh::VertexFormat::COMPACT) {
+		std::vector<vkMesh::CompactVertex> compressed;
+		meshBounds.insert(std::make_pair(type.c_str(), vkMesh::compressVertices(vertexData, vertexCount, compressed)));
+		for (vkMesh::CompactVertex& vertex : compressed) {
+			vertex.materialIndex += materialOffset;
+		}
+		compactLump.insert(compactLump.end(), compressed.begin(), compressed.end());
+
+		baseVertex = compactIndexOffset;
+		compactIndexOffset += static_cast<int>(vertexCount);
+	}
+	else {
+		size_t firstVertex = vertexLump.size();
+		vertexLump.insert(vertexLump.end(), vertexData, vertexData + vertexCount);
+		for (size_t i = firstVertex; i < vertexLump.size(); i++) {
+			vertexLump[i].materialIndex += materialOffset;
+		}
+
+		baseVertex = indexOffset;
+		indexOffset += static_cast<int>(vertexCount);
+	}
+
+	baseVertices.insert(std::make_pair(type.c_str(), baseVertex));
+
+	// sphere around the middle of the box, for picking levels of detail
+	glm::vec3 minimum = vertexCount > 0 ? vertexData[0].position : glm::vec3(0.0f);
+	glm::vec3 maximum = minimum;
+	for (size_t i = 1; i < vertexCount; i++) {
+		minimum = glm::min(minimum, vertexData[i].position);
+		maximum = glm::max(maximum, vertexData[i].position);
+	}
+	glm::vec3 center = (minimum + maximum) * 0.5f;
+	float radius = 0.0f;
+	for (size_t i = 0; i < vertexCount; i++) {
+		radius = std::max(radius, glm::length(vertexData[i].position - center));
+	}
+	boundingSpheres.insert(std::make_pair(type.c_str(), glm::vec4(center, radius)));
+
+	// indices stay local to the mesh, the draw adds the base vertex back
+	if (vertexCount <= SHORT_INDEX_VERTEX_LIMIT) {
+		indexTypes.insert(std::make_pair(type.c_str(), vk::IndexType::eUint16));
+	}
+	else {
+		indexTypes.insert(std::make_pair(type.c_str(), vk::IndexType::eUint32));
+	}
+
+	int firstIndex = static_cast<int>(appendIndices(indexTypes.at(type), indices, indexCount));
+	firstIndices.insert(std::make_pair(type.c_str(), firstIndex));
+	meshLods[type] = { vkMesh::MeshLod{ static_cast<uint32_t>(firstIndex), static_cast<uint32_t>(indexCount), 0.0f } };
+}
+
+size_t VertexCollection::appendIndices(vk::IndexType indexType, const uint32_t* indices, size_t indexCount) {
+	if (indexType == vk::IndexType::eUint16) {
+		size_t firstIndex = shortIndexLump.size();
+		shortIndexLump.reserve(shortIndexLump.size() + indexCount);
+		for (size_t i = 0; i < indexCount; i++) {
+			shortIndexLump.push_back(static_cast<uint16_t>(indices[i]));
+		}
+		return firstIndex;
 	}
 
-	for (uint32_t index : indices) {
-		indexLump.push_back(index + indexOffset);
+	size_t firstIndex = indexLump.size();
+	indexLump.insert(indexLump.end(), indices, indices + indexCount);
+	return firstIndex;
+}
+
+void VertexCollection::consumeLods(std::string type, const vkMesh::MeshLod* lods, size_t lodCount, const uint32_t* lodIndices) {
+	vk::IndexType indexType = indexTypes.at(type);
+	std::vector<vkMesh::MeshLod>& levels = meshLods.at(type);
+	for (size_t i = 0; i < lodCount; i++) {
+		size_t firstIndex = appendIndices(indexType, lodIndices + lods[i].firstIndex, lods[i].indexCount);
+		levels.push_back(vkMesh::MeshLod{ static_cast<uint32_t>(firstIndex), lods[i].indexCount, lods[i].error });
 	}
+}
+
+void VertexCollection::buildClusters(std::string type, const vkMesh::Vertex* vertexData, size_t vertexCount, const uint32_t* indices, size_t indexCount) {
+	uint32_t firstMeshlet = static_cast<uint32_t>(meshletLump.meshlets.size());
+	vkMesh::buildMeshlets(vertexData, vertexCount, indices, indexCount, meshletLump);
 
-	indexOffset += vertexCount;
+	firstMeshlets.insert(std::make_pair(type.c_str(), firstMeshlet));
+	meshletCounts.insert(std::make_pair(type.c_str(), static_cast<uint32_t>(meshletLump.meshlets.size()) - firstMeshlet));
+}
+
+Buffer VertexCollection::uploadLump(const void* data, vk::DeviceSize size, vk::BufferUsageFlags usage, const FinalizationInput& input, vkUtilities::UploadBatch& batch) {
+	BufferInput inputChunk;
+	inputChunk.device = this->logicalDevice;
+	inputChunk.physicalDevice = input.physicalDevice;
+	inputChunk.size = size;
+	// lumps are copied out again when the defragmenter moves them
+	inputChunk.usage = vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst | usage;
+	inputChunk.memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+	inputChunk.allocator = input.allocator;
+	inputChunk.category = vkUtilities::MemoryCategory::MESH;
+	Buffer deviceBuffer = vkUtilities::createBuffer(inputChunk);
+
+	batch.copyBuffer(data, size, deviceBuffer.buffer, 0);
+	batch.releaseBuffer(deviceBuffer.buffer);
+
+	return deviceBuffer;
 }
 
 void VertexCollection::finalize(FinalizationInput input) {
 	this->logicalDevice = input.device;
 
 	// If no data is in the vertex or index buffer, report and return
-	if (vertexLump.size() <= 0 || indexLump.size() <= 0) {
+	if ((vertexLump.size() <= 0 && compactLump.size() <= 0) || (indexLump.size() <= 0 && shortIndexLump.size() <= 0)) {
 		std::cout << "VertexCollevetion: no vertices found, exiting early" << std::endl;
 		return;
 	}
 	
+	// every lump is copied by the same submission
+	vkUtilities::UploadBatchInput batchInput;
+	batchInput.device = input.device;
+	batchInput.commandBuffer = input.commandBuffer;
+	batchInput.queue = input.queue;
+	batchInput.queueFamily = input.uploadQueues.graphicsFamily;
+	batchInput.ownerFamily = input.uploadQueues.graphicsFamily;
+	batchInput.stagingRing = input.stagingRing;
+	if (input.uploadQueues.isDedicated()) {
+		batchInput.commandBuffer = nullptr;
+		batchInput.queue = input.uploadQueues.transferQueue;
+		batchInput.queueFamily = input.uploadQueues.transferFamily;
+	}
+	vkUtilities::UploadBatch batch;
+	batch.begin(batchInput);
+
 	// Vertex Buffer
-	BufferInput inputChunk;
-	inputChunk.device = this->logicalDevice;
-	inputChunk.physicalDevice = input.physicalDevice;
-	inputChunk.size = sizeof(float) * vertexLump.size();
-	inputChunk.usage = vk::BufferUsageFlagBits::eTransferSrc;
-	inputChunk.memoryProperties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
-	Buffer stagingBuffer = vkUtilities::createBuffer(inputChunk);
+	if (vertexLump.size() > 0) {
+		vertexBuffer = uploadLump(vertexLump.data(), sizeof(vkMesh::Vertex) * vertexLump.size(), vk::BufferUsageFlagBits::eVertexBuffer, input, batch);
+	}
 
-	void* memoryLocation = logicalDevice.mapMemory(stagingBuffer.bufferMemory, 0, inputChunk.size);
-	memcpy(memoryLocation, vertexLump.data(), inputChunk.size);
-	logicalDevice.unmapMemory(stagingBuffer.bufferMemory);
+	// Position Buffer
+	if (emitPositionStream && vertexLump.size() > 0) {
+		std::vector<vkMesh::PositionVertex> positionLump;
+		positionLump.reserve(vertexLump.size());
+		for (const vkMesh::Vertex& vertex : vertexLump) {
+			positionLump.push_back(vkMesh::PositionVertex{ vertex.position });
+		}
 
-	inputChunk.usage = vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer;
-	inputChunk.memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal;
-	vertexBuffer = vkUtilities::createBuffer(inputChunk);
+		positionBuffer = uploadLump(positionLump.data(), sizeof(vkMesh::PositionVertex) * positionLump.size(), vk::BufferUsageFlagBits::eVertexBuffer, input, batch);
+	}
 
-	vkUtilities::copyBuffer(stagingBuffer, vertexBuffer, inputChunk.size, input.queue, input.commandBuffer);
+	// Compact Vertex Buffer
+	if (compactLump.size() > 0) {
+		compactVertexBuffer = uploadLump(compactLump.data(), sizeof(vkMesh::CompactVertex) * compactLump.size(), vk::BufferUsageFlagBits::eVertexBuffer, input, batch);
+	}
 
-	logicalDevice.destroyBuffer(stagingBuffer.buffer);
-	logicalDevice.freeMemory(stagingBuffer.bufferMemory);
+	// Index Buffers
+	if (indexLump.size() > 0) {
+		indexBuffer = uploadLump(indexLump.data(), sizeof(uint32_t) * indexLump.size(), vk::BufferUsageFlagBits::eIndexBuffer, input, batch);
+	}
 
-	// Index Buffer
-	inputChunk.device = this->logicalDevice;
-	inputChunk.physicalDevice = input.physicalDevice;
-	inputChunk.size = sizeof(uint32_t) * indexLump.size();
-	inputChunk.usage = vk::BufferUsageFlagBits::eTransferSrc;
-	inputChunk.memoryProperties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
-	stagingBuffer = vkUtilities::createBuffer(inputChunk);
+	if (shortIndexLump.size() > 0) {
+		shortIndexBuffer = uploadLump(shortIndexLump.data(), sizeof(uint16_t) * shortIndexLump.size(), vk::BufferUsageFlagBits::eIndexBuffer, input, batch);
+	}
 
-	memoryLocation = logicalDevice.mapMemory(stagingBuffer.bufferMemory, 0, inputChunk.size);
-	memcpy(memoryLocation, indexLump.data(), inputChunk.size);
-	logicalDevice.unmapMemory(stagingBuffer.bufferMemory);
+	// Material Buffer
+	materialBufferSize = sizeof(vkMesh::GpuMaterial) * materialLump.size();
+	materialBuffer = uploadLump(materialLump.data(), materialBufferSize, vk::BufferUsageFlagBits::eStorageBuffer, input, batch);
 
-	inputChunk.usage = vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer;
-	inputChunk.memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal;
-	indexBuffer = vkUtilities::createBuffer(inputChunk);
+	// Meshlet Buffers
+	if (meshletLump.meshlets.size() > 0) {
+		meshletBufferSize = sizeof(vkMesh::GpuMeshlet) * meshletLump.meshlets.size();
+		meshletBuffer = uploadLump(meshletLump.meshlets.data(), meshletBufferSize, vk::BufferUsageFlagBits::eStorageBuffer, input, batch);
 
-	vkUtilities::copyBuffer(stagingBuffer, indexBuffer, inputChunk.size, input.queue, input.commandBuffer);
+		meshletVertexBufferSize = sizeof(uint32_t) * meshletLump.vertices.size();
+		meshletVertexBuffer = uploadLump(meshletLump.vertices.data(), meshletVertexBufferSize, vk::BufferUsageFlagBits::eStorageBuffer, input, batch);
 
-	logicalDevice.destroyBuffer(stagingBuffer.buffer);
-	logicalDevice.freeMemory(stagingBuffer.bufferMemory);
+		meshletTriangleBufferSize = sizeof(uint32_t) * meshletLump.triangles.size();
+		meshletTriangleBuffer = uploadLump(meshletLump.triangles.data(), meshletTriangleBufferSize, vk::BufferUsageFlagBits::eStorageBuffer, input, batch);
+	}
+
+	batch.wait();
+
+	// copied on the transfer family, so graphics has to take the buffers over before drawing from them
+	if (batch.needsAcquire()) {
+		vkUtilities::UploadBatchInput acquireInput = batchInput;
+		acquireInput.commandBuffer = input.commandBuffer;
+		acquireInput.queue = input.queue;
+		acquireInput.queueFamily = input.uploadQueues.graphicsFamily;
+		vkUtilities::UploadBatch acquire;
+		acquire.begin(acquireInput);
+		batch.recordAcquire(acquire.getCommandBuffer());
+		acquire.wait();
+	}
+	batch.destroy();
 
 	vertexLump.clear();
+	compactLump.clear();
+	meshletLump = vkMesh::MeshletData();
+	indexLump.clear();
+	shortIndexLump.clear();
+	materialLump.clear();
 }
 
-VertexCollection::~VertexCollection() {
-	logicalDevice.destroyBuffer(vertexBuffer.buffer);
-	logicalDevice.freeMemory(vertexBuffer.bufferMemory);
+std::vector<Buffer*> VertexCollection::getBuffers() {
+	return { &vertexBuffer, &positionBuffer, &compactVertexBuffer, &indexBuffer, &shortIndexBuffer, &materialBuffer, &meshletBuffer, &meshletVertexBuffer, &meshletTriangleBuffer };
+}
 
-	logicalDevice.destroyBuffer(indexBuffer.buffer);
-	logicalDevice.freeMemory(indexBuffer.bufferMemory);
-}
\ No newline at end of file
+VertexCollection::~VertexCollection() {
+	// buffers that were never made are null handles, which destroy and free ignore
+	for (Buffer* buffer : getBuffers()) {
+		vkUtilities::destroyBuffer(logicalDevice, *buffer);
+	}
+}
@@ -1,29 +1,85 @@
 #pragma once
 #include "../config.h"
 #include "../utilities/Memory.h"
+#include "../utilities/UploadBatch.h"
+#include "Mesh.h"
+#include "Meshlet.h"
 
 struct FinalizationInput {
 	vk::Device device;
 		vk::PhysicalDevice physicalDevice;
 		vk::Queue queue;
 		vk::CommandBuffer commandBuffer;
+		// every lump is staged through it and uploaded in one batch
+		vkUtilities::StagingRing* stagingRing;
+		// the batch runs on the transfer queue when it's dedicated, and is acquired on queue after
+		vkUtilities::UploadQueues uploadQueues;
+		// where every lump's buffer is placed
+		vkUtilities::DeviceAllocator* allocator = nullptr;
 };
 
+// meshes with at most this many vertices go in the 16 bit index buffer
+static const size_t SHORT_INDEX_VERTEX_LIMIT = 65536;
+
 class VertexCollection {
 	public:
 		VertexCollection();
 		~VertexCollection();
-		void consume(std::string type, std::vector<float> vertexData, std::vector<uint32_t> indices);
+		void consume(std::string type, const vkMesh::Vertex* vertexData, size_t vertexCount, const uint32_t* indices, size_t indexCount, const vkMesh::GpuMaterial* materials, size_t materialCount, vkMesh::VertexFormat format = vkMesh::VertexFormat::FLOAT);
+		// adds coarser levels of an already consumed mesh, their indices count from the start of lodIndices
+		void consumeLods(std::string type, const vkMesh::MeshLod* lods, size_t lodCount, const uint32_t* lodIndices);
+		// splits an already consumed mesh into meshlets for cluster culling
+		void buildClusters(std::string type, const vkMesh::Vertex* vertexData, size_t vertexCount, const uint32_t* indices, size_t indexCount);
 		void finalize(FinalizationInput input);
+		// every lump's buffer, made or not, for whatever needs to move or free them all
+		std::vector<Buffer*> getBuffers();
 		Buffer vertexBuffer;
+		// set before finalize to also upload a positions only copy of the float vertices for depth only passes
+		bool emitPositionStream = false;
+		Buffer positionBuffer;
+		// vertices of meshes consumed as VertexFormat::COMPACT, indexed by the same index buffer
+		Buffer compactVertexBuffer;
+		// meshes draw with local indices plus a base vertex, and any mesh small enough gets 16 bit ones
 		Buffer indexBuffer;
+		Buffer shortIndexBuffer;
+		// every mesh's materials back to back, vertices index straight into it
+		Buffer materialBuffer;
+		vk::DeviceSize materialBufferSize = 0;
 		std::unordered_map<std::string, int> firstIndices;
 		std::unordered_map<std::string, int> indexCounts;
+		std::unordered_map<std::string, int> baseVertices;
+		std::unordered_map<std::string, vk::IndexType> indexTypes;
+		std::unordered_map<std::string, vkMesh::VertexFormat> vertexFormats;
+		// only compact meshes have bounds
+		std::unordered_map<std::string, vkMesh::MeshBounds> meshBounds;
+		// every mesh's levels of detail, full detail first, in the same index buffer as the mesh itself
+		std::unordered_map<std::string, std::vector<vkMesh::MeshLod>> meshLods;
+		// model space xyz center and w radius, for picking a level
+		std::unordered_map<std::string, glm::vec4> boundingSpheres;
+		// meshlets of the meshes that asked for cluster culling
+		Buffer meshletBuffer;
+		Buffer meshletVertexBuffer;
+		Buffer meshletTriangleBuffer;
+		vk::DeviceSize meshletBufferSize = 0;
+		vk::DeviceSize meshletVertexBufferSize = 0;
+		vk::DeviceSize meshletTriangleBufferSize = 0;
+		std::unordered_map<std::string, uint32_t> firstMeshlets;
+		std::unordered_map<std::string, uint32_t> meshletCounts;
 
 	private:
+		Buffer uploadLump(const void* data, vk::DeviceSize size, vk::BufferUsageFlags usage, const FinalizationInput& input, vkUtilities::UploadBatch& batch);
+		// returns where the indices start in the lump for their type
+		size_t appendIndices(vk::IndexType indexType, const uint32_t* indices, size_t indexCount);
+
+		// each vertex buffer numbers its vertices from zero
 		int indexOffset;
+		int compactIndexOffset;
 		vk::Device logicalDevice;
-		std::vector<float> vertexLump;
+		std::vector<vkMesh::Vertex> vertexLump;
+		std::vector<vkMesh::CompactVertex> compactLump;
 		std::vector<uint32_t> indexLump;
+		std::vector<uint16_t> shortIndexLump;
+		std::vector<vkMesh::GpuMaterial> materialLump;
+		vkMesh::MeshletData meshletLump;
 
-};
\ No newline at end of file
+};
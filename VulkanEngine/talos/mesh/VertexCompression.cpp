@@ -0,0 +1,88 @@
+#include "VertexCompression.h"
+#include <glm/gtc/packing.hpp>
+#include <cmath>
+
+namespace vkMesh {
+	namespace {
+		float signNotZero(float value) {
+			return value >= 0.0f ? 1.0f : -1.0f;
+		}
+	}
+
+	MeshBounds compressVertices(const Vertex* vertices, size_t vertexCount, std::vector<CompactVertex>& compressed) {
+		MeshBounds bounds{ glm::vec4(0.0f), glm::vec4(0.0f) };
+		compressed.clear();
+		if (vertexCount == 0) {
+			return bounds;
+		}
+
+		glm::vec3 minimum = vertices[0].position;
+		glm::vec3 maximum = vertices[0].position;
+		for (size_t i = 1; i < vertexCount; i++) {
+			minimum = glm::min(minimum, vertices[i].position);
+			maximum = glm::max(maximum, vertices[i].position);
+		}
+
+		glm::vec3 extent = maximum - minimum;
+		bounds.minimum = glm::vec4(minimum, 0.0f);
+		bounds.extent = glm::vec4(extent, 0.0f);
+
+		// a flat axis has nothing to quantize, every vertex sits on the minimum
+		glm::vec3 inverseExtent;
+		for (int axis = 0; axis < 3; axis++) {
+			inverseExtent[axis] = extent[axis] > 0.0f ? 1.0f / extent[axis] : 0.0f;
+		}
+
+		compressed.resize(vertexCount);
+		for (size_t i = 0; i < vertexCount; i++) {
+			const Vertex& vertex = vertices[i];
+			CompactVertex& packed = compressed[i];
+
+			glm::vec3 normalized = (vertex.position - minimum) * inverseExtent;
+			packed.position.x = glm::packUnorm1x16(normalized.x);
+			packed.position.y = glm::packUnorm1x16(normalized.y);
+			packed.position.z = glm::packUnorm1x16(normalized.z);
+			packed.position.w = 0;
+
+			packed.normal = encodeOctahedral(vertex.normal);
+
+			packed.texCoord.u = glm::packHalf1x16(vertex.texCoord.x);
+			packed.texCoord.v = glm::packHalf1x16(vertex.texCoord.y);
+
+			packed.materialIndex = vertex.materialIndex;
+		}
+
+		return bounds;
+	}
+
+	OctahedralNormal encodeOctahedral(glm::vec3 normal) {
+		float sum = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+		if (sum <= 0.0f) {
+			return OctahedralNormal{ 0, 0 };
+		}
+
+		// project onto the octahedron, then fold the lower half over the diagonals
+		float x = normal.x / sum;
+		float y = normal.y / sum;
+		if (normal.z < 0.0f) {
+			float foldedX = (1.0f - std::fabs(y)) * signNotZero(x);
+			float foldedY = (1.0f - std::fabs(x)) * signNotZero(y);
+			x = foldedX;
+			y = foldedY;
+		}
+
+		return OctahedralNormal{ static_cast<int16_t>(glm::packSnorm1x16(x)), static_cast<int16_t>(glm::packSnorm1x16(y)) };
+	}
+
+	glm::vec3 decodeOctahedral(OctahedralNormal encoded) {
+		float x = glm::unpackSnorm1x16(static_cast<uint16_t>(encoded.x));
+		float y = glm::unpackSnorm1x16(static_cast<uint16_t>(encoded.y));
+		glm::vec3 normal(x, y, 1.0f - std::fabs(x) - std::fabs(y));
+
+		float fold = std::max(-normal.z, 0.0f);
+		normal.x += normal.x >= 0.0f ? -fold : fold;
+		normal.y += normal.y >= 0.0f ? -fold : fold;
+
+		return glm::normalize(normal);
+	}
+}
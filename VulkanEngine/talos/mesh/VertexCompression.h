@@ -0,0 +1,16 @@
+#pragma once
+#include "../config.h"
+#include "Mesh.h"
+
+/*
+	Packs float vertices into CompactVertex: positions are quantized against the
+	mesh's bounding box, normals are octahedral encoded and texture coordinates
+	become half floats. The shaders built with COMPACT_VERTICES undo all three.
+*/
+namespace vkMesh {
+	// fills compressed and returns the bounds the vertex shader needs to decode its positions
+	MeshBounds compressVertices(const Vertex* vertices, size_t vertexCount, std::vector<CompactVertex>& compressed);
+
+	OctahedralNormal encodeOctahedral(glm::vec3 normal);
+	glm::vec3 decodeOctahedral(OctahedralNormal encoded);
+}
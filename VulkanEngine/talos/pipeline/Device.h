@@ -30,6 +30,11 @@ namespace vkInit {
 		return requiredExtensions.empty();
 	}
 
+	// the budget comes through vkGetPhysicalDeviceMemoryProperties2, which needs vulkan 1.1
+	bool supportsMemoryBudget(const vk::PhysicalDevice& device) {
+		return device.getProperties().apiVersion >= VK_API_VERSION_1_1 && checkDeviceExtensionSupport(device, { VK_EXT_MEMORY_BUDGET_EXTENSION_NAME });
+	}
+
 	bool isSuitable(const vk::PhysicalDevice& device, const std::vector<const char*>& requestedExtensions, bool debug = false) {
 		if (debug) {
 			std::cout << "We are requesting the following " << requestedExtensions.size() << " device extensions" << std::endl;
@@ -91,6 +96,10 @@ namespace vkInit {
 		if (queueFamilyIndices.graphicsFamily.value() != queueFamilyIndices.presentFamily.value()) {
 			uniqueIndices.push_back(queueFamilyIndices.presentFamily.value());
 		}
+		// findQueueFamilies never picks the graphics or present family for transfers
+		if (queueFamilyIndices.transferFamily.has_value()) {
+			uniqueIndices.push_back(queueFamilyIndices.transferFamily.value());
+		}
 		float queuePriority = 1.0f;
 
 		// create more dynamic information
@@ -110,10 +119,20 @@ namespace vkInit {
 		std::vector<const char*> deviceExtensions{
 			VK_KHR_SWAPCHAIN_EXTENSION_NAME
 		};
+		// heap budgets and usage for the allocator's reports, when the driver has them
+		if (supportsMemoryBudget(physicalDevice)) {
+			deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		}
 
 		// define device features
 		vk::PhysicalDeviceFeatures deviceFeatures = vk::PhysicalDeviceFeatures();
 		// can enable features as needed here
+		// cluster culled meshes issue one indirect draw per instance, batched when the device allows it
+		deviceFeatures.multiDrawIndirect = physicalDevice.getFeatures().multiDrawIndirect;
+		// cooked textures upload as BC blocks where they can, textures fall back to RGBA8 without it
+		deviceFeatures.textureCompressionBC = physicalDevice.getFeatures().textureCompressionBC;
+		// mipmapped textures sample anisotropically when the device allows it
+		deviceFeatures.samplerAnisotropy = physicalDevice.getFeatures().samplerAnisotropy;
 
 		// set up enabled layers and extensions
 		std::vector<const char*> enabledLayers;
@@ -156,9 +175,11 @@ namespace vkInit {
 		// we want default graphics queue
 		vk::Queue graphicsQueue = device.getQueue(indices.graphicsFamily.value(), 0);
 		vk::Queue presentQueue = device.getQueue(indices.presentFamily.value(), 0);
+		// uploads fall back to the graphics queue on devices with one family
+		vk::Queue transferQueue = indices.transferFamily.has_value() ? device.getQueue(indices.transferFamily.value(), 0) : graphicsQueue;
 
-		// add both queues to vector
-		std::vector<vk::Queue> queues = { graphicsQueue, presentQueue };
+		// add all three queues to vector
+		std::vector<vk::Queue> queues = { graphicsQueue, presentQueue, transferQueue };
 		return queues;
 	}
 	
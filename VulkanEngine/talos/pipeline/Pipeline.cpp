@@ -187,6 +187,11 @@ namespace vkInit {
 
 	void PipelineBuilder::resetDescriptorSetLayouts() {
 		descriptorSetLayouts.clear();
+		pushConstantRanges.clear();
+	}
+
+	void PipelineBuilder::addPushConstantRange(vk::PushConstantRange pushConstantRange) {
+		pushConstantRanges.push_back(pushConstantRange);
 	}
 
 	vkInit::GraphicsPipelineOutBundle PipelineBuilder::build() {
@@ -322,7 +327,8 @@ namespace vkInit {
 		layoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
 		layoutInfo.pSetLayouts = descriptorSetLayouts.data();
 
-		layoutInfo.pushConstantRangeCount = 0;
+		layoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+		layoutInfo.pPushConstantRanges = pushConstantRanges.data();
 
 		try {
 			return device.createPipelineLayout(layoutInfo);
@@ -54,6 +54,8 @@ namespace vkInit {
 
 			void resetDescriptorSetLayouts();
 
+			void addPushConstantRange(vk::PushConstantRange pushConstantRange);
+
 			void setDepthTest(bool depthTest) { shouldDepthTest = depthTest; }
 
 			void setColorOverwrite(bool overwrite) { shouldClearColorBuffer = overwrite; }
@@ -112,6 +114,7 @@ namespace vkInit {
 			vk::PipelineColorBlendStateCreateInfo colorBlending = {};
 
 			std::vector<vk::DescriptorSetLayout> descriptorSetLayouts;
+			std::vector<vk::PushConstantRange> pushConstantRanges;
 
 			bool shouldDepthTest = true;
 			bool shouldClearColorBuffer = true;
@@ -1,5 +1,6 @@
 #pragma once
 #include "../config.h"
+#include "../mesh/Mesh.h"
 
 namespace vkInit {
 	struct PipelineInput {
@@ -14,6 +15,9 @@ namespace vkInit {
 		vk::Extent2D size;
 		vk::VertexInputBindingDescription vertexBindingDescription;
 		std::vector<vk::VertexInputAttributeDescription> vertexAttributeDescription{};
+		// compact variants are drawn inside the float pipeline's render pass, so they only keep their pipeline and layout
+		vkMesh::VertexFormat vertexFormat = vkMesh::VertexFormat::FLOAT;
+		std::vector<vk::PushConstantRange> pushConstantRanges{};
 		vk::ImageLayout imageInitialLayout;
 		vk::ImageLayout imageFinalLayout;
 	};
@@ -0,0 +1,153 @@
+#include "AssetArchive.h"
+#include "CacheFile.h"
+#include <algorithm>
+
+namespace vkUtilities {
+	namespace {
+		AssetArchive mountedArchive;
+	}
+
+	uint64_t hashAssetName(const std::string& filepath) {
+		size_t start = 0;
+		while (filepath.compare(start, 2, "./") == 0 || filepath.compare(start, 2, ".\\") == 0) {
+			start += 2;
+		}
+
+		uint64_t hash = FNV_OFFSET_BASIS;
+		for (size_t i = start; i < filepath.size(); i++) {
+			char character = filepath[i] == '\\' ? '/' : filepath[i];
+			hash = hashBytes(hash, &character, 1);
+		}
+
+		return hash;
+	}
+
+	bool AssetArchive::open(const std::string& filepath) {
+		close();
+
+		// the archive itself always comes off the disk
+		if (!file.openFromDisk(filepath) || file.getSize() < sizeof(ArchiveHeader)) {
+			file.close();
+			return false;
+		}
+
+		const ArchiveHeader* candidate = reinterpret_cast<const ArchiveHeader*>(file.getData());
+		size_t tocSize = static_cast<size_t>(candidate->entryCount) * sizeof(ArchiveEntry);
+		if (candidate->magic != ASSET_ARCHIVE_MAGIC || candidate->version != ASSET_ARCHIVE_VERSION
+			|| candidate->tocOffset > file.getSize() || tocSize > file.getSize() - candidate->tocOffset) {
+			std::cout << "\"" << filepath << "\" is not a talos asset archive of version " << ASSET_ARCHIVE_VERSION << std::endl;
+			file.close();
+			return false;
+		}
+
+		header = candidate;
+		entries = reinterpret_cast<const ArchiveEntry*>(file.getData() + header->tocOffset);
+		return true;
+	}
+
+	void AssetArchive::close() {
+		file.close();
+		header = nullptr;
+		entries = nullptr;
+	}
+
+	const ArchiveEntry* AssetArchive::find(const std::string& filepath) const {
+		if (!header) {
+			return nullptr;
+		}
+
+		uint64_t nameHash = hashAssetName(filepath);
+		const ArchiveEntry* end = entries + header->entryCount;
+		const ArchiveEntry* entry = std::lower_bound(entries, end, nameHash, [](const ArchiveEntry& entry, uint64_t hash) {
+			return entry.nameHash < hash;
+		});
+
+		if (entry == end || entry->nameHash != nameHash) {
+			return nullptr;
+		}
+
+		return entry;
+	}
+
+	const char* AssetArchive::getEntryData(const ArchiveEntry& entry) const {
+		return file.getData() + entry.offset;
+	}
+
+	size_t AssetArchive::getEntryCount() const {
+		return header ? static_cast<size_t>(header->entryCount) : 0;
+	}
+
+	bool AssetArchive::write(const std::string& filepath, const std::vector<std::string>& assetPaths) {
+		static const char zeros[ASSET_ARCHIVE_ALIGNMENT] = {};
+
+		std::vector<MappedFile> sources(assetPaths.size());
+		std::vector<ArchiveEntry> toc;
+		std::vector<FilePiece> pieces;
+
+		ArchiveHeader header;
+		header.magic = ASSET_ARCHIVE_MAGIC;
+		header.version = ASSET_ARCHIVE_VERSION;
+		pieces.push_back(FilePiece{ &header, sizeof(ArchiveHeader) });
+
+		uint64_t offset = sizeof(ArchiveHeader);
+		std::unordered_map<uint64_t, std::string> names;
+		for (size_t i = 0; i < assetPaths.size(); i++) {
+			uint64_t nameHash = hashAssetName(assetPaths[i]);
+			if (names.count(nameHash)) {
+				// the same file named twice is fine, two files sharing a hash is not
+				if (names.at(nameHash) != assetPaths[i]) {
+					std::cout << "\"" << assetPaths[i] << "\" and \"" << names.at(nameHash) << "\" hash the same, rename one of them" << std::endl;
+					return false;
+				}
+				continue;
+			}
+			names[nameHash] = assetPaths[i];
+
+			if (!sources[i].openFromDisk(assetPaths[i])) {
+				std::cout << "Failed to load \"" << assetPaths[i] << "\"" << std::endl;
+				return false;
+			}
+
+			uint64_t padding = (ASSET_ARCHIVE_ALIGNMENT - offset % ASSET_ARCHIVE_ALIGNMENT) % ASSET_ARCHIVE_ALIGNMENT;
+			pieces.push_back(FilePiece{ zeros, static_cast<size_t>(padding) });
+			offset += padding;
+
+			ArchiveEntry entry;
+			entry.nameHash = nameHash;
+			entry.offset = offset;
+			entry.storedSize = sources[i].getSize();
+			entry.size = sources[i].getSize();
+			entry.compression = static_cast<uint32_t>(ArchiveCompression::NONE);
+			entry.padding = 0;
+			toc.push_back(entry);
+
+			pieces.push_back(FilePiece{ sources[i].getData(), sources[i].getSize() });
+			offset += entry.storedSize;
+		}
+
+		uint64_t padding = (ASSET_ARCHIVE_ALIGNMENT - offset % ASSET_ARCHIVE_ALIGNMENT) % ASSET_ARCHIVE_ALIGNMENT;
+		pieces.push_back(FilePiece{ zeros, static_cast<size_t>(padding) });
+		offset += padding;
+
+		std::sort(toc.begin(), toc.end(), [](const ArchiveEntry& a, const ArchiveEntry& b) {
+			return a.nameHash < b.nameHash;
+		});
+		header.entryCount = toc.size();
+		header.tocOffset = offset;
+		pieces.push_back(FilePiece{ toc.data(), toc.size() * sizeof(ArchiveEntry) });
+
+		return writeCacheFile(filepath, pieces);
+	}
+
+	bool mountAssetArchive(const std::string& filepath) {
+		return mountedArchive.open(filepath);
+	}
+
+	void unmountAssetArchive() {
+		mountedArchive.close();
+	}
+
+	const AssetArchive* getMountedArchive() {
+		return mountedArchive.isOpen() ? &mountedArchive : nullptr;
+	}
+}
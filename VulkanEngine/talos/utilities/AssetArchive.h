@@ -0,0 +1,73 @@
+#pragma once
+#include "../config.h"
+#include "MappedFile.h"
+
+/*
+	Single file pack of assets, mapped once and read in place. The file is a
+	header, every asset's bytes back to back, then a table of contents sorted
+	by the hash of each asset's path so a lookup is a binary search. While an
+	archive is mounted, MappedFile (and everything built on it) resolves paths
+	through it before touching the disk.
+*/
+namespace vkUtilities {
+	static const uint32_t ASSET_ARCHIVE_MAGIC = 0x4B415054; // "TPAK"
+	static const uint32_t ASSET_ARCHIVE_VERSION = 1;
+	static const char* ASSET_ARCHIVE_PATH = "assets.tpak";
+
+	// asset bytes start on this boundary so cooked headers can be read in place
+	static const uint64_t ASSET_ARCHIVE_ALIGNMENT = 16;
+
+	enum class ArchiveCompression : uint32_t {
+		NONE = 0
+	};
+
+	struct ArchiveHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t entryCount;
+		uint64_t tocOffset;
+	};
+
+	struct ArchiveEntry {
+		uint64_t nameHash;
+		uint64_t offset;
+		// bytes in the archive, and bytes once decompressed
+		uint64_t storedSize;
+		uint64_t size;
+		uint32_t compression;
+		uint32_t padding;
+	};
+
+	// paths hash the same whichever slashes they use or if they start with "./"
+	uint64_t hashAssetName(const std::string& filepath);
+
+	class AssetArchive {
+	public:
+		// returns false if the file is missing or isn't an archive of this version
+		bool open(const std::string& filepath);
+		void close();
+		bool isOpen() const { return header != nullptr; }
+
+		// null if the archive doesn't hold the path
+		const ArchiveEntry* find(const std::string& filepath) const;
+		const char* getEntryData(const ArchiveEntry& entry) const;
+		size_t getEntryCount() const;
+
+		// packs the files at the given paths, they keep those paths as their names
+		static bool write(const std::string& filepath, const std::vector<std::string>& assetPaths);
+
+	private:
+		MappedFile file;
+		const ArchiveHeader* header = nullptr;
+		const ArchiveEntry* entries = nullptr;
+	};
+
+	/*
+		Mount before any loading starts and unmount after it's all done: lookups
+		don't lock, and files opened through the archive point into its mapping.
+		A missing archive isn't an error, loose files are used instead.
+	*/
+	bool mountAssetArchive(const std::string& filepath = ASSET_ARCHIVE_PATH);
+	void unmountAssetArchive();
+	const AssetArchive* getMountedArchive();
+}
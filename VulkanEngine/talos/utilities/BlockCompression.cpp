@@ -0,0 +1,318 @@
+#include "BlockCompression.h"
+#include <algorithm>
+#include <cstring>
+
+namespace vkUtilities {
+	namespace {
+		// the format needs the last match to start this far from the end and the last five bytes to be literals
+		const size_t MATCH_FIND_LIMIT = 12;
+		const size_t LAST_LITERALS = 5;
+		const size_t MIN_MATCH = 4;
+		const size_t MAX_OFFSET = 65535;
+		const uint32_t HASH_BITS = 14;
+		const uint32_t NO_POSITION = 0xFFFFFFFF;
+
+		inline uint32_t read32(const uint8_t* pointer) {
+			uint32_t value;
+			memcpy(&value, pointer, sizeof(value));
+			return value;
+		}
+
+		inline uint32_t hashSequence(uint32_t sequence) {
+			return (sequence * 2654435761u) >> (32 - HASH_BITS);
+		}
+
+		// 15 in the token, then runs of 255 and a final remainder byte
+		inline uint8_t* writeLength(uint8_t* output, size_t length) {
+			while (length >= 255) {
+				*output++ = 255;
+				length -= 255;
+			}
+			*output++ = static_cast<uint8_t>(length);
+			return output;
+		}
+
+		inline bool readLength(const uint8_t*& input, const uint8_t* inputEnd, size_t& length) {
+			uint8_t byte;
+			do {
+				if (input >= inputEnd) {
+					return false;
+				}
+				byte = *input++;
+				length += byte;
+			} while (byte == 255);
+
+			return true;
+		}
+
+		const uint64_t* getBlockOffsets(const char* stream) {
+			return reinterpret_cast<const uint64_t*>(stream + sizeof(BlockStreamHeader));
+		}
+	}
+
+	size_t lz4CompressBound(size_t size) {
+		return size + size / 255 + 16;
+	}
+
+	size_t lz4Compress(const char* source, size_t sourceSize, char* destination, size_t capacity) {
+		const uint8_t* input = reinterpret_cast<const uint8_t*>(source);
+		const uint8_t* inputEnd = input + sourceSize;
+		const uint8_t* anchor = input;
+		const uint8_t* position = input;
+		uint8_t* output = reinterpret_cast<uint8_t*>(destination);
+		uint8_t* outputEnd = output + capacity;
+
+		// positions are block relative, blocks are far smaller than 4GB
+		std::vector<uint32_t> table(size_t(1) << HASH_BITS, NO_POSITION);
+
+		if (sourceSize > MATCH_FIND_LIMIT) {
+			const uint8_t* matchFindLimit = inputEnd - MATCH_FIND_LIMIT;
+			const uint8_t* matchLimit = inputEnd - LAST_LITERALS;
+
+			while (position <= matchFindLimit) {
+				uint32_t sequence = read32(position);
+				uint32_t& slot = table[hashSequence(sequence)];
+				uint32_t candidate = slot;
+				slot = static_cast<uint32_t>(position - input);
+
+				if (candidate == NO_POSITION || static_cast<size_t>(position - input) - candidate > MAX_OFFSET || read32(input + candidate) != sequence) {
+					position++;
+					continue;
+				}
+
+				const uint8_t* match = input + candidate;
+				const uint8_t* matchEnd = position + MIN_MATCH;
+				const uint8_t* reference = match + MIN_MATCH;
+				while (matchEnd < matchLimit && *matchEnd == *reference) {
+					matchEnd++;
+					reference++;
+				}
+
+				size_t literalLength = position - anchor;
+				size_t matchLength = matchEnd - position - MIN_MATCH;
+				size_t worstCase = 1 + literalLength / 255 + 1 + literalLength + 2 + matchLength / 255 + 1;
+				if (worstCase > static_cast<size_t>(outputEnd - output)) {
+					return 0;
+				}
+
+				uint8_t* token = output++;
+				*token = static_cast<uint8_t>(std::min<size_t>(literalLength, 15) << 4);
+				if (literalLength >= 15) {
+					output = writeLength(output, literalLength - 15);
+				}
+				memcpy(output, anchor, literalLength);
+				output += literalLength;
+
+				uint16_t offset = static_cast<uint16_t>(position - match);
+				*output++ = static_cast<uint8_t>(offset & 0xFF);
+				*output++ = static_cast<uint8_t>(offset >> 8);
+
+				*token |= static_cast<uint8_t>(std::min<size_t>(matchLength, 15));
+				if (matchLength >= 15) {
+					output = writeLength(output, matchLength - 15);
+				}
+
+				position = matchEnd;
+				anchor = position;
+			}
+		}
+
+		size_t literalLength = inputEnd - anchor;
+		if (1 + literalLength / 255 + 1 + literalLength > static_cast<size_t>(outputEnd - output)) {
+			return 0;
+		}
+
+		uint8_t* token = output++;
+		*token = static_cast<uint8_t>(std::min<size_t>(literalLength, 15) << 4);
+		if (literalLength >= 15) {
+			output = writeLength(output, literalLength - 15);
+		}
+		memcpy(output, anchor, literalLength);
+		output += literalLength;
+
+		return output - reinterpret_cast<uint8_t*>(destination);
+	}
+
+	bool lz4Decompress(const char* source, size_t sourceSize, char* destination, size_t destinationSize) {
+		const uint8_t* input = reinterpret_cast<const uint8_t*>(source);
+		const uint8_t* inputEnd = input + sourceSize;
+		uint8_t* output = reinterpret_cast<uint8_t*>(destination);
+		uint8_t* outputStart = output;
+		uint8_t* outputEnd = output + destinationSize;
+
+		while (true) {
+			if (input >= inputEnd) {
+				return false;
+			}
+			uint8_t token = *input++;
+
+			size_t literalLength = token >> 4;
+			if (literalLength == 15 && !readLength(input, inputEnd, literalLength)) {
+				return false;
+			}
+			if (literalLength > static_cast<size_t>(inputEnd - input) || literalLength > static_cast<size_t>(outputEnd - output)) {
+				return false;
+			}
+			memcpy(output, input, literalLength);
+			input += literalLength;
+			output += literalLength;
+
+			// the last sequence is literals only
+			if (input == inputEnd) {
+				break;
+			}
+
+			if (inputEnd - input < 2) {
+				return false;
+			}
+			size_t offset = input[0] | (input[1] << 8);
+			input += 2;
+			if (offset == 0 || offset > static_cast<size_t>(output - outputStart)) {
+				return false;
+			}
+
+			size_t matchLength = token & 15;
+			if (matchLength == 15 && !readLength(input, inputEnd, matchLength)) {
+				return false;
+			}
+			matchLength += MIN_MATCH;
+			if (matchLength > static_cast<size_t>(outputEnd - output)) {
+				return false;
+			}
+
+			// matches may overlap what they're writing, which repeats the pattern
+			const uint8_t* match = output - offset;
+			if (offset >= matchLength) {
+				memcpy(output, match, matchLength);
+				output += matchLength;
+			}
+			else {
+				for (size_t i = 0; i < matchLength; i++) {
+					*output++ = *match++;
+				}
+			}
+		}
+
+		return output == outputEnd;
+	}
+
+	void compressBlocks(const void* data, size_t size, std::vector<char>& stream) {
+		const char* bytes = static_cast<const char*>(data);
+
+		BlockStreamHeader header;
+		header.rawSize = size;
+		header.blockSize = COMPRESSION_BLOCK_SIZE;
+		header.blockCount = static_cast<uint32_t>((size + COMPRESSION_BLOCK_SIZE - 1) / COMPRESSION_BLOCK_SIZE);
+
+		size_t tableSize = sizeof(BlockStreamHeader) + (header.blockCount + 1) * sizeof(uint64_t);
+		stream.assign(tableSize, 0);
+		memcpy(stream.data(), &header, sizeof(BlockStreamHeader));
+
+		std::vector<uint64_t> offsets = { tableSize };
+		std::vector<char> scratch(lz4CompressBound(COMPRESSION_BLOCK_SIZE));
+		for (uint32_t block = 0; block < header.blockCount; block++) {
+			size_t blockStart = static_cast<size_t>(block) * COMPRESSION_BLOCK_SIZE;
+			size_t blockSize = std::min<size_t>(COMPRESSION_BLOCK_SIZE, size - blockStart);
+
+			// capacity one short of the input means anything that doesn't shrink comes back as 0
+			size_t compressedSize = lz4Compress(bytes + blockStart, blockSize, scratch.data(), blockSize - 1);
+			if (compressedSize > 0) {
+				stream.insert(stream.end(), scratch.data(), scratch.data() + compressedSize);
+			}
+			else {
+				stream.insert(stream.end(), bytes + blockStart, bytes + blockStart + blockSize);
+			}
+			offsets.push_back(stream.size());
+		}
+
+		memcpy(stream.data() + sizeof(BlockStreamHeader), offsets.data(), offsets.size() * sizeof(uint64_t));
+	}
+
+	const BlockStreamHeader* readBlockStream(const char* stream, size_t streamSize) {
+		if (streamSize < sizeof(BlockStreamHeader)) {
+			return nullptr;
+		}
+
+		const BlockStreamHeader* header = reinterpret_cast<const BlockStreamHeader*>(stream);
+		if (header->blockSize == 0 || header->blockCount != (header->rawSize + header->blockSize - 1) / header->blockSize) {
+			return nullptr;
+		}
+
+		size_t tableSize = sizeof(BlockStreamHeader) + (static_cast<size_t>(header->blockCount) + 1) * sizeof(uint64_t);
+		if (streamSize < tableSize) {
+			return nullptr;
+		}
+
+		const uint64_t* offsets = getBlockOffsets(stream);
+		if (offsets[0] != tableSize || offsets[header->blockCount] != streamSize) {
+			return nullptr;
+		}
+		for (uint32_t block = 0; block < header->blockCount; block++) {
+			if (offsets[block + 1] < offsets[block]) {
+				return nullptr;
+			}
+		}
+
+		return header;
+	}
+
+	bool decompressBlockRange(const char* stream, uint32_t firstBlock, uint32_t lastBlock, char* destination) {
+		const BlockStreamHeader* header = reinterpret_cast<const BlockStreamHeader*>(stream);
+		const uint64_t* offsets = getBlockOffsets(stream);
+
+		for (uint32_t block = firstBlock; block < lastBlock; block++) {
+			size_t blockStart = static_cast<size_t>(block) * header->blockSize;
+			size_t blockSize = std::min<size_t>(header->blockSize, header->rawSize - blockStart);
+			size_t storedSize = static_cast<size_t>(offsets[block + 1] - offsets[block]);
+			const char* storedData = stream + offsets[block];
+
+			if (storedSize == blockSize) {
+				memcpy(destination + blockStart, storedData, blockSize);
+			}
+			else if (!lz4Decompress(storedData, storedSize, destination + blockStart, blockSize)) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool decompressByteRange(const char* stream, size_t offset, size_t size, char* destination) {
+		const BlockStreamHeader* header = reinterpret_cast<const BlockStreamHeader*>(stream);
+		if (offset + size > header->rawSize) {
+			return false;
+		}
+
+		// blocks the range only partly covers go through a scratch block, the rest land in place
+		const uint64_t* offsets = getBlockOffsets(stream);
+		std::vector<char> scratch;
+		size_t end = offset + size;
+		for (size_t block = offset / header->blockSize; block * header->blockSize < end; block++) {
+			size_t blockStart = block * header->blockSize;
+			size_t blockSize = std::min<size_t>(header->blockSize, header->rawSize - blockStart);
+			size_t copyStart = std::max(offset, blockStart);
+			size_t copyEnd = std::min(end, blockStart + blockSize);
+			bool whole = copyStart == blockStart && copyEnd == blockStart + blockSize;
+
+			if (!whole) {
+				scratch.resize(blockSize);
+			}
+			char* target = whole ? destination + (blockStart - offset) : scratch.data();
+
+			size_t storedSize = static_cast<size_t>(offsets[block + 1] - offsets[block]);
+			const char* storedData = stream + offsets[block];
+			if (storedSize == blockSize) {
+				memcpy(target, storedData, blockSize);
+			}
+			else if (!lz4Decompress(storedData, storedSize, target, blockSize)) {
+				return false;
+			}
+
+			if (!whole) {
+				memcpy(destination + (copyStart - offset), scratch.data() + (copyStart - blockStart), copyEnd - copyStart);
+			}
+		}
+
+		return true;
+	}
+}
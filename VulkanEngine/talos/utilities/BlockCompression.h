@@ -0,0 +1,50 @@
+#pragma once
+#include "../config.h"
+
+/*
+	Block compression for cooked blobs. Data is cut into fixed size blocks
+	that are compressed on their own with the LZ4 block format, so any run of
+	blocks can be decompressed without the others and a big blob spreads
+	over every worker. A stream is a BlockStreamHeader, blockCount + 1 byte
+	offsets from the start of the stream, then the blocks. A block that
+	doesn't shrink is stored as is, which shows as a stored size equal to its
+	uncompressed size.
+*/
+namespace vkUtilities {
+	// uncompressed bytes per block, only the last block can be shorter
+	static const uint32_t COMPRESSION_BLOCK_SIZE = 256 * 1024;
+
+	struct BlockStreamHeader {
+		uint64_t rawSize;
+		uint32_t blockSize;
+		uint32_t blockCount;
+	};
+
+	// how a cooked blob's payload is stored
+	enum class BlobCompression : uint32_t {
+		NONE = 0,
+		// a block stream of the uncompressed payload
+		LZ4_BLOCKS = 1
+	};
+
+	// largest output lz4Compress can produce for an input of this size
+	size_t lz4CompressBound(size_t size);
+
+	// returns the compressed size, or 0 if it didn't fit in capacity
+	size_t lz4Compress(const char* source, size_t sourceSize, char* destination, size_t capacity);
+
+	// fails on malformed input or if it doesn't decompress to exactly destinationSize bytes
+	bool lz4Decompress(const char* source, size_t sourceSize, char* destination, size_t destinationSize);
+
+	// replaces stream's contents
+	void compressBlocks(const void* data, size_t size, std::vector<char>& stream);
+
+	// header of a well formed stream, null if it's truncated or its offsets don't add up
+	const BlockStreamHeader* readBlockStream(const char* stream, size_t streamSize);
+
+	// decompresses blocks [firstBlock, lastBlock) to where they sit in the uncompressed data
+	bool decompressBlockRange(const char* stream, uint32_t firstBlock, uint32_t lastBlock, char* destination);
+
+	// decompresses just bytes [offset, offset + size) of the uncompressed data into destination, on the calling thread
+	bool decompressByteRange(const char* stream, size_t offset, size_t size, char* destination);
+}
@@ -0,0 +1,44 @@
+#include "CacheFile.h"
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+
+namespace vkUtilities {
+	bool writeCacheFile(const std::string& filepath, const std::vector<FilePiece>& pieces) {
+		std::error_code error;
+		std::filesystem::path path(filepath);
+		std::filesystem::create_directories(path.parent_path(), error);
+
+		// the temporary name is per thread, so two jobs cooking identical content can't write into each other
+		std::stringstream tempPath;
+		tempPath << filepath << "." << std::hash<std::thread::id>{}(std::this_thread::get_id()) << ".tmp";
+		std::ofstream file(tempPath.str(), std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			return false;
+		}
+
+		for (const FilePiece& piece : pieces) {
+			file.write(static_cast<const char*>(piece.data), piece.size);
+		}
+		file.close();
+
+		if (file.fail()) {
+			std::filesystem::remove(tempPath.str(), error);
+			return false;
+		}
+
+		std::filesystem::rename(tempPath.str(), path, error);
+		if (error) {
+			std::filesystem::remove(tempPath.str(), error);
+			return false;
+		}
+
+		return true;
+	}
+
+	std::string makeCachePath(const std::string& directory, uint64_t hash, const std::string& extension) {
+		std::stringstream path;
+		path << directory << std::hex << std::setw(16) << std::setfill('0') << hash << extension;
+		return path.str();
+	}
+}
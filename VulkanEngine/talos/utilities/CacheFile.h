@@ -0,0 +1,34 @@
+#pragma once
+#include "../config.h"
+
+/*
+	Helpers shared by the cooked asset caches: a content hash for keying
+	them and a writer that never leaves a half written file behind.
+*/
+namespace vkUtilities {
+	static const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+	static const uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+	// fnv-1a, chain calls by passing the previous result back in
+	inline uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= FNV_PRIME;
+		}
+
+		return hash;
+	}
+
+	// one run of bytes to write, pieces go to disk back to back
+	struct FilePiece {
+		const void* data;
+		size_t size;
+	};
+
+	// writes next to the final location and renames, creating parent directories as needed
+	bool writeCacheFile(const std::string& filepath, const std::vector<FilePiece>& pieces);
+
+	// "<directory><16 hex digits><extension>"
+	std::string makeCachePath(const std::string& directory, uint64_t hash, const std::string& extension);
+}
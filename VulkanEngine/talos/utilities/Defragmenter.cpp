@@ -0,0 +1,241 @@
+#include "Defragmenter.h"
+#include "Memory.h"
+#include <algorithm>
+#include <iomanip>
+
+namespace vkUtilities {
+	namespace {
+		void printFragmentation(const FragmentationStatistics& fragmentation) {
+			std::cout << std::fixed << std::setprecision(1)
+				<< fragmentation.blockCount << " blocks (" << fragmentation.emptyBlockCount << " empty), "
+				<< fragmentation.allocatedSize / (1024.0 * 1024.0) << "MB of " << fragmentation.blockSize / (1024.0 * 1024.0) << "MB allocated, "
+				<< fragmentation.freeRangeCount << " free ranges, largest " << fragmentation.largestFreeRange / (1024.0 * 1024.0) << "MB, "
+				<< fragmentation.fragmentation * 100.0f << "% fragmented" << std::defaultfloat << std::endl;
+		}
+	}
+
+	RelocatableBuffer::RelocatableBuffer(vk::Device device, Buffer* buffer) {
+		this->device = device;
+		this->buffer = buffer;
+	}
+
+	const Allocation& RelocatableBuffer::getAllocation() const {
+		return buffer->bufferMemory;
+	}
+
+	vk::MemoryRequirements RelocatableBuffer::getMemoryRequirements() const {
+		return device.getBufferMemoryRequirements(buffer->buffer);
+	}
+
+	bool RelocatableBuffer::canMove() const {
+		return buffer->buffer && static_cast<bool>(buffer->usage & vk::BufferUsageFlagBits::eTransferSrc);
+	}
+
+	void RelocatableBuffer::recordMove(vk::CommandBuffer commandBuffer, const Allocation& destination) {
+		vk::BufferCreateInfo bufferCreateInfo;
+		bufferCreateInfo.flags = vk::BufferCreateFlags();
+		bufferCreateInfo.size = buffer->size;
+		bufferCreateInfo.usage = buffer->usage | vk::BufferUsageFlagBits::eTransferDst;
+		bufferCreateInfo.sharingMode = vk::SharingMode::eExclusive;
+		moved.buffer = device.createBuffer(bufferCreateInfo);
+		moved.bufferMemory = destination;
+		moved.size = buffer->size;
+		moved.usage = bufferCreateInfo.usage;
+		device.bindBufferMemory(moved.buffer, destination.memory, destination.offset);
+
+		vk::BufferCopy copyRegion;
+		copyRegion.srcOffset = 0;
+		copyRegion.dstOffset = 0;
+		copyRegion.size = buffer->size;
+		commandBuffer.copyBuffer(buffer->buffer, moved.buffer, 1, &copyRegion);
+
+		// whatever reads the buffer next comes after the copy
+		vk::BufferMemoryBarrier barrier;
+		barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		barrier.dstAccessMask = vk::AccessFlagBits::eMemoryRead;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = moved.buffer;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, vk::DependencyFlags(), nullptr, barrier, nullptr);
+	}
+
+	void RelocatableBuffer::finishMove() {
+		original = *buffer;
+		*buffer = moved;
+		moved = Buffer();
+	}
+
+	void RelocatableBuffer::releaseOriginal() {
+		destroyBuffer(device, original);
+		original = Buffer();
+	}
+
+	void Defragmenter::create(DefragmenterInput input) {
+		this->input = input;
+	}
+
+	void Defragmenter::add(Relocatable* resource) {
+		resources.push_back(resource);
+	}
+
+	bool Defragmenter::isDefragmenting() const {
+		return defragmenting;
+	}
+
+	const DefragmentationStatistics& Defragmenter::getStatistics() const {
+		return statistics;
+	}
+
+	bool Defragmenter::needsPass(const FragmentationStatistics& fragmentation) const {
+		return fragmentation.fragmentation >= input.threshold && fragmentation.blockSize - fragmentation.allocatedSize >= input.minFreeSize;
+	}
+
+	void Defragmenter::finishPass() {
+		defragmenting = false;
+		statistics.after = input.allocator->getFragmentation();
+
+		if (input.debug) {
+			std::cout << "Defragmentation moved " << statistics.moveCount << " resources, "
+				<< statistics.movedSize / (1024 * 1024) << "MB over " << statistics.frameCount << " frames" << std::endl;
+			std::cout << "\tbefore: ";
+			printFragmentation(statistics.before);
+			std::cout << "\tafter: ";
+			printFragmentation(statistics.after);
+		}
+	}
+
+	bool Defragmenter::isRetiring(const Relocatable* resource) const {
+		return std::any_of(retiring.begin(), retiring.end(), [resource](const Retiring& retired) { return retired.resource == resource; });
+	}
+
+	void Defragmenter::releaseOriginals() {
+		std::vector<Retiring> held;
+		for (const Retiring& retired : retiring) {
+			if (frame >= retired.releaseFrame) {
+				retired.resource->releaseOriginal();
+			}
+			else {
+				held.push_back(retired);
+			}
+		}
+		retiring = held;
+	}
+
+	void Defragmenter::finishBatch() {
+		batch->destroy();
+		batch.reset();
+
+		// frames recorded from here on use the copies, the ones already in flight finish within framesInFlight updates
+		for (Relocatable* resource : moving) {
+			resource->finishMove();
+			retiring.push_back({ resource, frame + input.framesInFlight });
+		}
+
+		statistics.moveCount += static_cast<uint32_t>(moving.size());
+		statistics.movedSize += movingSize;
+		moving.clear();
+		movingSize = 0;
+	}
+
+	bool Defragmenter::update() {
+		frame++;
+		releaseOriginals();
+
+		// one batch at a time, the next one's destinations can depend on where this one's originals were
+		if (batch) {
+			statistics.frameCount++;
+			if (!batch->isFinished()) {
+				return false;
+			}
+
+			finishBatch();
+			return true;
+		}
+
+		if (!defragmenting) {
+			if (frame % input.checkInterval != 0) {
+				return false;
+			}
+
+			FragmentationStatistics fragmentation = input.allocator->getFragmentation();
+			if (!needsPass(fragmentation)) {
+				return false;
+			}
+
+			defragmenting = true;
+			statistics = DefragmentationStatistics();
+			statistics.before = fragmentation;
+			if (input.debug) {
+				std::cout << "Defragmenting device memory, ";
+				printFragmentation(fragmentation);
+			}
+		}
+
+		// resources in the emptiest blocks go first, so whole blocks drain and can be freed
+		std::vector<std::pair<vk::DeviceSize, Relocatable*>> candidates;
+		for (Relocatable* resource : resources) {
+			if (resource->getAllocation().block && resource->canMove() && !isRetiring(resource)) {
+				candidates.push_back({ input.allocator->getBlockAllocatedSize(resource->getAllocation()), resource });
+			}
+		}
+		std::stable_sort(candidates.begin(), candidates.end(), [](const std::pair<vk::DeviceSize, Relocatable*>& a, const std::pair<vk::DeviceSize, Relocatable*>& b) {
+			return a.first < b.first;
+		});
+
+		for (const std::pair<vk::DeviceSize, Relocatable*>& candidate : candidates) {
+			if (moving.size() >= input.maxMovesPerFrame || movingSize >= input.maxBytesPerFrame) {
+				break;
+			}
+
+			Relocatable* resource = candidate.second;
+			Allocation destination = input.allocator->allocateMove(resource->getAllocation(), resource->getMemoryRequirements());
+			if (!destination.memory) {
+				continue;
+			}
+
+			// same queue as the frames, so the barriers each move records order it after every frame already submitted
+			if (moving.empty()) {
+				UploadBatchInput batchInput;
+				batchInput.device = input.device;
+				batchInput.commandBuffer = nullptr;
+				batchInput.queue = input.queue;
+				batchInput.queueFamily = input.queueFamily;
+				batchInput.ownerFamily = input.queueFamily;
+				batchInput.stagingRing = input.stagingRing;
+				batch = std::make_unique<UploadBatch>();
+				batch->begin(batchInput);
+			}
+
+			resource->recordMove(batch->getCommandBuffer(), destination);
+			moving.push_back(resource);
+			movingSize += destination.size;
+		}
+
+		if (!moving.empty()) {
+			batch->submit();
+			statistics.frameCount++;
+			return false;
+		}
+
+		// nothing has anywhere better to go, though originals still held may free up somewhere
+		if (retiring.empty()) {
+			finishPass();
+		}
+		return false;
+	}
+
+	void Defragmenter::destroy() {
+		if (batch) {
+			batch->wait();
+			finishBatch();
+		}
+
+		for (const Retiring& retired : retiring) {
+			retired.resource->releaseOriginal();
+		}
+		retiring.clear();
+		resources.clear();
+	}
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include "../config.h"
+#include "DeviceAllocator.h"
+#include "UploadBatch.h"
+#include <memory>
+
+/*
+	Packs long lived resources into fewer blocks once loading and unloading
+	has left the allocator's free space in pieces. Every so often the
+	allocator's fragmentation is checked, and once it's past the threshold
+	a pass starts: each frame a few resources, those in the emptiest blocks
+	first, are copied on the GPU into the better place allocateMove finds
+	and switched over, until nothing has anywhere better to go. Blocks left
+	empty are freed by the allocator as their last resource moves out.
+
+	Copies are submitted on the graphics queue behind the frames already
+	in flight and never waited on. Once a later update finds them finished
+	the resources switch to their copies, and the originals are only freed
+	after every frame that could still have been reading them has too.
+	Nothing stalls the device, but a resource's old memory stays taken for
+	a few frames after it moves.
+*/
+namespace vkUtilities {
+	// a pass starts once this much of the free space in blocks is split off the largest range
+	static const float DEFRAGMENTATION_THRESHOLD = 0.5f;
+	// and there's at least this much free space to gather
+	static const vk::DeviceSize DEFRAGMENTATION_MIN_FREE_SIZE = 32 * 1024 * 1024;
+	// what one batch of copies may move, a batch lands a frame or more after it's submitted and the next starts after that
+	static const vk::DeviceSize DEFRAGMENTATION_BYTES_PER_FRAME = 16 * 1024 * 1024;
+	static const uint32_t DEFRAGMENTATION_MOVES_PER_FRAME = 16;
+	// frames between checks for whether a pass is needed
+	static const uint32_t DEFRAGMENTATION_CHECK_INTERVAL = 600;
+
+	// a resource whose memory the defragmenter may move
+	class Relocatable {
+	public:
+		virtual const Allocation& getAllocation() const = 0;
+		virtual vk::MemoryRequirements getMemoryRequirements() const = 0;
+		// false while it's being written to, or can't be copied at all
+		virtual bool canMove() const = 0;
+		// makes a copy bound to destination and records copying into it, the resource keeps using the original until finishMove
+		virtual void recordMove(vk::CommandBuffer commandBuffer, const Allocation& destination) = 0;
+		// once the copy has finished, switches to it, frames already in flight may still be reading the original
+		virtual void finishMove() = 0;
+		// frees what finishMove switched away from, once no frame that could read it is in flight
+		virtual void releaseOriginal() = 0;
+	};
+
+	// moves a buffer made with eTransferSrc, the Buffer is updated in place so whoever holds it sees the new handle
+	class RelocatableBuffer : public Relocatable {
+	public:
+		RelocatableBuffer(vk::Device device, Buffer* buffer);
+		virtual const Allocation& getAllocation() const final;
+		virtual vk::MemoryRequirements getMemoryRequirements() const final;
+		virtual bool canMove() const final;
+		virtual void recordMove(vk::CommandBuffer commandBuffer, const Allocation& destination) final;
+		virtual void finishMove() final;
+		virtual void releaseOriginal() final;
+
+	private:
+		vk::Device device;
+		Buffer* buffer;
+		Buffer moved;
+		Buffer original;
+	};
+
+	struct DefragmenterInput {
+		vk::Device device;
+		DeviceAllocator* allocator;
+		// moves are recorded into command buffers of the defragmenter's own and submitted here, the queue frames draw on
+		vk::Queue queue;
+		uint32_t queueFamily = 0;
+		// update is called once a frame, so an original this many updates after its switch has no frame left that reads it
+		uint32_t framesInFlight = 1;
+		StagingRing* stagingRing;
+		float threshold = DEFRAGMENTATION_THRESHOLD;
+		vk::DeviceSize minFreeSize = DEFRAGMENTATION_MIN_FREE_SIZE;
+		vk::DeviceSize maxBytesPerFrame = DEFRAGMENTATION_BYTES_PER_FRAME;
+		uint32_t maxMovesPerFrame = DEFRAGMENTATION_MOVES_PER_FRAME;
+		uint32_t checkInterval = DEFRAGMENTATION_CHECK_INTERVAL;
+		bool debug;
+	};
+
+	// how a pass went, the one in progress or the last one finished
+	struct DefragmentationStatistics {
+		FragmentationStatistics before;
+		FragmentationStatistics after;
+		uint32_t moveCount = 0;
+		vk::DeviceSize movedSize = 0;
+		uint32_t frameCount = 0;
+	};
+
+	class Defragmenter {
+	public:
+		void create(DefragmenterInput input);
+		// the resource must outlive the defragmenter
+		void add(Relocatable* resource);
+		// while a pass is on, switches over the last batch once it has finished or submits the next one, before any recording
+		// true when resources switched to their copies this frame
+		bool update();
+		bool isDefragmenting() const;
+		const DefragmentationStatistics& getStatistics() const;
+		// waits for the copies in flight and frees every original, nothing may be using the device
+		void destroy();
+
+	private:
+		struct Retiring {
+			Relocatable* resource;
+			// the update from which nothing can be reading the original
+			uint64_t releaseFrame;
+		};
+
+		DefragmenterInput input;
+		std::vector<Relocatable*> resources;
+		uint64_t frame = 0;
+		bool defragmenting = false;
+		DefragmentationStatistics statistics;
+		// the copies submitted and not yet switched to
+		std::unique_ptr<UploadBatch> batch;
+		std::vector<Relocatable*> moving;
+		vk::DeviceSize movingSize = 0;
+		// switched resources whose originals are still held for frames in flight
+		std::vector<Retiring> retiring;
+
+		bool needsPass(const FragmentationStatistics& fragmentation) const;
+		bool isRetiring(const Relocatable* resource) const;
+		void releaseOriginals();
+		// switches everything in the finished batch over to its copy
+		void finishBatch();
+		void finishPass();
+	};
+}
@@ -0,0 +1,617 @@
+#include "DeviceAllocator.h"
+#include "Memory.h"
+#include <algorithm>
+#include <iomanip>
+
+namespace vkUtilities {
+	namespace {
+		uint32_t floorLog2(uint64_t value) {
+			uint32_t log = 0;
+			while (value >>= 1) {
+				log++;
+			}
+			return log;
+		}
+
+		uint32_t lowestBit(uint64_t value) {
+			uint32_t bit = 0;
+			while (!(value & 1)) {
+				value >>= 1;
+				bit++;
+			}
+			return bit;
+		}
+
+		vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment) {
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		bool isHostVisible(const vk::PhysicalDeviceMemoryProperties& properties, uint32_t memoryType) {
+			return static_cast<bool>(properties.memoryTypes[memoryType].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible);
+		}
+
+		double toMegabytes(vk::DeviceSize size) {
+			return size / (1024.0 * 1024.0);
+		}
+
+		// memory of its own for one resource, mapped if it's host visible
+		Allocation allocateDedicated(const AllocationInput& input, uint32_t memoryType, bool hostVisible) {
+			Allocation allocation;
+			vk::MemoryAllocateInfo allocInfo;
+			allocInfo.allocationSize = input.requirements.size;
+			allocInfo.memoryTypeIndex = memoryType;
+
+			try {
+				allocation.memory = input.device.allocateMemory(allocInfo);
+				allocation.size = input.requirements.size;
+				if (hostVisible) {
+					allocation.data = static_cast<unsigned char*>(input.device.mapMemory(allocation.memory, 0, allocation.size));
+				}
+			}
+			catch (vk::SystemError err) {
+				std::cout << "Failed to allocate " << input.requirements.size << " bytes of device memory" << std::endl;
+			}
+			return allocation;
+		}
+	}
+
+	void DeviceAllocator::create(DeviceAllocatorInput input) {
+		this->input = input;
+		memoryProperties = input.physicalDevice.getMemoryProperties();
+		bufferImageGranularity = input.physicalDevice.getProperties().limits.bufferImageGranularity;
+
+		heaps.assign(memoryProperties.memoryHeapCount, HeapStatistics());
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+			heaps[i].size = memoryProperties.memoryHeaps[i].size;
+			heaps[i].deviceLocal = static_cast<bool>(memoryProperties.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal);
+		}
+	}
+
+	vk::DeviceSize DeviceAllocator::getBlockSize(uint32_t memoryType) const {
+		vk::DeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryType].heapIndex].size;
+		if (heapSize <= 1024ull * 1024 * 1024) {
+			return alignUp(heapSize / 8, MEMORY_MIN_ALIGNMENT);
+		}
+		return input.blockSize;
+	}
+
+	void DeviceAllocator::mapSize(vk::DeviceSize size, uint32_t& firstLevel, uint32_t& secondLevel) {
+		if (size < (1ull << TLSF_SMALL_SIZE_LOG2)) {
+			firstLevel = 0;
+			secondLevel = static_cast<uint32_t>(size / MEMORY_MIN_ALIGNMENT);
+			return;
+		}
+
+		uint32_t log = floorLog2(size);
+		firstLevel = log - TLSF_SMALL_SIZE_LOG2 + 1;
+		secondLevel = static_cast<uint32_t>(size >> (log - TLSF_SECOND_LEVEL_LOG2)) - TLSF_SECOND_LEVELS;
+	}
+
+	void DeviceAllocator::insertFree(MemoryBlock& block, uint32_t node) {
+		uint32_t firstLevel, secondLevel;
+		mapSize(block.nodes[node].size, firstLevel, secondLevel);
+
+		uint32_t head = block.freeLists[firstLevel][secondLevel];
+		block.nodes[node].free = true;
+		block.nodes[node].previousFree = NO_MEMORY_NODE;
+		block.nodes[node].nextFree = head;
+		if (head != NO_MEMORY_NODE) {
+			block.nodes[head].previousFree = node;
+		}
+		block.freeLists[firstLevel][secondLevel] = node;
+		block.firstLevelMap |= 1ull << firstLevel;
+		block.secondLevelMaps[firstLevel] |= 1u << secondLevel;
+	}
+
+	void DeviceAllocator::removeFree(MemoryBlock& block, uint32_t node) {
+		uint32_t firstLevel, secondLevel;
+		mapSize(block.nodes[node].size, firstLevel, secondLevel);
+
+		MemoryNode& removed = block.nodes[node];
+		if (removed.previousFree != NO_MEMORY_NODE) {
+			block.nodes[removed.previousFree].nextFree = removed.nextFree;
+		}
+		else {
+			block.freeLists[firstLevel][secondLevel] = removed.nextFree;
+		}
+		if (removed.nextFree != NO_MEMORY_NODE) {
+			block.nodes[removed.nextFree].previousFree = removed.previousFree;
+		}
+		removed.free = false;
+
+		if (block.freeLists[firstLevel][secondLevel] == NO_MEMORY_NODE) {
+			block.secondLevelMaps[firstLevel] &= ~(1u << secondLevel);
+			if (!block.secondLevelMaps[firstLevel]) {
+				block.firstLevelMap &= ~(1ull << firstLevel);
+			}
+		}
+	}
+
+	uint32_t DeviceAllocator::makeNode(MemoryBlock& block, vk::DeviceSize offset, vk::DeviceSize size) {
+		MemoryNode node{ offset, size, NO_MEMORY_NODE, NO_MEMORY_NODE, NO_MEMORY_NODE, NO_MEMORY_NODE, false };
+		if (!block.unusedNodes.empty()) {
+			uint32_t index = block.unusedNodes.back();
+			block.unusedNodes.pop_back();
+			block.nodes[index] = node;
+			return index;
+		}
+
+		block.nodes.push_back(node);
+		return static_cast<uint32_t>(block.nodes.size() - 1);
+	}
+
+	uint32_t DeviceAllocator::allocateNode(MemoryBlock& block, vk::DeviceSize size, vk::DeviceSize alignment) {
+		// room for the worst padding means any range in the class found fits, whatever its offset
+		vk::DeviceSize searchSize = size + alignment - MEMORY_MIN_ALIGNMENT;
+		if (searchSize >= (1ull << TLSF_SMALL_SIZE_LOG2)) {
+			searchSize += (1ull << (floorLog2(searchSize) - TLSF_SECOND_LEVEL_LOG2)) - 1;
+		}
+		if (searchSize > block.size) {
+			return NO_MEMORY_NODE;
+		}
+
+		uint32_t firstLevel, secondLevel;
+		mapSize(searchSize, firstLevel, secondLevel);
+		if (firstLevel >= TLSF_FIRST_LEVELS) {
+			return NO_MEMORY_NODE;
+		}
+
+		// the smallest class at least that big with a free range in it
+		uint32_t secondMap = block.secondLevelMaps[firstLevel] & (~0u << secondLevel);
+		if (!secondMap) {
+			uint64_t firstMap = firstLevel + 1 < TLSF_FIRST_LEVELS ? block.firstLevelMap & (~0ull << (firstLevel + 1)) : 0;
+			if (!firstMap) {
+				return NO_MEMORY_NODE;
+			}
+			firstLevel = lowestBit(firstMap);
+			secondMap = block.secondLevelMaps[firstLevel];
+		}
+		secondLevel = lowestBit(secondMap);
+
+		uint32_t node = block.freeLists[firstLevel][secondLevel];
+		removeFree(block, node);
+
+		// padding before the aligned offset and whatever's left after the range go back as free ranges of their own
+		vk::DeviceSize offset = block.nodes[node].offset;
+		vk::DeviceSize padding = alignUp(offset, alignment) - offset;
+		if (padding > 0) {
+			uint32_t front = makeNode(block, offset, padding);
+			block.nodes[front].previous = block.nodes[node].previous;
+			block.nodes[front].next = node;
+			if (block.nodes[front].previous != NO_MEMORY_NODE) {
+				block.nodes[block.nodes[front].previous].next = front;
+			}
+			block.nodes[node].previous = front;
+			block.nodes[node].offset += padding;
+			block.nodes[node].size -= padding;
+			insertFree(block, front);
+		}
+
+		if (block.nodes[node].size > size) {
+			uint32_t back = makeNode(block, block.nodes[node].offset + size, block.nodes[node].size - size);
+			block.nodes[back].previous = node;
+			block.nodes[back].next = block.nodes[node].next;
+			if (block.nodes[back].next != NO_MEMORY_NODE) {
+				block.nodes[block.nodes[back].next].previous = back;
+			}
+			block.nodes[node].next = back;
+			block.nodes[node].size = size;
+			insertFree(block, back);
+		}
+
+		return node;
+	}
+
+	void DeviceAllocator::freeNode(MemoryBlock& block, uint32_t node) {
+		// free neighbours are folded into this range, their nodes are kept for reuse
+		uint32_t previous = block.nodes[node].previous;
+		if (previous != NO_MEMORY_NODE && block.nodes[previous].free) {
+			removeFree(block, previous);
+			block.nodes[node].offset = block.nodes[previous].offset;
+			block.nodes[node].size += block.nodes[previous].size;
+			block.nodes[node].previous = block.nodes[previous].previous;
+			if (block.nodes[node].previous != NO_MEMORY_NODE) {
+				block.nodes[block.nodes[node].previous].next = node;
+			}
+			block.unusedNodes.push_back(previous);
+		}
+
+		uint32_t next = block.nodes[node].next;
+		if (next != NO_MEMORY_NODE && block.nodes[next].free) {
+			removeFree(block, next);
+			block.nodes[node].size += block.nodes[next].size;
+			block.nodes[node].next = block.nodes[next].next;
+			if (block.nodes[node].next != NO_MEMORY_NODE) {
+				block.nodes[block.nodes[node].next].previous = node;
+			}
+			block.unusedNodes.push_back(next);
+		}
+
+		insertFree(block, node);
+	}
+
+	MemoryBlock* DeviceAllocator::makeBlock(uint32_t memoryType, ResourceTiling tiling) {
+		MemoryBlock* block = new MemoryBlock();
+		block->size = getBlockSize(memoryType);
+		block->memoryType = memoryType;
+		block->tiling = tiling;
+		std::fill(std::begin(block->secondLevelMaps), std::end(block->secondLevelMaps), 0u);
+		for (uint32_t firstLevel = 0; firstLevel < TLSF_FIRST_LEVELS; firstLevel++) {
+			std::fill(std::begin(block->freeLists[firstLevel]), std::end(block->freeLists[firstLevel]), NO_MEMORY_NODE);
+		}
+
+		vk::MemoryAllocateInfo allocInfo;
+		allocInfo.allocationSize = block->size;
+		allocInfo.memoryTypeIndex = memoryType;
+		try {
+			block->memory = input.device.allocateMemory(allocInfo);
+			if (isHostVisible(memoryProperties, memoryType)) {
+				block->data = static_cast<unsigned char*>(input.device.mapMemory(block->memory, 0, block->size));
+			}
+		}
+		catch (vk::SystemError err) {
+			std::cout << "Failed to allocate a " << block->size / (1024 * 1024) << "MB memory block" << std::endl;
+			delete block;
+			return nullptr;
+		}
+
+		// the whole block starts as one free range
+		insertFree(*block, makeNode(*block, 0, block->size));
+		addReserved(memoryType, block->size);
+
+		if (input.debug) {
+			std::cout << "Allocated a " << block->size / (1024 * 1024) << "MB block of memory type " << memoryType << std::endl;
+		}
+		return block;
+	}
+
+	void DeviceAllocator::destroyBlock(MemoryBlock* block) {
+		if (block->data) {
+			input.device.unmapMemory(block->memory);
+		}
+		input.device.freeMemory(block->memory);
+		heaps[memoryProperties.memoryTypes[block->memoryType].heapIndex].reserved -= block->size;
+		delete block;
+	}
+
+	void DeviceAllocator::addReserved(uint32_t memoryType, vk::DeviceSize size) {
+		HeapStatistics& heap = heaps[memoryProperties.memoryTypes[memoryType].heapIndex];
+		heap.reserved += size;
+		heap.peakReserved = std::max(heap.peakReserved, heap.reserved);
+	}
+
+	void DeviceAllocator::addAllocated(Allocation& allocation, uint32_t memoryType, MemoryCategory category) {
+		allocation.heap = memoryProperties.memoryTypes[memoryType].heapIndex;
+		allocation.category = category;
+
+		HeapStatistics& heap = heaps[allocation.heap];
+		uint32_t index = static_cast<uint32_t>(category);
+		heap.allocated[index] += allocation.size;
+		heap.peakAllocated[index] = std::max(heap.peakAllocated[index], heap.allocated[index]);
+	}
+
+	void DeviceAllocator::removeAllocated(const Allocation& allocation) {
+		heaps[allocation.heap].allocated[static_cast<uint32_t>(allocation.category)] -= allocation.size;
+	}
+
+	Allocation DeviceAllocator::allocate(const AllocationInput& allocationInput) {
+		Allocation allocation;
+		uint32_t memoryType = findMemoryTypeIndex(input.physicalDevice, allocationInput.requirements.memoryTypeBits, allocationInput.properties);
+		if (memoryType == UINT32_MAX) {
+			std::cout << "No memory type has the properties asked for" << std::endl;
+			return allocation;
+		}
+
+		bool hostVisible = isHostVisible(memoryProperties, memoryType);
+		vk::DeviceSize size = alignUp(std::max(allocationInput.requirements.size, MEMORY_MIN_ALIGNMENT), MEMORY_MIN_ALIGNMENT);
+		vk::DeviceSize alignment = std::max(allocationInput.requirements.alignment, MEMORY_MIN_ALIGNMENT);
+		// with no granularity to respect, buffers and images share blocks
+		ResourceTiling tiling = bufferImageGranularity > 1 ? allocationInput.tiling : ResourceTiling::LINEAR;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (size > getBlockSize(memoryType) / 2) {
+			allocation = allocateDedicated(allocationInput, memoryType, hostVisible);
+			if (allocation.memory) {
+				allocation.allocator = this;
+				dedicatedCount++;
+				addReserved(memoryType, allocation.size);
+				addAllocated(allocation, memoryType, allocationInput.category);
+			}
+			return allocation;
+		}
+
+		MemoryBlock* block = nullptr;
+		uint32_t node = NO_MEMORY_NODE;
+		for (MemoryBlock* candidate : blocks) {
+			if (candidate->memoryType == memoryType && candidate->tiling == tiling) {
+				node = allocateNode(*candidate, size, alignment);
+				if (node != NO_MEMORY_NODE) {
+					block = candidate;
+					break;
+				}
+			}
+		}
+
+		if (!block) {
+			block = makeBlock(memoryType, tiling);
+			if (!block) {
+				return allocation;
+			}
+			blocks.push_back(block);
+			node = allocateNode(*block, size, alignment);
+		}
+
+		block->allocatedSize += block->nodes[node].size;
+		block->allocationCount++;
+
+		allocation.memory = block->memory;
+		allocation.offset = block->nodes[node].offset;
+		allocation.size = block->nodes[node].size;
+		allocation.data = block->data ? block->data + allocation.offset : nullptr;
+		allocation.allocator = this;
+		allocation.block = block;
+		allocation.node = node;
+		addAllocated(allocation, memoryType, allocationInput.category);
+		return allocation;
+	}
+
+	void DeviceAllocator::free(Allocation& allocation) {
+		if (!allocation.memory) {
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		removeAllocated(allocation);
+		if (!allocation.block) {
+			heaps[allocation.heap].reserved -= allocation.size;
+			if (allocation.data) {
+				input.device.unmapMemory(allocation.memory);
+			}
+			input.device.freeMemory(allocation.memory);
+			dedicatedCount--;
+			allocation = Allocation();
+			return;
+		}
+
+		MemoryBlock* block = allocation.block;
+		block->allocatedSize -= block->nodes[allocation.node].size;
+		block->allocationCount--;
+		freeNode(*block, allocation.node);
+		allocation = Allocation();
+
+		// one empty block per kind is kept so loading and unloading around a boundary doesn't thrash
+		if (block->allocationCount == 0) {
+			bool spare = std::any_of(blocks.begin(), blocks.end(), [block](const MemoryBlock* other) {
+				return other != block && other->memoryType == block->memoryType && other->tiling == block->tiling;
+			});
+			if (spare) {
+				blocks.erase(std::find(blocks.begin(), blocks.end(), block));
+				destroyBlock(block);
+			}
+		}
+	}
+
+	void DeviceAllocator::destroy() {
+		std::lock_guard<std::mutex> lock(mutex);
+		for (MemoryBlock* block : blocks) {
+			if (input.debug && block->allocationCount > 0) {
+				std::cout << block->allocationCount << " allocations were never freed from a block of memory type " << block->memoryType << std::endl;
+			}
+			destroyBlock(block);
+		}
+		blocks.clear();
+
+		if (input.debug && dedicatedCount > 0) {
+			std::cout << dedicatedCount << " dedicated allocations were never freed" << std::endl;
+		}
+	}
+
+	void DeviceAllocator::queryBudget(MemoryStatistics& statistics) const {
+		statistics.heaps = heaps;
+		if (input.memoryBudget) {
+			vk::StructureChain<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT> properties =
+				input.physicalDevice.getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+			const vk::PhysicalDeviceMemoryBudgetPropertiesEXT& budget = properties.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+			for (size_t i = 0; i < statistics.heaps.size(); i++) {
+				statistics.heaps[i].budget = budget.heapBudget[i];
+				statistics.heaps[i].usage = budget.heapUsage[i];
+			}
+			statistics.driverBudget = true;
+			return;
+		}
+
+		for (HeapStatistics& heap : statistics.heaps) {
+			heap.budget = static_cast<vk::DeviceSize>(heap.size * MEMORY_BUDGET_HEAP_SHARE);
+			heap.usage = heap.reserved;
+		}
+	}
+
+	MemoryStatistics DeviceAllocator::getStatistics() {
+		MemoryStatistics statistics;
+		std::lock_guard<std::mutex> lock(mutex);
+		queryBudget(statistics);
+		return statistics;
+	}
+
+	vk::DeviceSize DeviceAllocator::getAvailable(vk::MemoryPropertyFlags properties) {
+		uint32_t memoryType = findMemoryTypeIndex(input.physicalDevice, UINT32_MAX, properties);
+		if (memoryType == UINT32_MAX) {
+			return 0;
+		}
+		uint32_t heapIndex = memoryProperties.memoryTypes[memoryType].heapIndex;
+
+		MemoryStatistics statistics;
+		std::lock_guard<std::mutex> lock(mutex);
+		queryBudget(statistics);
+		const HeapStatistics& heap = statistics.heaps[heapIndex];
+		vk::DeviceSize available = heap.budget > heap.usage ? heap.budget - heap.usage : 0;
+
+		// space left in blocks is already counted as used, but resources can still go there
+		for (const MemoryBlock* block : blocks) {
+			if (memoryProperties.memoryTypes[block->memoryType].heapIndex == heapIndex) {
+				available += block->size - block->allocatedSize;
+			}
+		}
+		return available;
+	}
+
+	void DeviceAllocator::report() {
+		MemoryStatistics statistics = getStatistics();
+
+		std::cout << std::fixed << std::setprecision(1);
+		std::cout << "Device memory" << (statistics.driverBudget ? "" : ", budgets estimated without VK_EXT_memory_budget") << std::endl;
+		for (size_t i = 0; i < statistics.heaps.size(); i++) {
+			const HeapStatistics& heap = statistics.heaps[i];
+			std::cout << "\tHeap " << i << (heap.deviceLocal ? " (device local, " : " (") << toMegabytes(heap.size) << "MB): "
+				<< toMegabytes(heap.usage) << "MB used of " << toMegabytes(heap.budget) << "MB budget, "
+				<< toMegabytes(heap.reserved) << "MB held by the allocator (peak " << toMegabytes(heap.peakReserved) << "MB)" << std::endl;
+
+			for (uint32_t category = 0; category < MEMORY_CATEGORY_COUNT; category++) {
+				if (heap.peakAllocated[category] == 0) {
+					continue;
+				}
+				std::cout << "\t\t" << getCategoryName(static_cast<MemoryCategory>(category)) << ": "
+					<< toMegabytes(heap.allocated[category]) << "MB (peak " << toMegabytes(heap.peakAllocated[category]) << "MB)" << std::endl;
+			}
+		}
+		std::cout << std::defaultfloat;
+	}
+
+	FragmentationStatistics DeviceAllocator::getFragmentation() {
+		FragmentationStatistics statistics;
+		vk::DeviceSize freeSize = 0;
+		std::lock_guard<std::mutex> lock(mutex);
+		for (const MemoryBlock* block : blocks) {
+			statistics.blockCount++;
+			statistics.blockSize += block->size;
+			statistics.allocatedSize += block->allocatedSize;
+			if (block->allocationCount == 0) {
+				statistics.emptyBlockCount++;
+			}
+
+			// merged away nodes are never free, so these are exactly the block's free ranges
+			for (const MemoryNode& node : block->nodes) {
+				if (node.free) {
+					statistics.freeRangeCount++;
+					statistics.largestFreeRange = std::max(statistics.largestFreeRange, node.size);
+					freeSize += node.size;
+				}
+			}
+		}
+
+		if (freeSize > 0) {
+			statistics.fragmentation = 1.0f - static_cast<float>(statistics.largestFreeRange) / freeSize;
+		}
+		return statistics;
+	}
+
+	Allocation DeviceAllocator::allocateMove(const Allocation& allocation, const vk::MemoryRequirements& requirements) {
+		Allocation moved;
+		if (!allocation.block) {
+			return moved;
+		}
+
+		vk::DeviceSize size = alignUp(std::max(requirements.size, MEMORY_MIN_ALIGNMENT), MEMORY_MIN_ALIGNMENT);
+		vk::DeviceSize alignment = std::max(requirements.alignment, MEMORY_MIN_ALIGNMENT);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		MemoryBlock* source = allocation.block;
+		size_t sourceIndex = std::find(blocks.begin(), blocks.end(), source) - blocks.begin();
+
+		// fuller blocks of the same kind, fullest first, ties going to the block made earlier
+		std::vector<size_t> candidates;
+		for (size_t i = 0; i < blocks.size(); i++) {
+			const MemoryBlock* candidate = blocks[i];
+			if (candidate == source || candidate->memoryType != source->memoryType || candidate->tiling != source->tiling) {
+				continue;
+			}
+			if (candidate->allocatedSize > source->allocatedSize || (candidate->allocatedSize == source->allocatedSize && i < sourceIndex)) {
+				candidates.push_back(i);
+			}
+		}
+		std::stable_sort(candidates.begin(), candidates.end(), [this](size_t a, size_t b) {
+			return blocks[a]->allocatedSize > blocks[b]->allocatedSize;
+		});
+
+		MemoryBlock* block = nullptr;
+		uint32_t node = NO_MEMORY_NODE;
+		for (size_t i : candidates) {
+			node = allocateNode(*blocks[i], size, alignment);
+			if (node != NO_MEMORY_NODE) {
+				block = blocks[i];
+				break;
+			}
+		}
+
+		// failing that, anywhere lower in its own block packs the free space toward the end
+		if (!block) {
+			node = allocateNode(*source, size, alignment);
+			if (node == NO_MEMORY_NODE) {
+				return moved;
+			}
+			if (source->nodes[node].offset >= allocation.offset) {
+				freeNode(*source, node);
+				return moved;
+			}
+			block = source;
+		}
+
+		block->allocatedSize += block->nodes[node].size;
+		block->allocationCount++;
+
+		moved.memory = block->memory;
+		moved.offset = block->nodes[node].offset;
+		moved.size = block->nodes[node].size;
+		moved.data = block->data ? block->data + moved.offset : nullptr;
+		moved.allocator = this;
+		moved.block = block;
+		moved.node = node;
+		addAllocated(moved, block->memoryType, allocation.category);
+		return moved;
+	}
+
+	vk::DeviceSize DeviceAllocator::getBlockAllocatedSize(const Allocation& allocation) {
+		std::lock_guard<std::mutex> lock(mutex);
+		return allocation.block ? allocation.block->allocatedSize : 0;
+	}
+
+	const char* getCategoryName(MemoryCategory category) {
+		switch (category) {
+		case MemoryCategory::MESH:
+			return "mesh";
+		case MemoryCategory::TEXTURE:
+			return "texture";
+		case MemoryCategory::GBUFFER:
+			return "g-buffer";
+		case MemoryCategory::FRAME:
+			return "per frame";
+		case MemoryCategory::STAGING:
+			return "staging";
+		default:
+			return "other";
+		}
+	}
+
+	Allocation allocateMemory(const AllocationInput& input) {
+		if (input.allocator) {
+			return input.allocator->allocate(input);
+		}
+
+		uint32_t memoryType = findMemoryTypeIndex(input.physicalDevice, input.requirements.memoryTypeBits, input.properties);
+		bool hostVisible = static_cast<bool>(input.properties & vk::MemoryPropertyFlagBits::eHostVisible);
+		return allocateDedicated(input, memoryType, hostVisible);
+	}
+
+	void freeMemory(vk::Device device, Allocation& allocation) {
+		if (allocation.allocator) {
+			allocation.allocator->free(allocation);
+			return;
+		}
+
+		if (allocation.data) {
+			device.unmapMemory(allocation.memory);
+		}
+		device.freeMemory(allocation.memory);
+		allocation = Allocation();
+	}
+}
@@ -0,0 +1,192 @@
+#pragma once
+#include "../config.h"
+
+/*
+	Places resources in a few large blocks of device memory instead of
+	allocating memory per buffer or image, which soon runs into
+	maxMemoryAllocationCount and costs a driver call for every resource.
+	Blocks are kept per memory type, and when the device has a
+	bufferImageGranularity, per linear or optimal tiling too so the two
+	never share a page. Free ranges in a block are indexed two level
+	segregated fit (TLSF) style, any fitting range is found in constant
+	time and freed ranges merge with free neighbours straight away.
+	Resources bigger than half a block get memory of their own. Memory is
+	allocated and freed from any thread.
+
+	Every range is tallied per heap under the category it was allocated
+	for, alongside what the allocator holds from the device in blocks and
+	dedicated memory, each with the peak it's reached. Where the device has
+	VK_EXT_memory_budget the driver's own budget and usage for the heap are
+	reported too, which take in other processes and memory allocated
+	outside the allocator. Without it the budget is guessed at a share of
+	the heap and the usage is only what the allocator holds.
+
+	Blocks fragment as resources come and go. allocateMove finds a better
+	place for a range that's already allocated, which the Defragmenter
+	copies resources into so emptied blocks can be freed.
+*/
+namespace vkUtilities {
+	// blocks are this big, or an eighth of their heap when the heap is small
+	static const vk::DeviceSize MEMORY_BLOCK_SIZE = 256 * 1024 * 1024;
+	// offsets and sizes in a block are multiples of this
+	static const vk::DeviceSize MEMORY_MIN_ALIGNMENT = 16;
+	// ranges under this size get a class per MEMORY_MIN_ALIGNMENT, bigger ones a first level per power of two
+	static const uint32_t TLSF_SMALL_SIZE_LOG2 = 8;
+	static const uint32_t TLSF_SECOND_LEVEL_LOG2 = 4;
+	static const uint32_t TLSF_SECOND_LEVELS = 1 << TLSF_SECOND_LEVEL_LOG2;
+	static const uint32_t TLSF_FIRST_LEVELS = 48;
+	static const uint32_t NO_MEMORY_NODE = UINT32_MAX;
+	// without VK_EXT_memory_budget a heap is assumed to have this share of itself to spare
+	static const float MEMORY_BUDGET_HEAP_SHARE = 0.8f;
+
+	// buffers and linearly tiled images are linear, an optimal image mustn't share a granularity page with one
+	enum class ResourceTiling {
+		LINEAR,
+		OPTIMAL
+	};
+
+	struct AllocationInput {
+		vk::Device device;
+		vk::PhysicalDevice physicalDevice;
+		// when null the memory is allocated on its own
+		DeviceAllocator* allocator = nullptr;
+		vk::MemoryRequirements requirements;
+		vk::MemoryPropertyFlags properties;
+		ResourceTiling tiling = ResourceTiling::LINEAR;
+		MemoryCategory category = MemoryCategory::OTHER;
+	};
+
+	// a range of a block, free or allocated, linked to the ranges either side of it and to others of its size class while free
+	struct MemoryNode {
+		vk::DeviceSize offset;
+		vk::DeviceSize size;
+		uint32_t previous;
+		uint32_t next;
+		uint32_t previousFree;
+		uint32_t nextFree;
+		bool free;
+	};
+
+	struct MemoryBlock {
+		vk::DeviceMemory memory;
+		vk::DeviceSize size;
+		uint32_t memoryType;
+		ResourceTiling tiling;
+		// host visible blocks are mapped as long as they're allocated
+		unsigned char* data = nullptr;
+		vk::DeviceSize allocatedSize = 0;
+		uint32_t allocationCount = 0;
+
+		std::vector<MemoryNode> nodes;
+		// spare entries in nodes, left by ranges that merged into a neighbour
+		std::vector<uint32_t> unusedNodes;
+		// a bit per first level with any free range, and per second level within it
+		uint64_t firstLevelMap = 0;
+		uint32_t secondLevelMaps[TLSF_FIRST_LEVELS];
+		uint32_t freeLists[TLSF_FIRST_LEVELS][TLSF_SECOND_LEVELS];
+	};
+
+	struct DeviceAllocatorInput {
+		vk::Device device;
+		vk::PhysicalDevice physicalDevice;
+		vk::DeviceSize blockSize = MEMORY_BLOCK_SIZE;
+		// VK_EXT_memory_budget was enabled on the device
+		bool memoryBudget = false;
+		bool debug = false;
+	};
+
+	struct HeapStatistics {
+		vk::DeviceSize size = 0;
+		bool deviceLocal = false;
+		// how much the process may use and is using, from the driver when it can say
+		vk::DeviceSize budget = 0;
+		vk::DeviceSize usage = 0;
+		// blocks and dedicated memory the allocator holds
+		vk::DeviceSize reserved = 0;
+		vk::DeviceSize peakReserved = 0;
+		// what resources take of it, block space not handed out counts for nothing
+		vk::DeviceSize allocated[MEMORY_CATEGORY_COUNT] = {};
+		vk::DeviceSize peakAllocated[MEMORY_CATEGORY_COUNT] = {};
+	};
+
+	struct MemoryStatistics {
+		std::vector<HeapStatistics> heaps;
+		// budget and usage came from VK_EXT_memory_budget
+		bool driverBudget = false;
+	};
+
+	// how the free space in every block is split up
+	struct FragmentationStatistics {
+		uint32_t blockCount = 0;
+		uint32_t emptyBlockCount = 0;
+		vk::DeviceSize blockSize = 0;
+		vk::DeviceSize allocatedSize = 0;
+		uint32_t freeRangeCount = 0;
+		vk::DeviceSize largestFreeRange = 0;
+		// none when the free space is all one range, toward one as it's split into more and smaller pieces
+		float fragmentation = 0.0f;
+	};
+
+	const char* getCategoryName(MemoryCategory category);
+
+	class DeviceAllocator {
+	public:
+		void create(DeviceAllocatorInput input);
+		// a range meeting the requirements in memory with the properties asked for, null memory when there's none left
+		Allocation allocate(const AllocationInput& input);
+		void free(Allocation& allocation);
+		MemoryStatistics getStatistics();
+		// bytes that can still be allocated with these properties before the heap they'd come from is over budget
+		vk::DeviceSize getAvailable(vk::MemoryPropertyFlags properties);
+		// prints every heap's budget, usage and peaks, with a line per category it holds
+		void report();
+
+		FragmentationStatistics getFragmentation();
+		/*
+			A range for a resource moving out of allocation, in a fuller block
+			of the same kind or lower in its own, or null memory when there's
+			nowhere better. Ranges only ever move one way, so moving every
+			resource over and over settles. allocation is left allocated until
+			the resource has been copied out and it's freed.
+		*/
+		Allocation allocateMove(const Allocation& allocation, const vk::MemoryRequirements& requirements);
+		// bytes allocated in the block the allocation is in, resources in emptier blocks are moved first
+		vk::DeviceSize getBlockAllocatedSize(const Allocation& allocation);
+		// frees every block, whatever is still allocated in them is reported in debug mode
+		void destroy();
+
+	private:
+		DeviceAllocatorInput input;
+		vk::PhysicalDeviceMemoryProperties memoryProperties;
+		vk::DeviceSize bufferImageGranularity = 1;
+		std::vector<MemoryBlock*> blocks;
+		uint32_t dedicatedCount = 0;
+		std::vector<HeapStatistics> heaps;
+		std::mutex mutex;
+
+		vk::DeviceSize getBlockSize(uint32_t memoryType) const;
+		// a new empty block, or null when the heap is out of memory
+		MemoryBlock* makeBlock(uint32_t memoryType, ResourceTiling tiling);
+		void destroyBlock(MemoryBlock* block);
+		void addReserved(uint32_t memoryType, vk::DeviceSize size);
+		void addAllocated(Allocation& allocation, uint32_t memoryType, MemoryCategory category);
+		void removeAllocated(const Allocation& allocation);
+		// the driver's figures for every heap, or the fallbacks, with the lock held
+		void queryBudget(MemoryStatistics& statistics) const;
+
+		// the size class a range of size bytes is filed under
+		static void mapSize(vk::DeviceSize size, uint32_t& firstLevel, uint32_t& secondLevel);
+		static void insertFree(MemoryBlock& block, uint32_t node);
+		static void removeFree(MemoryBlock& block, uint32_t node);
+		static uint32_t makeNode(MemoryBlock& block, vk::DeviceSize offset, vk::DeviceSize size);
+		// the node allocated for size bytes at a multiple of alignment, or NO_MEMORY_NODE if the block has no room
+		static uint32_t allocateNode(MemoryBlock& block, vk::DeviceSize size, vk::DeviceSize alignment);
+		static void freeNode(MemoryBlock& block, uint32_t node);
+	};
+
+	// allocates through input.allocator when there is one, otherwise memory of its own
+	Allocation allocateMemory(const AllocationInput& input);
+
+	// frees memory from allocateMemory, either way it was made
+	void freeMemory(vk::Device device, Allocation& allocation);
+}
@@ -1,27 +1,26 @@
 #pragma once
 #include "../config.h"
+#include "MappedFile.h"
 
 namespace vkUtilities {
 	inline std::vector<char> readFile(std::string filename, bool debug = false) {
-		std::ifstream file(filename, std::ios::ate | std::ios::binary);
-
-		if (debug && !file.is_open()) {
-			std::cout << "Failed to load \"" << filename << "\"" << std::endl;
+		MappedFile file;
+		if (!file.open(filename)) {
+			if (debug) {
+				std::cout << "Failed to load \"" << filename << "\"" << std::endl;
+			}
+			return {};
 		}
 
-		// get number of bytes/characters
-		size_t filesize(static_cast<size_t>(file.tellg()));
-
-		std::vector<char> buffer(filesize);
-		file.seekg(0);
-		file.read(buffer.data(), filesize);
-
-		file.close();
-		return buffer;
+		return std::vector<char>(file.getData(), file.getData() + file.getSize());
 	}
 
 	inline vk::ShaderModule createModule(std::string filename, vk::Device device, bool debug = false) {
 		std::vector<char> fileContents = readFile(filename, debug);
+		// a missing or unbuilt shader, zero bytes of code is never a valid module
+		if (fileContents.empty()) {
+			return nullptr;
+		}
 
 		// setup create info
 		vk::ShaderModuleCreateInfo createInfo = {};
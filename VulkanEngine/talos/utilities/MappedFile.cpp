@@ -0,0 +1,163 @@
+#include "MappedFile.h"
+#include "AssetArchive.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vkUtilities {
+	MappedFile::~MappedFile() {
+		close();
+	}
+
+	MappedFile::MappedFile(MappedFile&& other) noexcept {
+		*this = std::move(other);
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+		if (this == &other) {
+			return *this;
+		}
+
+		close();
+		data = other.data;
+		size = other.size;
+		opened = other.opened;
+		borrowed = other.borrowed;
+#ifdef _WIN32
+		fileHandle = other.fileHandle;
+		mappingHandle = other.mappingHandle;
+		other.fileHandle = nullptr;
+		other.mappingHandle = nullptr;
+#endif
+		other.data = nullptr;
+		other.size = 0;
+		other.opened = false;
+		other.borrowed = false;
+
+		return *this;
+	}
+
+	bool MappedFile::open(const std::string& filepath) {
+		const AssetArchive* archive = getMountedArchive();
+		const ArchiveEntry* entry = archive ? archive->find(filepath) : nullptr;
+		if (entry && entry->compression == static_cast<uint32_t>(ArchiveCompression::NONE)) {
+			close();
+			data = archive->getEntryData(*entry);
+			size = static_cast<size_t>(entry->size);
+			opened = true;
+			borrowed = true;
+			return true;
+		}
+
+		return openFromDisk(filepath);
+	}
+
+	bool MappedFile::openFromDisk(const std::string& filepath) {
+		close();
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize)) {
+			CloseHandle(file);
+			return false;
+		}
+
+		fileHandle = file;
+		size = static_cast<size_t>(fileSize.QuadPart);
+		opened = true;
+
+		// windows refuses to map empty files, but an empty file is still a valid open
+		if (size == 0) {
+			return true;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping) {
+			close();
+			return false;
+		}
+		mappingHandle = mapping;
+
+		data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (!data) {
+			close();
+			return false;
+		}
+#else
+		int file = ::open(filepath.c_str(), O_RDONLY);
+		if (file < 0) {
+			return false;
+		}
+
+		struct stat fileInfo;
+		if (fstat(file, &fileInfo) != 0) {
+			::close(file);
+			return false;
+		}
+
+		size = static_cast<size_t>(fileInfo.st_size);
+		opened = true;
+
+		if (size > 0) {
+			void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+			if (mapping == MAP_FAILED) {
+				::close(file);
+				size = 0;
+				opened = false;
+				return false;
+			}
+			data = static_cast<const char*>(mapping);
+		}
+
+		// the mapping keeps the file alive on its own
+		::close(file);
+#endif
+
+		return true;
+	}
+
+	void MappedFile::close() {
+		if (borrowed) {
+			data = nullptr;
+			size = 0;
+			opened = false;
+			borrowed = false;
+			return;
+		}
+
+#ifdef _WIN32
+		if (data) {
+			UnmapViewOfFile(data);
+		}
+		if (mappingHandle) {
+			CloseHandle(static_cast<HANDLE>(mappingHandle));
+			mappingHandle = nullptr;
+		}
+		if (fileHandle) {
+			CloseHandle(static_cast<HANDLE>(fileHandle));
+			fileHandle = nullptr;
+		}
+#else
+		if (data) {
+			munmap(const_cast<char*>(data), size);
+		}
+#endif
+
+		data = nullptr;
+		size = 0;
+		opened = false;
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "../config.h"
+
+/*
+	Read only memory mapping of a file on disk, or a view of it inside the
+	mounted asset archive
+*/
+namespace vkUtilities {
+	class MappedFile {
+	public:
+		MappedFile() {};
+		~MappedFile();
+
+		// mappings own OS handles, so they can be moved but not copied
+		MappedFile(const MappedFile& other) = delete;
+		MappedFile& operator=(const MappedFile& other) = delete;
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		// looks in the mounted asset archive first
+		bool open(const std::string& filepath);
+		bool openFromDisk(const std::string& filepath);
+		void close();
+
+		bool isOpen() const { return opened; }
+		const char* getData() const { return data; }
+		size_t getSize() const { return size; }
+
+	private:
+		const char* data = nullptr;
+		size_t size = 0;
+		bool opened = false;
+		// views into the archive's mapping don't unmap anything
+		bool borrowed = false;
+
+#ifdef _WIN32
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+#endif
+	};
+}
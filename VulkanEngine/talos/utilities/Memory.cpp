@@ -22,14 +22,24 @@ uint32_t vkUtilities::findMemoryTypeIndex(vk::PhysicalDevice physicalDevice, uin
 
 void vkUtilities::allocateBufferMemory(Buffer& buffer, const BufferInput& input) {
 
-	vk::MemoryRequirements memoryRequirements = input.device.getBufferMemoryRequirements(buffer.buffer);
-
-	// allocate memory to the buffer
-	vk::MemoryAllocateInfo allocInfo;
-	allocInfo.allocationSize = memoryRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryTypeIndex(input.physicalDevice, memoryRequirements.memoryTypeBits, input.memoryProperties);
-	buffer.bufferMemory = input.device.allocateMemory(allocInfo);
-	input.device.bindBufferMemory(buffer.buffer, buffer.bufferMemory, 0);
+	AllocationInput allocationInput;
+	allocationInput.device = input.device;
+	allocationInput.physicalDevice = input.physicalDevice;
+	allocationInput.allocator = input.allocator;
+	allocationInput.requirements = input.device.getBufferMemoryRequirements(buffer.buffer);
+	allocationInput.properties = input.memoryProperties;
+	allocationInput.tiling = ResourceTiling::LINEAR;
+	allocationInput.category = input.category;
+
+	// allocate memory to the buffer, which may be part of a block shared with other resources
+	buffer.bufferMemory = allocateMemory(allocationInput);
+	input.device.bindBufferMemory(buffer.buffer, buffer.bufferMemory.memory, buffer.bufferMemory.offset);
+}
+
+void vkUtilities::destroyBuffer(vk::Device device, Buffer& buffer) {
+	device.destroyBuffer(buffer.buffer);
+	freeMemory(device, buffer.bufferMemory);
+	buffer.buffer = nullptr;
 }
 
 void vkUtilities::copyBuffer(Buffer& sourceBuffer, Buffer& destinationBuffer, vk::DeviceSize size, vk::Queue queue, vk::CommandBuffer commandBuffer) {
@@ -55,6 +65,8 @@ Buffer vkUtilities::createBuffer(BufferInput input) {
 	bufferCreateInfo.usage = input.usage;
 	bufferCreateInfo.sharingMode = vk::SharingMode::eExclusive;
 	buffer.buffer = input.device.createBuffer(bufferCreateInfo);
+	buffer.size = input.size;
+	buffer.usage = input.usage;
 
 	// Allocate buffer memory
 	allocateBufferMemory(buffer, input);
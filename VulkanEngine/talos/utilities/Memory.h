@@ -1,5 +1,6 @@
 #pragma once
 #include "../config.h"
+#include "DeviceAllocator.h"
 
 namespace vkUtilities {
 
@@ -9,5 +10,8 @@ namespace vkUtilities {
 
 	Buffer createBuffer(BufferInput input);
 
+	// destroys the buffer and gives its memory back to wherever it came from
+	void destroyBuffer(vk::Device device, Buffer& buffer);
+
 	void copyBuffer(Buffer& sourceBuffer, Buffer& destinationBuffer, vk::DeviceSize size, vk::Queue queue, vk::CommandBuffer commandBuffer);
 }
\ No newline at end of file
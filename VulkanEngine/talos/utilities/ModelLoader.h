@@ -1,14 +1,18 @@
 #pragma once
 #include "../config.h"
+#include "MappedFile.h"
+#include <sstream>
 
 namespace talos {
 	namespace util {
 		static std::unordered_map<std::string, std::vector<std::string>> getAssetDependencies(const char* assetFilepath, bool debug = false) {
-			std::ifstream file;
-			file.open(assetFilepath);
+			// descriptors may live in the asset archive
+			vkUtilities::MappedFile mappedFile;
+			bool opened = mappedFile.open(assetFilepath);
+			std::stringstream file(opened ? std::string(mappedFile.getData(), mappedFile.getSize()) : std::string());
 			std::unordered_map<std::string, std::vector<std::string>> assetFilepaths;
 
-			if (debug && !file.is_open()) {
+			if (debug && !opened) {
 				std::cout << "Failed to load \"" << assetFilepath << "\"" << std::endl;
 				return assetFilepaths;
 			}
@@ -36,8 +40,6 @@ namespace talos {
 				currentPaths.push_back(dependencyFilepath);
 				assetFilepaths[dependencyType] = currentPaths;
 			}
-			file.close();
-
 			return assetFilepaths;
 		}
 	}
@@ -9,6 +9,9 @@ namespace vkUtilities {
 		// note: generally graphics and present queue index can be sent to the same
 		std::optional<uint32_t> presentFamily;
 
+		// a family that can copy but not draw or present, when the device has one uploads run beside rendering on it
+		std::optional<uint32_t> transferFamily;
+
 		bool isComplete() {
 			return graphicsFamily.has_value() && presentFamily.has_value();
 		}
@@ -53,6 +56,33 @@ namespace vkUtilities {
 			i++;
 		}
 
+		// copy engines that can't compute either are the most independent of the graphics queue
+		for (uint32_t family = 0; family < queueProperties.size(); family++) {
+			vk::QueueFlags flags = queueProperties[family].queueFlags;
+			if (!(flags & vk::QueueFlagBits::eTransfer) || (flags & vk::QueueFlagBits::eGraphics)) {
+				continue;
+			}
+
+			// a family without graphics can still present, and then its queue is already spoken for
+			if (indices.presentFamily.has_value() && family == indices.presentFamily.value()) {
+				continue;
+			}
+
+			// mip tails are a texel or two across, so copies have to be allowed down to single texels
+			vk::Extent3D granularity = queueProperties[family].minImageTransferGranularity;
+			if (granularity.width != 1 || granularity.height != 1 || granularity.depth != 1) {
+				continue;
+			}
+
+			if (!indices.transferFamily.has_value() || !(flags & vk::QueueFlagBits::eCompute)) {
+				indices.transferFamily = family;
+			}
+		}
+
+		if (debug && indices.transferFamily.has_value()) {
+			std::cout << "Queue family " << indices.transferFamily.value() << " is a dedicated transfer family" << std::endl;
+		}
+
 		return indices;
 	}
 };
\ No newline at end of file
@@ -0,0 +1,213 @@
+#include "StagingRing.h"
+#include "Memory.h"
+#include <algorithm>
+#include <chrono>
+
+namespace vkUtilities {
+	void StagingRing::create(StagingRingInput input) {
+		this->input = input;
+
+		BufferInput bufferInput;
+		bufferInput.device = input.device;
+		bufferInput.physicalDevice = input.physicalDevice;
+		bufferInput.size = input.size;
+		bufferInput.usage = vk::BufferUsageFlagBits::eTransferSrc;
+		bufferInput.memoryProperties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+		bufferInput.allocator = input.allocator;
+		bufferInput.category = MemoryCategory::STAGING;
+		buffer = createBuffer(bufferInput);
+		data = buffer.bufferMemory.data;
+
+		allocations.clear();
+		head = 0;
+	}
+
+	vk::DeviceSize StagingRing::getSize() const {
+		return input.size;
+	}
+
+	bool StagingRing::findSpace(vk::DeviceSize size, vk::DeviceSize& offset) const {
+		if (allocations.empty()) {
+			offset = 0;
+			return size <= input.size;
+		}
+
+		// past the newest region up to the end, or else from the start up to the oldest one
+		vk::DeviceSize tail = allocations.front().offset;
+		if (allocations.back().offset >= tail) {
+			if (head + size <= input.size) {
+				offset = head;
+				return true;
+			}
+			offset = 0;
+			return size <= tail;
+		}
+
+		offset = head;
+		return head + size <= tail;
+	}
+
+	void StagingRing::reclaim() {
+		for (size_t i = 0; i < pending.size();) {
+			if (input.device.getFenceStatus(pending[i].fence) == vk::Result::eSuccess) {
+				input.device.resetFences(pending[i].fence);
+				freeFences.push_back(pending[i].fence);
+				pending.erase(pending.begin() + i);
+			}
+			else {
+				i++;
+			}
+		}
+
+		// regions are only ever freed oldest first, a newer one that's done waits for the ones before it
+		while (!allocations.empty() && allocations.front().released) {
+			uint64_t submission = allocations.front().submission;
+			bool finished = std::none_of(pending.begin(), pending.end(), [submission](const Submission& pendingSubmission) {
+				return pendingSubmission.id == submission;
+			});
+			if (!finished) {
+				break;
+			}
+			allocations.pop_front();
+		}
+
+		if (allocations.empty()) {
+			head = 0;
+		}
+	}
+
+	StagingRegion StagingRing::reserve(vk::DeviceSize size) {
+		StagingRegion region;
+		size = std::max(STAGING_ALIGNMENT, (size + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT);
+		region.size = size;
+
+		// waiting couldn't ever free enough, so this one gets its own buffer
+		if (size > input.size) {
+			BufferInput bufferInput;
+			bufferInput.device = input.device;
+			bufferInput.physicalDevice = input.physicalDevice;
+			bufferInput.size = size;
+			bufferInput.usage = vk::BufferUsageFlagBits::eTransferSrc;
+			bufferInput.memoryProperties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+			bufferInput.allocator = input.allocator;
+			bufferInput.category = MemoryCategory::STAGING;
+			region.overflow = createBuffer(bufferInput);
+			region.buffer = region.overflow.buffer;
+			region.data = region.overflow.bufferMemory.data;
+			return region;
+		}
+
+		// space comes back either from a release or from a fence signalling, and fences don't wake anyone
+		std::unique_lock<std::mutex> lock(mutex);
+		vk::DeviceSize offset;
+		reclaim();
+		while (!findSpace(size, offset)) {
+			released.wait_for(lock, std::chrono::milliseconds(1));
+			reclaim();
+		}
+
+		allocations.push_back(Allocation{ offset, size, 0, false });
+		head = offset + size;
+
+		region.buffer = buffer.buffer;
+		region.offset = offset;
+		region.data = data + offset;
+		return region;
+	}
+
+	void StagingRing::release(StagingRegion& region, uint64_t submission) {
+		if (!region.data) {
+			return;
+		}
+
+		if (region.overflow.buffer) {
+			// overflow buffers are only made for one off uploads, which are finished by the time they're released
+			wait(submission);
+			destroyBuffer(input.device, region.overflow);
+		}
+		else {
+			std::lock_guard<std::mutex> lock(mutex);
+			for (Allocation& allocation : allocations) {
+				if (allocation.offset == region.offset && !allocation.released) {
+					allocation.released = true;
+					allocation.submission = submission;
+					break;
+				}
+			}
+		}
+
+		region = StagingRegion();
+		released.notify_all();
+	}
+
+	uint64_t StagingRing::submit(vk::CommandBuffer commandBuffer, vk::Queue queue) {
+		vk::Fence fence;
+		uint64_t id;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (freeFences.empty()) {
+				fence = input.device.createFence(vk::FenceCreateInfo());
+			}
+			else {
+				fence = freeFences.back();
+				freeFences.pop_back();
+			}
+			id = nextSubmission++;
+		}
+
+		vk::SubmitInfo submitInfo;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+		try {
+			// loaders on several threads can share a queue, and submitting to one has to be serialized
+			std::lock_guard<std::mutex> submitLock(submitMutex);
+			queue.submit(1, &submitInfo, fence);
+		}
+		catch (vk::SystemError err) {
+			std::cout << "Failed to submit staged upload" << std::endl;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		pending.push_back(Submission{ id, fence });
+		return id;
+	}
+
+	bool StagingRing::isFinished(uint64_t submission) {
+		std::lock_guard<std::mutex> lock(mutex);
+		reclaim();
+		return std::none_of(pending.begin(), pending.end(), [submission](const Submission& pendingSubmission) {
+			return pendingSubmission.id == submission;
+		});
+	}
+
+	void StagingRing::wait(uint64_t submission) {
+		// another thread may recycle the fence the moment it signals, so it's polled rather than waited on
+		while (!isFinished(submission)) {
+			std::this_thread::yield();
+		}
+	}
+
+	void StagingRing::destroy() {
+		if (!buffer.buffer) {
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (const Submission& submission : pending) {
+				input.device.waitForFences(1, &submission.fence, VK_TRUE, UINT64_MAX);
+				freeFences.push_back(submission.fence);
+			}
+			pending.clear();
+			for (vk::Fence fence : freeFences) {
+				input.device.destroyFence(fence);
+			}
+			freeFences.clear();
+		}
+
+		destroyBuffer(input.device, buffer);
+		data = nullptr;
+		allocations.clear();
+		head = 0;
+	}
+}
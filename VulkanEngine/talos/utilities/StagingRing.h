@@ -0,0 +1,80 @@
+#pragma once
+#include "../config.h"
+#include <condition_variable>
+#include <deque>
+
+/*
+	One host visible buffer mapped for the engine's whole life that every
+	upload stages through. Regions are handed out in order around the ring
+	and come back once the submission that read them has signalled its
+	fence, so a loader that finds the ring full waits on the GPU rather than
+	making a buffer of its own. Regions are reserved and released from any
+	thread.
+*/
+namespace vkUtilities {
+	// copies out of a region start on a multiple of this, enough for every texel block size
+	static const vk::DeviceSize STAGING_ALIGNMENT = 16;
+
+	struct StagingRingInput {
+		vk::Device device;
+		vk::PhysicalDevice physicalDevice;
+		vk::DeviceSize size;
+		// the ring and any overflow buffers are placed in its blocks
+		DeviceAllocator* allocator = nullptr;
+	};
+
+	struct StagingRegion {
+		vk::Buffer buffer;
+		vk::DeviceSize offset = 0;
+		vk::DeviceSize size = 0;
+		unsigned char* data = nullptr;
+		// only set for regions bigger than the whole ring, which get a buffer to themselves
+		Buffer overflow;
+	};
+
+	class StagingRing {
+	public:
+		void create(StagingRingInput input);
+		// waits until size bytes in a row are free, the region is the caller's until release
+		StagingRegion reserve(vk::DeviceSize size);
+		// the region is reused once submission has finished, zero when the device is already done with it
+		void release(StagingRegion& region, uint64_t submission = 0);
+		// submits a recorded command buffer with a fence the ring keeps track of
+		uint64_t submit(vk::CommandBuffer commandBuffer, vk::Queue queue);
+		bool isFinished(uint64_t submission);
+		void wait(uint64_t submission);
+		vk::DeviceSize getSize() const;
+		void destroy();
+
+	private:
+		struct Allocation {
+			vk::DeviceSize offset;
+			vk::DeviceSize size;
+			uint64_t submission;
+			bool released;
+		};
+
+		struct Submission {
+			uint64_t id;
+			vk::Fence fence;
+		};
+
+		StagingRingInput input;
+		Buffer buffer;
+		unsigned char* data = nullptr;
+		// oldest first, the ring's free space runs from the newest one's end round to the oldest one's start
+		std::deque<Allocation> allocations;
+		vk::DeviceSize head = 0;
+		std::vector<Submission> pending;
+		std::vector<vk::Fence> freeFences;
+		uint64_t nextSubmission = 1;
+		std::mutex mutex;
+		std::mutex submitMutex;
+		std::condition_variable released;
+
+		// recycles signalled fences and frees the oldest regions nothing reads anymore, with the lock held
+		void reclaim();
+		// where size bytes fit, or false if they don't yet, with the lock held
+		bool findSpace(vk::DeviceSize size, vk::DeviceSize& offset) const;
+	};
+}
@@ -7,35 +7,41 @@ namespace vkUtilities {
 			BufferInput input;
 			input.device = device;
 			input.physicalDevice = physicalDevice;
+			input.allocator = allocator;
+			input.category = MemoryCategory::FRAME;
 			input.memoryProperties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
 			input.size = sizeof(CameraMatrices);
 			input.usage = vk::BufferUsageFlagBits::eUniformBuffer;
 			cameraMatrixBuffer = createBuffer(input);
 
-			// map memory
-			cameraMatrixWriteLocation = device.mapMemory(cameraMatrixBuffer.bufferMemory, 0, input.size);
+			// host visible memory stays mapped
+			cameraMatrixWriteLocation = cameraMatrixBuffer.bufferMemory.data;
 
 			// Camera Data
 			input.device = device;
 			input.physicalDevice = physicalDevice;
+			input.allocator = allocator;
+			input.category = MemoryCategory::FRAME;
 			input.memoryProperties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
 			input.size = sizeof(CameraVectors);
 			input.usage = vk::BufferUsageFlagBits::eUniformBuffer;
 			cameraVectorBuffer = createBuffer(input);
 
-			// map memory
-			cameraVectorWriteLocation = device.mapMemory(cameraVectorBuffer.bufferMemory, 0, input.size);
+			// host visible memory stays mapped
+			cameraVectorWriteLocation = cameraVectorBuffer.bufferMemory.data;
 
 			// Model matrices
 			input.device = device;
 			input.physicalDevice = physicalDevice;
+			input.allocator = allocator;
+			input.category = MemoryCategory::FRAME;
 			input.memoryProperties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
 			input.size = 1024 * sizeof(glm::mat4);
 			input.usage = vk::BufferUsageFlagBits::eStorageBuffer;
 			modelTransformBuffer = createBuffer(input);
 
-			// map memory
-			modelTransformWriteLocation = device.mapMemory(modelTransformBuffer.bufferMemory, 0, input.size);
+			// host visible memory stays mapped
+			modelTransformWriteLocation = modelTransformBuffer.bufferMemory.data;
 			modelTransforms.reserve(1024);
 			for (int i = 0; i < 1024; i++) {
 				modelTransforms.push_back(glm::mat4(1.0f));
@@ -44,13 +50,15 @@ namespace vkUtilities {
 			// Lights
 			input.device = device;
 			input.physicalDevice = physicalDevice;
+			input.allocator = allocator;
+			input.category = MemoryCategory::FRAME;
 			input.memoryProperties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
 			input.size = sizeof(glm::vec4) + numSupportedLights * 2 * sizeof(glm::vec4);
 			input.usage = vk::BufferUsageFlagBits::eUniformBuffer;
 			lightBuffer = createBuffer(input);
 
-			// map memory
-			lightWriteLocation = device.mapMemory(lightBuffer.bufferMemory, 0, input.size);
+			// host visible memory stays mapped
+			lightWriteLocation = lightBuffer.bufferMemory.data;
 			for (int i = 0; i < numSupportedLights; i++) {
 				lightData.positions[i] = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
 				lightData.colors[i] = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
@@ -141,6 +149,22 @@ namespace vkUtilities {
 			modelWriteInfoPrepass.descriptorType = vk::DescriptorType::eStorageBuffer;
 			modelWriteInfoPrepass.pBufferInfo = &modelBufferDescriptor;
 
+			vk::WriteDescriptorSet materialWriteInfo;
+			materialWriteInfo.dstSet = vertexDescSet[RenderPassType::FORWARD];
+			materialWriteInfo.dstBinding = 2;
+			materialWriteInfo.dstArrayElement = 0;
+			materialWriteInfo.descriptorCount = 1;
+			materialWriteInfo.descriptorType = vk::DescriptorType::eStorageBuffer;
+			materialWriteInfo.pBufferInfo = &materialBufferDescriptor;
+
+			vk::WriteDescriptorSet materialWriteInfoPrepass;
+			materialWriteInfoPrepass.dstSet = vertexDescSet[RenderPassType::PREPASS];
+			materialWriteInfoPrepass.dstBinding = 2;
+			materialWriteInfoPrepass.dstArrayElement = 0;
+			materialWriteInfoPrepass.descriptorCount = 1;
+			materialWriteInfoPrepass.descriptorType = vk::DescriptorType::eStorageBuffer;
+			materialWriteInfoPrepass.pBufferInfo = &materialBufferDescriptor;
+
 			vk::WriteDescriptorSet lightWriteInfo;
 			lightWriteInfo.dstSet = fragDescSet[RenderPassType::FORWARD];
 			lightWriteInfo.dstBinding = 0;
@@ -165,7 +189,7 @@ namespace vkUtilities {
 			lightWriteInfoDeferred.descriptorType = vk::DescriptorType::eUniformBuffer;
 			lightWriteInfoDeferred.pBufferInfo = &lightBufferDescriptor;
 
-			writeOps = { camereaVectorWrite, cameraMatrixWrite, modelWriteInfo, lightWriteInfo, cameraMatrixWritePrepass, modelWriteInfoPrepass, lightWriteInfoDeferred, cameraMatrixWriteDeferredFrag };
+			writeOps = { camereaVectorWrite, cameraMatrixWrite, modelWriteInfo, materialWriteInfo, lightWriteInfo, cameraMatrixWritePrepass, modelWriteInfoPrepass, materialWriteInfoPrepass, lightWriteInfoDeferred, cameraMatrixWriteDeferredFrag };
 		}
 
 		void SwapChainFrame::writeDescriptorSets() {
@@ -183,6 +207,8 @@ namespace vkUtilities {
 			vkImage::ImageInput imageInfo;
 			imageInfo.device = device;
 			imageInfo.physicalDevice = physicalDevice;
+			imageInfo.allocator = allocator;
+			imageInfo.category = MemoryCategory::GBUFFER;
 			imageInfo.tiling = vk::ImageTiling::eOptimal;
 			imageInfo.usage = vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled;
 			imageInfo.memoryFlags = vk::MemoryPropertyFlagBits::eDeviceLocal;
@@ -204,6 +230,8 @@ namespace vkUtilities {
 			vkImage::ImageInput imageInfo;
 			imageInfo.device = device;
 			imageInfo.physicalDevice = physicalDevice;
+			imageInfo.allocator = allocator;
+			imageInfo.category = MemoryCategory::GBUFFER;
 			imageInfo.tiling = vk::ImageTiling::eOptimal;
 			imageInfo.usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled;
 			imageInfo.memoryFlags = vk::MemoryPropertyFlagBits::eDeviceLocal;
@@ -225,6 +253,8 @@ namespace vkUtilities {
 			vkImage::ImageInput imageInfo;
 			imageInfo.device = device;
 			imageInfo.physicalDevice = physicalDevice;
+			imageInfo.allocator = allocator;
+			imageInfo.category = MemoryCategory::GBUFFER;
 			imageInfo.tiling = vk::ImageTiling::eOptimal;
 			imageInfo.usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled;
 			imageInfo.memoryFlags = vk::MemoryPropertyFlagBits::eDeviceLocal;
@@ -237,7 +267,7 @@ namespace vkUtilities {
 		}
 
 		// Invalid formats
-		void SwapChainFrame::createImageResources(vkImage::ImageInput imageInput, vk::ImageAspectFlagBits flags, vk::Image& image, vk::DeviceMemory& memory, vk::ImageView& imageView) {
+		void SwapChainFrame::createImageResources(vkImage::ImageInput imageInput, vk::ImageAspectFlagBits flags, vk::Image& image, Allocation& memory, vk::ImageView& imageView) {
 			image = vkImage::makeImage(imageInput);
 			memory = vkImage::makeImageMemory(imageInput, image);
 			imageView = vkImage::makeImageView(device, image, imageInput.format, flags, vk::ImageViewType::e2D, 1);
@@ -255,22 +285,22 @@ namespace vkUtilities {
 
 		void SwapChainFrame::destroy() {
 			device.destroyImage(albedoBuffer);
-			device.freeMemory(albedoBufferMemory);
+			freeMemory(device, albedoBufferMemory);
 			device.destroyImageView(albedoBufferView);
 			albedoTexture.destroySampler();
 
 			device.destroyImage(normalBuffer);
-			device.freeMemory(normalBufferMemory);
+			freeMemory(device, normalBufferMemory);
 			device.destroyImageView(normalBufferView);
 			normalTexture.destroySampler();
 
 			device.destroyImage(prepassDepthBuffer);
-			device.freeMemory(prepassDepthBufferMemory);
+			freeMemory(device, prepassDepthBufferMemory);
 			device.destroyImageView(prepassDepthBufferView);
 			prepassDepthTexture.destroySampler();
 
 			device.destroyImage(depthBuffer);
-			device.freeMemory(depthBufferMemory);
+			freeMemory(device, depthBufferMemory);
 			device.destroyImageView(depthBufferView);
 
 			device.destroyImageView(imageView);
@@ -284,20 +314,12 @@ namespace vkUtilities {
 			device.destroySemaphore(renderSemaphore);
 			device.destroySemaphore(presentSemaphore);
 
-			device.unmapMemory(cameraMatrixBuffer.bufferMemory);
-			device.freeMemory(cameraMatrixBuffer.bufferMemory);
-			device.destroyBuffer(cameraMatrixBuffer.buffer);
+			destroyBuffer(device, cameraMatrixBuffer);
 
-			device.unmapMemory(cameraVectorBuffer.bufferMemory);
-			device.freeMemory(cameraVectorBuffer.bufferMemory);
-			device.destroyBuffer(cameraVectorBuffer.buffer);
+			destroyBuffer(device, cameraVectorBuffer);
 
-			device.unmapMemory(modelTransformBuffer.bufferMemory);
-			device.freeMemory(modelTransformBuffer.bufferMemory);
-			device.destroyBuffer(modelTransformBuffer.buffer);
+			destroyBuffer(device, modelTransformBuffer);
 
-			device.unmapMemory(lightBuffer.bufferMemory);
-			device.freeMemory(lightBuffer.bufferMemory);
-			device.destroyBuffer(lightBuffer.buffer);
+			destroyBuffer(device, lightBuffer);
 		}
 }
\ No newline at end of file
@@ -32,6 +32,8 @@ namespace vkUtilities {
 		// Devices
 		vk::Device device;
 		vk::PhysicalDevice physicalDevice;
+		// every buffer and G buffer the frame makes is placed in its blocks
+		DeviceAllocator* allocator = nullptr;
 
 		// SwapChain resources
 		vk::Image image;
@@ -39,23 +41,23 @@ namespace vkUtilities {
 		std::unordered_map<RenderPassType, vk::Framebuffer> frameBuffer;
 		// TODO: Make these also maps in the future?
 		vk::Image depthBuffer;
-		vk::DeviceMemory depthBufferMemory;
+		Allocation depthBufferMemory;
 		vk::ImageView depthBufferView;
 		vk::Format depthBufferFormat;
 
 		// G buffers
 		vk::Image prepassDepthBuffer;
-		vk::DeviceMemory prepassDepthBufferMemory;
+		Allocation prepassDepthBufferMemory;
 		vk::ImageView prepassDepthBufferView;
 		vkImage::Texture prepassDepthTexture;
 
 		vk::Image albedoBuffer;
-		vk::DeviceMemory albedoBufferMemory;
+		Allocation albedoBufferMemory;
 		vk::ImageView albedoBufferView;
 		vkImage::Texture albedoTexture;
 
 		vk::Image normalBuffer;
-		vk::DeviceMemory normalBufferMemory;
+		Allocation normalBufferMemory;
 		vk::ImageView normalBufferView;
 		vkImage::Texture normalTexture;
 
@@ -95,6 +97,8 @@ namespace vkUtilities {
 		vk::DescriptorBufferInfo cameraMatrixDescriptor;
 		vk::DescriptorBufferInfo modelBufferDescriptor;
 		vk::DescriptorBufferInfo lightBufferDescriptor;
+		// filled in by the engine once the scene's meshes are uploaded
+		vk::DescriptorBufferInfo materialBufferDescriptor;
 		std::unordered_map<RenderPassType, vk::DescriptorSet> vertexDescSet;
 		std::unordered_map<RenderPassType, vk::DescriptorSet> fragDescSet;
 
@@ -118,7 +122,7 @@ namespace vkUtilities {
 
 		void createNormalBuffer();
 
-		void createImageResources(vkImage::ImageInput imageInput, vk::ImageAspectFlagBits flags, vk::Image& image, vk::DeviceMemory& memory, vk::ImageView& imageView);
+		void createImageResources(vkImage::ImageInput imageInput, vk::ImageAspectFlagBits flags, vk::Image& image, vkUtilities::Allocation& memory, vk::ImageView& imageView);
 
 		void updateLightInformation(const std::vector<Light>& lights);
 
@@ -0,0 +1,185 @@
+#include "UploadBatch.h"
+#include "SingleTimeCommands.h"
+#include <algorithm>
+
+namespace vkUtilities {
+	void UploadBatch::begin(UploadBatchInput input) {
+		this->input = input;
+		regions.clear();
+		stagedSize = 0;
+		submission = 0;
+		bufferAcquires.clear();
+		imageAcquires.clear();
+
+		// a pool of its own, so batches can record on any thread at once
+		if (!input.commandBuffer) {
+			vk::CommandPoolCreateInfo poolInfo;
+			poolInfo.flags = vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+			poolInfo.queueFamilyIndex = input.queueFamily;
+
+			vk::CommandBufferAllocateInfo allocInfo;
+			allocInfo.level = vk::CommandBufferLevel::ePrimary;
+			allocInfo.commandBufferCount = 1;
+			try {
+				commandPool = input.device.createCommandPool(poolInfo);
+				allocInfo.commandPool = commandPool;
+				this->input.commandBuffer = input.device.allocateCommandBuffers(allocInfo)[0];
+			}
+			catch (vk::SystemError err) {
+				std::cout << "Failed to make an upload command buffer" << std::endl;
+			}
+		}
+
+		startJob(this->input.commandBuffer);
+		recording = true;
+	}
+
+	vk::CommandBuffer UploadBatch::getCommandBuffer() const {
+		return input.commandBuffer;
+	}
+
+	StagingRegion UploadBatch::reserve(vk::DeviceSize size) {
+		// the batch's own regions only come back after it's submitted, so it never holds more than half the ring
+		if (!regions.empty() && stagedSize + size > input.stagingRing->getSize() / 2) {
+			flush();
+		}
+
+		StagingRegion region = input.stagingRing->reserve(size);
+		regions.push_back(region);
+		stagedSize += region.size;
+		return region;
+	}
+
+	void UploadBatch::stage(StagingRegion& region) {
+		regions.push_back(region);
+		stagedSize += region.size;
+		region = StagingRegion();
+	}
+
+	void UploadBatch::copyBuffer(const void* source, vk::DeviceSize size, vk::Buffer destination, vk::DeviceSize destinationOffset) {
+		// anything bigger than a quarter of the ring goes through in pieces
+		vk::DeviceSize chunkSize = std::max(STAGING_ALIGNMENT, input.stagingRing->getSize() / 4 / STAGING_ALIGNMENT * STAGING_ALIGNMENT);
+		for (vk::DeviceSize offset = 0; offset < size; offset += chunkSize) {
+			vk::DeviceSize copySize = std::min(chunkSize, size - offset);
+			StagingRegion region = reserve(copySize);
+			memcpy(region.data, static_cast<const unsigned char*>(source) + offset, copySize);
+
+			vk::BufferCopy copyRegion;
+			copyRegion.srcOffset = region.offset;
+			copyRegion.dstOffset = destinationOffset + offset;
+			copyRegion.size = copySize;
+			input.commandBuffer.copyBuffer(region.buffer, destination, 1, &copyRegion);
+		}
+	}
+
+	bool UploadBatch::transfersOwnership() const {
+		return input.queueFamily != input.ownerFamily;
+	}
+
+	void UploadBatch::releaseBuffer(vk::Buffer buffer) {
+		vk::BufferMemoryBarrier barrier;
+		barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		barrier.buffer = buffer;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+
+		// on one family an ordinary barrier covers every later submission
+		if (!transfersOwnership()) {
+			barrier.dstAccessMask = vk::AccessFlagBits::eMemoryRead;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			input.commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, vk::DependencyFlags(), nullptr, barrier, nullptr);
+			return;
+		}
+
+		barrier.dstAccessMask = vk::AccessFlags();
+		barrier.srcQueueFamilyIndex = input.queueFamily;
+		barrier.dstQueueFamilyIndex = input.ownerFamily;
+		input.commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, vk::DependencyFlags(), nullptr, barrier, nullptr);
+
+		barrier.srcAccessMask = vk::AccessFlags();
+		barrier.dstAccessMask = vk::AccessFlagBits::eMemoryRead;
+		bufferAcquires.push_back(barrier);
+	}
+
+	void UploadBatch::releaseImage(vk::Image image, vk::ImageSubresourceRange range, vk::ImageLayout oldLayout, vk::ImageLayout newLayout) {
+		vk::ImageMemoryBarrier barrier;
+		barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+		barrier.image = image;
+		barrier.subresourceRange = range;
+
+		if (!transfersOwnership()) {
+			barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			input.commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlags(), nullptr, nullptr, barrier);
+			return;
+		}
+
+		// both halves carry the same layouts, the transition happens once between them
+		barrier.dstAccessMask = vk::AccessFlags();
+		barrier.srcQueueFamilyIndex = input.queueFamily;
+		barrier.dstQueueFamilyIndex = input.ownerFamily;
+		input.commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, vk::DependencyFlags(), nullptr, nullptr, barrier);
+
+		barrier.srcAccessMask = vk::AccessFlags();
+		barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+		imageAcquires.push_back(barrier);
+	}
+
+	bool UploadBatch::needsAcquire() const {
+		return !bufferAcquires.empty() || !imageAcquires.empty();
+	}
+
+	void UploadBatch::recordAcquire(vk::CommandBuffer commandBuffer) const {
+		if (!needsAcquire()) {
+			return;
+		}
+
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eAllCommands, vk::DependencyFlags(), nullptr, bufferAcquires, imageAcquires);
+	}
+
+	uint64_t UploadBatch::submit() {
+		if (!recording) {
+			return submission;
+		}
+
+		input.commandBuffer.end();
+		recording = false;
+		submission = input.stagingRing->submit(input.commandBuffer, input.queue);
+
+		for (StagingRegion& region : regions) {
+			input.stagingRing->release(region, submission);
+		}
+		regions.clear();
+		stagedSize = 0;
+
+		return submission;
+	}
+
+	bool UploadBatch::isFinished() {
+		return !recording && input.stagingRing->isFinished(submission);
+	}
+
+	void UploadBatch::wait() {
+		submit();
+		input.stagingRing->wait(submission);
+	}
+
+	void UploadBatch::flush() {
+		wait();
+		startJob(input.commandBuffer);
+		recording = true;
+	}
+
+	void UploadBatch::destroy() {
+		wait();
+		if (commandPool) {
+			input.device.destroyCommandPool(commandPool);
+			commandPool = nullptr;
+			input.commandBuffer = nullptr;
+		}
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "../config.h"
+#include "StagingRing.h"
+
+/*
+	Records any number of copies and barriers into one command buffer and
+	submits them together with a single fence, rather than a submit and a
+	queue wait per operation. Everything staged for the batch stays reserved
+	in the ring until that fence signals. Should the batch's staging grow
+	past what the ring can spare, what's recorded so far is flushed and the
+	batch carries on in a fresh submission.
+
+	Batches on a dedicated transfer family hand what they upload over to the
+	graphics family. The release half is recorded at the end of the batch,
+	the acquire half goes in a graphics submission made after the batch has
+	finished.
+*/
+namespace vkUtilities {
+	// where uploads go, the transfer queue is the graphics one when the device has no separate transfer family
+	struct UploadQueues {
+		vk::Queue graphicsQueue;
+		uint32_t graphicsFamily = 0;
+		vk::Queue transferQueue;
+		uint32_t transferFamily = 0;
+
+		bool isDedicated() const { return transferFamily != graphicsFamily; }
+	};
+
+	struct UploadBatchInput {
+		vk::Device device;
+		// must not be in use, the batch records into it until submit, left null the batch makes its own on queueFamily
+		vk::CommandBuffer commandBuffer;
+		vk::Queue queue;
+		uint32_t queueFamily = 0;
+		// the family that uses what's uploaded, anything released is handed over to it when it isn't queueFamily
+		uint32_t ownerFamily = 0;
+		StagingRing* stagingRing;
+	};
+
+	class UploadBatch {
+	public:
+		void begin(UploadBatchInput input);
+		// record barriers and image copies straight into this
+		vk::CommandBuffer getCommandBuffer() const;
+		// space to write pixels or vertices into, for commands recorded before submit to read
+		StagingRegion reserve(vk::DeviceSize size);
+		// takes over a region reserved straight from the ring, it goes back with the batch's submission
+		void stage(StagingRegion& region);
+		// stages and records a copy of size bytes into destination
+		void copyBuffer(const void* source, vk::DeviceSize size, vk::Buffer destination, vk::DeviceSize destinationOffset);
+		// makes what was copied into buffer visible to the owner family
+		void releaseBuffer(vk::Buffer buffer);
+		// moves levels written by the batch from oldLayout to newLayout and makes them visible to the owner family
+		void releaseImage(vk::Image image, vk::ImageSubresourceRange range, vk::ImageLayout oldLayout, vk::ImageLayout newLayout);
+		// only true on a dedicated transfer family with something released
+		bool needsAcquire() const;
+		// the owner family's half of every release, for a command buffer submitted after this batch finishes
+		void recordAcquire(vk::CommandBuffer commandBuffer) const;
+		// ends recording and submits, the returned submission can be waited on through the ring
+		uint64_t submit();
+		bool isFinished();
+		// the command buffer is free to record again once this returns
+		void wait();
+		// waits and frees the command buffer the batch made for itself
+		void destroy();
+
+	private:
+		UploadBatchInput input;
+		vk::CommandPool commandPool;
+		std::vector<StagingRegion> regions;
+		vk::DeviceSize stagedSize = 0;
+		uint64_t submission = 0;
+		bool recording = false;
+		std::vector<vk::BufferMemoryBarrier> bufferAcquires;
+		std::vector<vk::ImageMemoryBarrier> imageAcquires;
+
+		bool transfersOwnership() const;
+		// submits what's recorded, waits for it and starts recording again
+		void flush();
+	};
+}